@@ -108,9 +108,9 @@ using lvk::VulkanApp;
 
 static VulkanApp *vulkanApp{nullptr};
 
-int main() {
-  for (int32_t i = 0; i < __argc; i++) {
-    VulkanApp::args.push_back(__argv[i]);
+int main(int argc, char* argv[]) {
+  for (int32_t i = 0; i < argc; i++) {
+    VulkanApp::args.push_back(argv[i]);
   };
   vulkanApp = new MoveCameraApp();
   vulkanApp->InitVulkan();
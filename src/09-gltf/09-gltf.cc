@@ -119,11 +119,11 @@ using lvk::VulkanApp;
 
 static VulkanApp* vulkanApp{nullptr};
 
-int main() {
+int main(int argc, char* argv[]) {
   // test_lvk_mesh = LoadGltf();
 
-  for (int32_t i = 0; i < __argc; i++) {
-    VulkanApp::args.push_back(__argv[i]);
+  for (int32_t i = 0; i < argc; i++) {
+    VulkanApp::args.push_back(argv[i]);
   };
   vulkanApp = new GltfApp();
   vulkanApp->InitVulkan();
@@ -123,6 +123,7 @@ void PbrBasicApp::InitScene() {
       {
           "10-pbr-basic.vert.spv",
           "10-pbr-basic.frag.spv",
+          "10-pbr-basic.bindless.frag.spv",
       },
   };
 
@@ -147,9 +148,9 @@ using lvk::VulkanApp;
 
 static VulkanApp* vulkanApp{nullptr};
 
-int main() {
-  for (int32_t i = 0; i < __argc; i++) {
-    VulkanApp::args.push_back(__argv[i]);
+int main(int argc, char* argv[]) {
+  for (int32_t i = 0; i < argc; i++) {
+    VulkanApp::args.push_back(argv[i]);
   };
   vulkanApp = new PbrBasicApp();
   vulkanApp->StartRenderdoc();
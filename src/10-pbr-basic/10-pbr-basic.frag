@@ -1,5 +1,9 @@
 #version 450
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 const float PI = 3.14159265359;
 
 layout (set = 0, binding = 0) uniform UBOShared
@@ -14,22 +18,51 @@ layout (set = 0, binding = 0) uniform UBOShared
 
 layout (set = 0, binding = 1) uniform sampler2D shadowMap;
 
+#ifdef BINDLESS
+// every texture of the scene, selected by the texture index of the draw
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+#else
 layout (set = 1, binding = 1) uniform sampler2D samplerColor;
+#endif
 
 layout (location = 0) in vec2 inUV;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec3 inWorldPosition;
 layout (location = 3) in vec4 inShadowCoord;
+layout (location = 4) flat in uint inDrawIndex;
 
 layout (location = 0) out vec4 outFragColor;
 
-layout (set = 1, binding = 2) uniform UBOFrag
+struct DrawData
 {
 	vec4 color;
 	float roughness;
 	float metallic;
-	float padding[2];
-} ubo_frag;
+	// index into the bindless texture array, 0xffffffff when the draw has no texture
+	uint textureIndex;
+	float padding;
+};
+
+// material parameters of every draw, selected by the draw index of the instance
+layout (set = 0, binding = 3) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+} draw_data;
+
+// set at the start of main()
+DrawData material;
+
+vec3 BaseColor(vec2 uv)
+{
+#ifdef BINDLESS
+	if (material.textureIndex == 0xffffffffu)
+		return material.color.rgb;
+	// draws of one multi draw indirect call may use different textures
+	return material.color.rgb * texture(textures[nonuniformEXT(material.textureIndex)], uv).rgb;
+#else
+	return material.color.rgb * texture(samplerColor, uv).rgb;
+#endif
+}
 
 // Normal Distribution function --------------------------------------
 float D_GGX(float dotNH, float roughness)
@@ -53,7 +86,7 @@ float G_SchlicksmithGGX(float dotNL, float dotNV, float roughness)
 // Fresnel function ----------------------------------------------------
 vec3 F_Schlick(float cosTheta, float metallic)
 {
-	vec3 F0 = mix(vec3(0.04), ubo_frag.color.xyz, metallic); // * material.specular
+	vec3 F0 = mix(vec3(0.04), material.color.xyz, metallic); // * material.specular
 	vec3 F = F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0); 
 	return F;    
 }
@@ -130,6 +163,8 @@ vec3 BRDF(vec3 L, vec3 V, vec3 N, float metallic, float roughness)
 
 void main() 
 {
+	material = draw_data.draws[inDrawIndex];
+
 	vec3 N = normalize(inNormal);
 	vec3 V = normalize(ubo_shared.camera_position.xyz - inWorldPosition);
 
@@ -137,9 +172,9 @@ void main()
 
 	// L direction is fragment to light
 	vec3 L = normalize(-ubo_shared.light_direction.xyz);
-	Lo += BRDF(L, V, N, ubo_frag.metallic, ubo_frag.roughness);
+	Lo += BRDF(L, V, N, material.metallic, material.roughness);
 
-	vec3 color = ubo_frag.color.xyz / PI;
+	vec3 color = BaseColor(inUV) / PI;
 	
     float shadow = filterPCF(inShadowCoord / inShadowCoord.w);
     
@@ -14,15 +14,29 @@ layout (set = 0, binding = 0) uniform UBOShared
 	mat4 view;
 } ubo_shared;
 
-layout (set = 1, binding = 0) uniform UBO 
+struct InstanceData
 {
 	mat4 model;
-} ubo;
+	uint draw;
+};
+
+// per instance data of the frame, indexed by instance slot
+layout (set = 0, binding = 2) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+} instance_data;
+
+// instance index of each drawn instance, identity unless the draws were culled on the gpu
+layout (set = 0, binding = 4) readonly buffer VisibleBuffer
+{
+	uint indices[];
+} visible;
 
 layout (location = 0) out vec2 outUV;
 layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec3 outWorldPosition;
 layout (location = 3) out vec4 outShadowCoord;
+layout (location = 4) flat out uint outDrawIndex;
 
 out gl_PerVertex 
 {
@@ -40,14 +54,18 @@ void main()
 {
 	outUV = inUV;
 
-	vec3 worldPos = vec3(ubo.model * vec4(inPos, 1.0));
+	InstanceData instance = instance_data.instances[visible.indices[gl_InstanceIndex]];
+	mat4 model = instance.model;
+	outDrawIndex = instance.draw;
+
+	vec3 worldPos = vec3(model * vec4(inPos, 1.0));
 
-	gl_Position = ubo_shared.projection * ubo_shared.view * ubo.model * vec4(inPos.xyz, 1.0);
+	gl_Position = ubo_shared.projection * ubo_shared.view * model * vec4(inPos.xyz, 1.0);
 
-    vec4 pos = ubo.model * vec4(inPos, 1.0);
-	// outNormal = mat3(inverse(transpose(ubo.model))) * inNormal;
-	outNormal = mat3(ubo.model) * inNormal;
+    vec4 pos = model * vec4(inPos, 1.0);
+	// outNormal = mat3(inverse(transpose(model))) * inNormal;
+	outNormal = mat3(model) * inNormal;
 	outWorldPosition = worldPos;
 
-    outShadowCoord = (biasMat * ubo_shared.light_mvp) * ubo.model * vec4(inPos, 1.0);
+    outShadowCoord = (biasMat * ubo_shared.light_mvp) * model * vec4(inPos, 1.0);
 }
\ No newline at end of file
@@ -107,13 +107,13 @@ using lvk::VulkanApp;
 
 static VulkanApp* vulkanApp{nullptr};
 
-int main() {
+int main(int argc, char* argv[]) {
   // test_lvk_mesh = LoadGltf();
   // assert(freopen("stdout.txt", "w", stdout) != NULL);
   // assert(freopen("stderr.txt", "w", stderr) != NULL);
 
-  for (int32_t i = 0; i < __argc; i++) {
-    VulkanApp::args.push_back(__argv[i]);
+  for (int32_t i = 0; i < argc; i++) {
+    VulkanApp::args.push_back(argv[i]);
   };
   vulkanApp = new PbrIblApp();
   vulkanApp->InitVulkan();
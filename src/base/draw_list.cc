@@ -0,0 +1,72 @@
+#include "draw_list.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace lvk {
+
+static uint64_t Field(uint32_t value, uint32_t bits) {
+  return std::min<uint64_t>(value, (1ull << bits) - 1);
+}
+
+uint64_t DrawList::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t texture, uint32_t mesh, uint32_t depth) {
+  static_assert(kPassBits + kPipelineBits + kTextureBits + kMeshBits + kDepthBits == 64);
+  uint64_t key = Field(pass, kPassBits);
+  key = (key << kPipelineBits) | Field(pipeline, kPipelineBits);
+  key = (key << kTextureBits) | Field(texture, kTextureBits);
+  key = (key << kMeshBits) | Field(mesh, kMeshBits);
+  key = (key << kDepthBits) | Field(depth, kDepthBits);
+  return key;
+}
+
+uint32_t DrawList::DepthBucket(float depth) {
+  // positive floats order like their bit patterns, anything behind the camera goes first
+  if (!(depth > 0.0f)) return 0;
+  uint32_t bits;
+  memcpy(&bits, &depth, sizeof(bits));
+  return bits >> (32 - kDepthBits);
+}
+
+void DrawList::Clear() {
+  keys_.clear();
+  values_.clear();
+}
+
+void DrawList::Add(uint64_t key, uint32_t value) {
+  keys_.push_back(key);
+  values_.push_back(value);
+}
+
+void DrawList::Sort() {
+  const size_t count = keys_.size();
+  if (count < 2) return;
+  tempKeys_.resize(count);
+  tempValues_.resize(count);
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    uint32_t offsets[256] = {};
+    for (uint64_t key : keys_) {
+      offsets[(key >> shift) & 0xff]++;
+    }
+    // every key has the same byte here, the pass would not move anything
+    if (offsets[(keys_[0] >> shift) & 0xff] == count) continue;
+
+    uint32_t sum = 0;
+    for (uint32_t& offset : offsets) {
+      uint32_t bucket = offset;
+      offset = sum;
+      sum += bucket;
+    }
+    // stable scatter, keeps the order of the lower bytes sorted so far
+    for (size_t i = 0; i < count; i++) {
+      uint32_t dst = offsets[(keys_[i] >> shift) & 0xff]++;
+      tempKeys_[dst] = keys_[i];
+      tempValues_[dst] = values_[i];
+    }
+    keys_.swap(tempKeys_);
+    values_.swap(tempValues_);
+  }
+}
+
+}  // namespace lvk
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace lvk {
+
+// per-frame counters of the sorted base pass draws
+struct DrawSortStats {
+  uint32_t draws{0};
+  // pipeline and set 1 binds skipped because the previous draw already had them bound.
+  // the vertex buffer binds saved by the geometry arena are not counted here
+  uint32_t avoidedStateChanges{0};
+  double sortMs{0.0};
+};
+
+// 按 64 位排序键排列一帧的 draw.
+// 键从高位到低位依次是 pass, pipeline, texture (set 1), mesh, 深度, 状态相同的 draw 排在一起,
+// 录制时只在状态变化时才绑定. 深度在最低位, 状态完全相同时由近到远, 让 early-Z 尽早剔除被遮挡的片元.
+// 排序用按字节的 LSD radix sort, 所有键在某个字节上都相同时跳过这一轮.
+class DrawList {
+ public:
+  static constexpr uint32_t kPassBits = 4;
+  static constexpr uint32_t kPipelineBits = 8;
+  static constexpr uint32_t kTextureBits = 16;
+  static constexpr uint32_t kMeshBits = 20;
+  static constexpr uint32_t kDepthBits = 16;
+
+  // fields wider than their bits are clamped to the largest value
+  static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t texture, uint32_t mesh, uint32_t depth);
+  // monotonic 16 bit bucket of a view depth, the high bits of the float keep a log-like resolution
+  static uint32_t DepthBucket(float depth);
+
+  void Clear();
+  void Add(uint64_t key, uint32_t value);
+  void Sort();
+
+  uint32_t size() const { return static_cast<uint32_t>(keys_.size()); }
+  // values in key order after Sort()
+  const std::vector<uint32_t> &values() const { return values_; }
+  uint64_t key(uint32_t index) const { return keys_[index]; }
+
+ private:
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> values_;
+  // ping-pong buffers of the radix passes, kept to avoid allocating every frame
+  std::vector<uint64_t> tempKeys_;
+  std::vector<uint32_t> tempValues_;
+};
+
+}  // namespace lvk
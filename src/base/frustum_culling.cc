@@ -0,0 +1,129 @@
+#include "frustum_culling.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "primitives.h"
+
+// SSE2 is part of x86-64, other targets take the scalar path
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LVK_FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace lvk {
+
+void FrustumCuller::Resize(uint32_t count) {
+  count_ = count;
+  const uint32_t padded = (count + kBatchSize - 1) / kBatchSize * kBatchSize;
+  for (auto *array : {&boxCenterX_, &boxCenterY_, &boxCenterZ_, &boxExtentX_, &boxExtentY_, &boxExtentZ_, &sphereX_,
+                      &sphereY_, &sphereZ_}) {
+    array->assign(padded, 0.0f);
+  }
+  // padding slots fail every plane
+  sphereRadius_.assign(padded, -FLT_MAX);
+  visible_.assign(padded, 0);
+}
+
+void FrustumCuller::SetBounds(uint32_t index, const SectionBounds &bounds, const mat4f &model) {
+  assert(index < count_);
+  const vec3f axis_x = vec3f(model[0]);
+  const vec3f axis_y = vec3f(model[1]);
+  const vec3f axis_z = vec3f(model[2]);
+
+  // the rotated box is enclosed by |M| * extent around the transformed center
+  const vec3f center = vec3f(model * vec4f((bounds.min + bounds.max) * 0.5f, 1.0f));
+  const vec3f extent = (bounds.max - bounds.min) * 0.5f;
+  const vec3f world_extent =
+      glm::abs(axis_x) * extent.x + glm::abs(axis_y) * extent.y + glm::abs(axis_z) * extent.z;
+  boxCenterX_[index] = center.x;
+  boxCenterY_[index] = center.y;
+  boxCenterZ_[index] = center.z;
+  boxExtentX_[index] = world_extent.x;
+  boxExtentY_[index] = world_extent.y;
+  boxExtentZ_[index] = world_extent.z;
+
+  // non-uniform scale grows the sphere by its largest axis
+  const vec3f sphere_center = vec3f(model * vec4f(vec3f(bounds.sphere), 1.0f));
+  const float scale = std::max({glm::length(axis_x), glm::length(axis_y), glm::length(axis_z)});
+  sphereX_[index] = sphere_center.x;
+  sphereY_[index] = sphere_center.y;
+  sphereZ_[index] = sphere_center.z;
+  sphereRadius_[index] = bounds.sphere.w * scale;
+}
+
+uint32_t FrustumCuller::Cull(const vec4f planes[6]) {
+  const uint32_t padded = static_cast<uint32_t>(visible_.size());
+
+#if defined(LVK_FRUSTUM_SSE)
+  __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+  __m128 abs_x[6], abs_y[6], abs_z[6];
+  for (int p = 0; p < 6; p++) {
+    plane_x[p] = _mm_set1_ps(planes[p].x);
+    plane_y[p] = _mm_set1_ps(planes[p].y);
+    plane_z[p] = _mm_set1_ps(planes[p].z);
+    plane_w[p] = _mm_set1_ps(planes[p].w);
+    abs_x[p] = _mm_set1_ps(std::fabs(planes[p].x));
+    abs_y[p] = _mm_set1_ps(std::fabs(planes[p].y));
+    abs_z[p] = _mm_set1_ps(std::fabs(planes[p].z));
+  }
+  const __m128 zero = _mm_setzero_ps();
+
+  for (uint32_t i = 0; i < padded; i += kBatchSize) {
+    const __m128 box_x = _mm_loadu_ps(&boxCenterX_[i]);
+    const __m128 box_y = _mm_loadu_ps(&boxCenterY_[i]);
+    const __m128 box_z = _mm_loadu_ps(&boxCenterZ_[i]);
+    const __m128 extent_x = _mm_loadu_ps(&boxExtentX_[i]);
+    const __m128 extent_y = _mm_loadu_ps(&boxExtentY_[i]);
+    const __m128 extent_z = _mm_loadu_ps(&boxExtentZ_[i]);
+    const __m128 sphere_x = _mm_loadu_ps(&sphereX_[i]);
+    const __m128 sphere_y = _mm_loadu_ps(&sphereY_[i]);
+    const __m128 sphere_z = _mm_loadu_ps(&sphereZ_[i]);
+    const __m128 radius = _mm_loadu_ps(&sphereRadius_[i]);
+
+    // one bit per slot, cleared by the first plane it is fully outside of
+    int mask = 0xf;
+    for (int p = 0; p < 6 && mask != 0; p++) {
+      // box: signed distance of the center plus the extent projected on the normal
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], box_x), _mm_mul_ps(plane_y[p], box_y)),
+                                   _mm_add_ps(_mm_mul_ps(plane_z[p], box_z), plane_w[p]));
+      __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_x[p], extent_x), _mm_mul_ps(abs_y[p], extent_y)),
+                                _mm_mul_ps(abs_z[p], extent_z));
+      const __m128 box_inside = _mm_cmpge_ps(_mm_add_ps(distance, reach), zero);
+
+      distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], sphere_x), _mm_mul_ps(plane_y[p], sphere_y)),
+                            _mm_add_ps(_mm_mul_ps(plane_z[p], sphere_z), plane_w[p]));
+      const __m128 sphere_inside = _mm_cmpge_ps(_mm_add_ps(distance, radius), zero);
+
+      mask &= _mm_movemask_ps(_mm_and_ps(box_inside, sphere_inside));
+    }
+    for (uint32_t j = 0; j < kBatchSize; j++) {
+      visible_[i + j] = static_cast<uint8_t>((mask >> j) & 1);
+    }
+  }
+#else
+  for (uint32_t i = 0; i < padded; i++) {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++) {
+      const vec4f &plane = planes[p];
+      const float box_distance = plane.x * boxCenterX_[i] + plane.y * boxCenterY_[i] + plane.z * boxCenterZ_[i] + plane.w;
+      const float reach = std::fabs(plane.x) * boxExtentX_[i] + std::fabs(plane.y) * boxExtentY_[i] +
+                          std::fabs(plane.z) * boxExtentZ_[i];
+      const float sphere_distance = plane.x * sphereX_[i] + plane.y * sphereY_[i] + plane.z * sphereZ_[i] + plane.w;
+      inside = box_distance + reach >= 0.0f && sphere_distance + sphereRadius_[i] >= 0.0f;
+    }
+    visible_[i] = inside ? 1 : 0;
+  }
+#endif
+
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < count_; i++) {
+    visible_count += visible_[i];
+  }
+  return visible_count;
+}
+
+}  // namespace lvk
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "lvk_math.h"
+
+namespace lvk {
+
+struct SectionBounds;
+
+// per-frame counters of the cpu frustum culling, in nodes
+struct FrustumCullStats {
+  uint32_t visible{0};
+  uint32_t culled{0};
+  // world bounds recomputed this frame, only nodes whose transform changed
+  uint32_t updated{0};
+  double cullMs{0.0};
+};
+
+// CPU 视锥剔除.
+// 每个节点的世界空间包围盒和包围球按分量分开存放 (SoA), 测试时一次处理 4 个节点,
+// 每个平面只需要几条 SSE 乘加, 全部平面都在外侧的一组节点提前结束.
+// 包围盒和包围球都是保守的, 两者都和视锥相交才算可见.
+class FrustumCuller {
+ public:
+  void Resize(uint32_t count);
+  // transform the model space bounds of slot index to world space
+  void SetBounds(uint32_t index, const SectionBounds &bounds, const mat4f &model);
+  // planes as returned by matrix::ExtractFrustumPlanes, returns the number of visible slots
+  uint32_t Cull(const vec4f planes[6]);
+
+  // 1 when the slot intersected the frustum in the last Cull()
+  bool visible(uint32_t index) const { return visible_[index] != 0; }
+  uint32_t size() const { return count_; }
+
+  // slots tested per step, the arrays are padded to a multiple of it
+  static constexpr uint32_t kBatchSize = 4;
+
+ private:
+  uint32_t count_{0};
+  // world aabb as center and half extent
+  std::vector<float> boxCenterX_, boxCenterY_, boxCenterZ_;
+  std::vector<float> boxExtentX_, boxExtentY_, boxExtentZ_;
+  std::vector<float> sphereX_, sphereY_, sphereZ_, sphereRadius_;
+  std::vector<uint8_t> visible_;
+};
+
+}  // namespace lvk
@@ -0,0 +1,107 @@
+#include "instance_groups.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+namespace lvk {
+
+size_t InstanceKey::HashFunction::operator()(const InstanceKey &key) const {
+  size_t hash = std::hash<uint32_t>()(key.mesh);
+  auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2); };
+  combine(std::hash<int>()(key.pipeline));
+  combine(std::hash<int>()(key.material));
+  combine(std::hash<int>()(key.texture));
+  combine(std::hash<float>()(key.baseColor.x));
+  combine(std::hash<float>()(key.baseColor.y));
+  combine(std::hash<float>()(key.baseColor.z));
+  combine(std::hash<float>()(key.roughness));
+  combine(std::hash<float>()(key.metallic));
+  return hash;
+}
+
+void InstanceGroups::Build(const std::vector<InstanceKey> &keys) {
+  groups_.clear();
+  lookup_.clear();
+  nodeGroups_.resize(keys.size());
+  nodePositions_.resize(keys.size());
+  slots_.resize(keys.size());
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    Insert(i, keys[i]);
+  }
+  Layout();
+}
+
+bool InstanceGroups::Update(uint32_t node, const InstanceKey &key) {
+  assert(node < nodeGroups_.size());
+  Group &old_group = groups_[nodeGroups_[node]];
+  if (old_group.key == key) return false;
+
+  // swap remove, the order inside a group does not matter
+  uint32_t position = nodePositions_[node];
+  uint32_t last = old_group.nodes.back();
+  old_group.nodes[position] = last;
+  nodePositions_[last] = position;
+  old_group.nodes.pop_back();
+
+  Insert(node, key);
+  return true;
+}
+
+void InstanceGroups::Insert(uint32_t node, const InstanceKey &key) {
+  auto [it, inserted] = lookup_.emplace(key, static_cast<uint32_t>(groups_.size()));
+  if (inserted) {
+    groups_.push_back({key, 0, {}});
+  }
+  Group &group = groups_[it->second];
+  nodeGroups_[node] = it->second;
+  nodePositions_[node] = static_cast<uint32_t>(group.nodes.size());
+  group.nodes.push_back(node);
+}
+
+void InstanceGroups::Layout() {
+  // drop emptied groups
+  size_t count = 0;
+  for (size_t i = 0; i < groups_.size(); i++) {
+    if (groups_[i].nodes.empty()) continue;
+    if (count != i) {
+      groups_[count] = std::move(groups_[i]);
+    }
+    count++;
+  }
+  groups_.resize(count);
+
+  // stable, so groups of one pipeline and texture keep their order and slots move as little as possible
+  std::stable_sort(groups_.begin(), groups_.end(), [](const Group &a, const Group &b) {
+    return std::tie(a.key.pipeline, a.key.texture) < std::tie(b.key.pipeline, b.key.texture);
+  });
+  lookup_.clear();
+  runs_.clear();
+  groupRuns_.resize(groups_.size());
+
+  uint32_t first_instance = 0;
+  for (uint32_t i = 0; i < groups_.size(); i++) {
+    Group &group = groups_[i];
+    lookup_[group.key] = i;
+    const InstanceKey &run_key = runs_.empty() ? group.key : groups_[runs_.back().firstGroup].key;
+    if (runs_.empty() || run_key.pipeline != group.key.pipeline ||
+        (textureRuns_ && run_key.texture != group.key.texture)) {
+      runs_.push_back({i, 0});
+    }
+    runs_.back().groupCount++;
+    groupRuns_[i] = static_cast<uint32_t>(runs_.size() - 1);
+
+    group.firstInstance = first_instance;
+    for (uint32_t j = 0; j < group.nodes.size(); j++) {
+      nodeGroups_[group.nodes[j]] = i;
+      slots_[group.nodes[j]] = first_instance + j;
+    }
+    first_instance += static_cast<uint32_t>(group.nodes.size());
+  }
+  layoutVersion_++;
+}
+
+}  // namespace lvk
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "lvk_math.h"
+
+namespace lvk {
+
+// 决定两个节点能否合并成一次 instanced draw 的状态
+struct InstanceKey {
+  // index into the context's vkMeshList, one per unique (mesh, section)
+  uint32_t mesh{0};
+  int pipeline{0};
+  int material{0};
+  // index into the context's vkTextureList, -1 when the node has no texture or it failed to load
+  int texture{-1};
+  // fragment uniforms, read from the first node of the group
+  vec3f baseColor{1.0f};
+  float roughness{0.0f};
+  float metallic{0.0f};
+
+  bool operator==(const InstanceKey &other) const {
+    return mesh == other.mesh && pipeline == other.pipeline && material == other.material &&
+           texture == other.texture && baseColor == other.baseColor && roughness == other.roughness &&
+           metallic == other.metallic;
+  }
+
+  struct HashFunction {
+    size_t operator()(const InstanceKey &key) const;
+  };
+};
+
+// 把 key 相同的节点归为一组, 每组一次 instanced draw.
+// 每个节点占一个 instance slot, 各组的 slot 连续排列, 组的 firstInstance 就是它的第一个 slot.
+// 节点换组时只移动这一个节点, Layout() 再重新排 slot.
+// 使用同一个 pipeline 和同一张 texture 的组排在一起, 组成一个 run, 一个 run 只需要绑定一次 pipeline 和 set 1.
+class InstanceGroups {
+ public:
+  struct Group {
+    InstanceKey key;
+    uint32_t firstInstance{0};
+    // indices into vkNodeList, instance firstInstance + i draws nodes[i]
+    std::vector<uint32_t> nodes;
+  };
+  // groups [firstGroup, firstGroup + groupCount) use the same pipeline and sample the same texture
+  struct Run {
+    uint32_t firstGroup{0};
+    uint32_t groupCount{0};
+  };
+
+  // group every node from scratch, keys[i] is the key of node i
+  void Build(const std::vector<InstanceKey> &keys);
+  // move a node to the group of key, returns false when it is already there.
+  // slots are stale until Layout() is called.
+  bool Update(uint32_t node, const InstanceKey &key);
+  // drop emptied groups and assign instance slots again, bumps layoutVersion()
+  void Layout();
+  // bindless textures are not bound per run, runs then only split on the pipeline. call before Build()
+  void SetTextureRuns(bool enable) { textureRuns_ = enable; }
+
+  const std::vector<Group> &groups() const { return groups_; }
+  const std::vector<Run> &runs() const { return runs_; }
+  uint32_t groupRun(uint32_t group) const { return groupRuns_[group]; }
+  uint32_t instanceSlot(uint32_t node) const { return slots_[node]; }
+  uint32_t instanceCount() const { return static_cast<uint32_t>(slots_.size()); }
+  // changes whenever slots move, uploads compare it to know when every slot has to be written again
+  uint64_t layoutVersion() const { return layoutVersion_; }
+
+ private:
+  void Insert(uint32_t node, const InstanceKey &key);
+
+  std::vector<Group> groups_;
+  std::unordered_map<InstanceKey, uint32_t, InstanceKey::HashFunction> lookup_;
+  // per node: its group and its position in the group's node list
+  std::vector<uint32_t> nodeGroups_;
+  std::vector<uint32_t> nodePositions_;
+  std::vector<uint32_t> slots_;
+  std::vector<Run> runs_;
+  std::vector<uint32_t> groupRuns_;
+  uint64_t layoutVersion_{0};
+  bool textureRuns_{true};
+};
+
+}  // namespace lvk
@@ -224,6 +224,22 @@ mat4f ProjectionMatrix(float fov, float aspec, float near, float far) {
   return mat4f{0};
 }
 
+void ExtractFrustumPlanes(const mat4f& view_proj, vec4f out_planes[6]) {
+  // glm 是列主序, 第 i 行是每一列的第 i 个分量
+  auto row = [&view_proj](int i) { return vec4f(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]); };
+  const vec4f r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+  out_planes[0] = r3 + r0;
+  out_planes[1] = r3 - r0;
+  out_planes[2] = r3 + r1;
+  out_planes[3] = r3 - r1;
+  // clip z 的范围是 [0, w]
+  out_planes[4] = r2;
+  out_planes[5] = r3 - r2;
+  for (int i = 0; i < 6; i++) {
+    out_planes[i] /= glm::length(vec3f(out_planes[i]));
+  }
+}
+
 #if 0
 template<typename T>
 	GLM_FUNC_QUALIFIER mat<4, 4, T, defaultp> perspectiveRH_ZO(T fovy, T aspect, T zNear, T zFar)
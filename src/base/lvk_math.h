@@ -46,6 +46,10 @@ mat4f MakeFromEulerAngleYXZ(const float& yaw, const float& pitch, const float& r
 vec3f DecomposeRotationFromMatrix(const mat4f& in_matrix);
 // 从 4x4 矩阵中分解 translation, scale & rotation
 void DecomposeMatrix(const mat4f in_matrix, vec3f& out_translate, vec3f& out_scale, vec3f& out_rot);
+
+// 从 view-projection 矩阵中提取 frustum 的 6 个平面 (left, right, bottom, top, near, far),
+// xyz 为指向内侧的单位法线, dot(xyz, p) + w >= 0 表示点 p 在平面内侧. 深度范围为 [0, 1]
+void ExtractFrustumPlanes(const mat4f& view_proj, vec4f out_planes[6]);
 }  // namespace matrix
 
 }  // namespace lvk
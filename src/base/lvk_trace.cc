@@ -0,0 +1,124 @@
+#include "lvk_trace.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "lvk_log.h"
+
+namespace lvk {
+namespace trace {
+
+std::atomic<bool> g_recording{false};
+
+namespace {
+
+struct Event {
+  const char *name;
+  uint64_t startNs;
+  uint64_t endNs;
+};
+
+// per thread, the oldest events are overwritten when a range does not fit
+constexpr size_t kRingSize = 1 << 16;
+
+struct ThreadBuffer {
+  uint32_t tid{0};
+  std::vector<Event> events;
+  // total events written, events[count % kRingSize] is the next slot
+  uint64_t count{0};
+};
+
+std::mutex g_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+std::string g_path;
+uint32_t g_startFrame{0};
+uint32_t g_endFrame{0};
+
+ThreadBuffer &LocalBuffer() {
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffer = g_buffers.back().get();
+    buffer->tid = static_cast<uint32_t>(g_buffers.size());
+    buffer->events.resize(kRingSize);
+  }
+  return *buffer;
+}
+
+}  // namespace
+
+void AddEvent(const char *name, uint64_t startNs, uint64_t endNs) {
+  ThreadBuffer &buffer = LocalBuffer();
+  buffer.events[buffer.count % kRingSize] = {name, startNs, endNs};
+  buffer.count++;
+}
+
+void Configure(const std::string &path, uint32_t startFrame, uint32_t endFrame) {
+  g_path = path;
+  g_startFrame = startFrame;
+  g_endFrame = std::max(endFrame, startFrame + 1);
+  // a range starting at frame 0 also covers loading before the first frame
+  g_recording = g_startFrame == 0;
+  DEBUG_LOG("trace frames [{}, {}) to {}", g_startFrame, g_endFrame, g_path);
+}
+
+void BeginFrame(uint32_t frame) {
+  if (g_path.empty()) return;
+  if (frame == g_startFrame) {
+    g_recording = true;
+  } else if (frame == g_endFrame) {
+    g_recording = false;
+    Flush();
+  }
+}
+
+// worker threads are idle between frames, so the buffers are read without stopping them
+void Flush() {
+  g_recording = false;
+  if (g_path.empty()) return;
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  std::ofstream out(g_path);
+  if (!out) {
+    ERROR_LOG("can not open trace file {}", g_path);
+    g_path.clear();
+    return;
+  }
+
+  uint64_t origin_ns = UINT64_MAX;
+  for (const auto &buffer : g_buffers) {
+    uint64_t first = buffer->count > kRingSize ? buffer->count - kRingSize : 0;
+    for (uint64_t i = first; i < buffer->count; i++) {
+      origin_ns = std::min(origin_ns, buffer->events[i % kRingSize].startNs);
+    }
+  }
+
+  size_t event_count = 0;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (const auto &buffer : g_buffers) {
+    if (event_count++) out << ",";
+    out << std::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                       buffer->tid, buffer->tid == 1 ? "main" : std::format("worker {}", buffer->tid - 1));
+
+    uint64_t first = buffer->count > kRingSize ? buffer->count - kRingSize : 0;
+    for (uint64_t i = first; i < buffer->count; i++) {
+      const Event &e = buffer->events[i % kRingSize];
+      out << std::format(",{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", e.name,
+                         buffer->tid, (e.startNs - origin_ns) / 1000.0, (e.endNs - e.startNs) / 1000.0);
+      event_count++;
+    }
+    buffer->count = 0;
+  }
+  out << "]}\n";
+
+  DEBUG_LOG("wrote {} trace events to {}", event_count, g_path);
+  g_path.clear();
+}
+
+}  // namespace trace
+}  // namespace lvk
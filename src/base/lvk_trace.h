@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// CPU 侧的 scope 计时, 导出为 chrome://tracing / Perfetto 可以打开的 json.
+// 不录制时每个 scope 只有一次 relaxed load 和一个分支, 可以一直编译进去.
+// 定义 LVK_TRACE_DISABLED 可以把宏完全去掉.
+
+namespace lvk {
+namespace trace {
+
+extern std::atomic<bool> g_recording;
+
+inline bool IsRecording() { return g_recording.load(std::memory_order_relaxed); }
+
+inline uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// record a complete event into the calling thread's ring buffer, name must be a string literal
+void AddEvent(const char *name, uint64_t startNs, uint64_t endNs);
+
+// record frames [startFrame, endFrame) and write them to path once endFrame is reached
+void Configure(const std::string &path, uint32_t startFrame, uint32_t endFrame);
+// called once per frame by the main loop, starts/stops recording at the range boundaries
+void BeginFrame(uint32_t frame);
+// write what has been recorded so far, also called on shutdown if the range was not finished
+void Flush();
+
+class Scope {
+ public:
+  explicit Scope(const char *name) : name_(name) {
+    if (IsRecording()) startNs_ = NowNs();
+  }
+  ~Scope() {
+    if (startNs_) AddEvent(name_, startNs_, NowNs());
+  }
+
+ private:
+  const char *name_;
+  uint64_t startNs_{0};
+};
+
+}  // namespace trace
+}  // namespace lvk
+
+#define LVK_TRACE_CONCAT_INNER(a, b) a##b
+#define LVK_TRACE_CONCAT(a, b) LVK_TRACE_CONCAT_INNER(a, b)
+
+#if defined(LVK_TRACE_DISABLED)
+#define LVK_TRACE_SCOPE(name)
+#define LVK_TRACE_FUNCTION()
+#else
+#define LVK_TRACE_SCOPE(name) ::lvk::trace::Scope LVK_TRACE_CONCAT(lvk_trace_scope_, __LINE__)(name)
+#define LVK_TRACE_FUNCTION() LVK_TRACE_SCOPE(__FUNCTION__)
+#endif
@@ -11,6 +11,8 @@ namespace lvk {
 struct Material {
   std::string vertShaderPath;
   std::string fragShaderPath;
+  // same shading with the texture read from the bindless array, used when the context runs bindless
+  std::string bindlessFragShaderPath;
 };
 
 struct MaterialParamters {
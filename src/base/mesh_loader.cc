@@ -7,6 +7,7 @@
 
 #include "lvk_log.h"
 #include "lvk_math.h"
+#include "lvk_trace.h"
 #include "primitives.h"
 
 
@@ -120,6 +121,9 @@ static LoadMeshNode LoadGltfMesh(const tinygltf::Model& model, const tinygltf::M
 
   CopyToPrimitiveMeshIndices(result.MeshData, model, mesh);
   CopyToPrimitiveMeshAttribute(result.MeshData, model, mesh);
+  for (auto& section : result.MeshData->sections) {
+    section.ComputeBounds();
+  }
 
   for (size_t i = 0; i < GetMeshPrimitivSize(mesh); ++i) {
     tinygltf::Primitive primitive = mesh.primitives[i];
@@ -255,6 +259,7 @@ static LoadMeshResult LoadGltf(const std::string& path) {
 static bool IsGltfModel(const std::string_view path) { return true; }
 
 LoadMeshResult MeshLoader::LoadMesh(const std::string& path) {
+  LVK_TRACE_FUNCTION();
   if (!IsGltfModel(path)) {
     ERROR_LOG("invalid mesh type: {}", path);
     return LoadMeshResult();
@@ -15,6 +15,7 @@ mat4f Node::localMatrix() {
   auto scale_mat = matrix::Scale(mat4f{1.0}, transform.scale);
   rot_matrix = matrix::MakeFromEulerAngleYXZ(transform.rotation.y, transform.rotation.x, transform.rotation.z);
   matrix = matrix * rot_matrix * scale_mat;
+  MarkDirty();
   return matrix;
 }
 
@@ -22,12 +23,14 @@ void Node::UpdateModelMatrixTranslation() {
   matrix = matrix::Translate(mat4f{1.0}, transform.translation);
   auto scale_mat = matrix::Scale(mat4f{1.0}, transform.scale);
   matrix = matrix * rot_matrix * scale_mat;
+  MarkDirty();
 }
 
 void Node::UpdateModelMatrixScale() {
   matrix = matrix::Translate(mat4f{1.0}, transform.translation);
   auto scale_mat = matrix::Scale(mat4f{1.0}, transform.scale);
   matrix = matrix * rot_matrix * scale_mat;
+  MarkDirty();
 }
 
 void Node::SetRotation(const vec3f& in) {
@@ -60,6 +63,7 @@ void Node::SetRotationMatrix(const mat4f& in_matrix) {
 
   matrix = matrix * in_matrix;
   rot_matrix = in_matrix;
+  MarkDirty();
 }
 
 std::string Node::GetLocalMatrixString() { return glm::to_string(matrix); }
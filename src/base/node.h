@@ -49,6 +49,11 @@ struct Node {
 
   const mat4f& ModelMatrix() { return matrix; }
 
+  // bumped whenever the model matrix changes, renderers compare it to skip uploads of static nodes.
+  // code that edits materialParamters directly must call MarkDirty() itself.
+  uint64_t generation() const { return generation_; }
+  void MarkDirty() { generation_++; }
+
   inline void ClampRotation(float& x) {
     while (x > +360) x -= 360;
     while (x < -360) x += 360;
@@ -95,6 +100,8 @@ struct Node {
 
   // rotation matrix
   mat4f rot_matrix{1.0};
+
+  uint64_t generation_{0};
 };
 
 typedef std::shared_ptr<Node> SNode;
@@ -1,45 +1,43 @@
 #include "primitives.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "vertex_data.h"
 #include "vulkan_tools.h"
 
 namespace lvk {
 
-void PrimitiveMeshVK::CreateBuffer(const MeshSection *section, VulkanDevice *device) {
-  if (vertexBuffer == nullptr) {
-    vertexBuffer = new VulkanBuffer();
-
-    uint32_t vsize = static_cast<uint32_t>(sizeof(VertexLayout) * section->vertices.size());
-    const void *vdata = section->vertices.data();
-    VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                         vertexBuffer, vsize, vdata));
+void MeshSection::ComputeBounds() {
+  bounds = SectionBounds();
+  if (vertices.empty()) return;
+  bounds.min = vertices[0].position;
+  bounds.max = bounds.min;
+  for (const auto &v : vertices) {
+    bounds.min = glm::min(bounds.min, v.position);
+    bounds.max = glm::max(bounds.max, v.position);
   }
-
-  if (indexBuffer == nullptr) {
-    indexBuffer = new VulkanBuffer();
-
-    // TODO: bug? sizeof(uint32)?
-    uint32_t isize = static_cast<uint32_t>(sizeof(uint32_t) * section->indices.size());
-    const void *idata = section->indices.data();
-    VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                         indexBuffer, isize, idata));
+  // aabb 中心加最远顶点的距离, 不是最小包围球, 但足够剔除用
+  const vec3f center = (bounds.min + bounds.max) * 0.5f;
+  float radius2 = 0.0f;
+  for (const auto &v : vertices) {
+    const vec3f d = v.position - center;
+    radius2 = std::max(radius2, glm::dot(d, d));
   }
+  bounds.sphere = vec4f(center, std::sqrt(radius2));
 }
 
-PrimitiveMeshVK::~PrimitiveMeshVK() {
-  if (vertexBuffer) {
-    vertexBuffer->Destroy();
-    delete vertexBuffer;
-    vertexBuffer = nullptr;
+void PrimitiveMeshVK::CreateBuffer(const MeshSection *section, VulkanGeometryArena *arena, VulkanUploadBatch *upload) {
+  if (!geometry.valid()) {
+    geometry = arena->Add(*section, upload);
+    indexCount = geometry.indexCount;
+    bounds = section->bounds;
   }
+}
 
-  if (indexBuffer) {
-    indexBuffer->Destroy();
-    delete indexBuffer;
-    indexBuffer = nullptr;
-  }
+void PrimitiveMeshVK::Release(VulkanGeometryArena *arena) {
+  arena->Remove(geometry);
+  indexCount = 0;
 }
 
 namespace primitive {
@@ -83,6 +81,7 @@ PrimitiveMesh cube(float width /*= 1*/, float height /*= 1*/, float depth /*= 1*
     addTriangle(section, index, index + 1, index + 2);
     addTriangle(section, index, index + 2, index + 3);
   }
+  section.ComputeBounds();
 
   return PrimitiveMesh(section);
 }
@@ -96,6 +95,7 @@ PrimitiveMesh quad() {
         },
         .indices = {0, 1, 2, 2, 3, 0},
       };
+  section.ComputeBounds();
 
   return PrimitiveMesh(section);
 }
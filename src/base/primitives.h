@@ -4,14 +4,27 @@
 
 #include "vertex_data.h"
 #include "vulkan_device.h"
+#include "vulkan_geometry_arena.h"
 
 #include "transform.h"
 
 namespace lvk {
 
+// model space bounds of a section
+struct SectionBounds {
+  vec3f min{0.0f};
+  vec3f max{0.0f};
+  // xyz center, w radius
+  vec4f sphere{0.0f};
+};
+
 struct MeshSection {
   std::vector<VertexLayout> vertices;
   std::vector<uint32_t> indices;
+  // filled by ComputeBounds() when the section is loaded or generated
+  SectionBounds bounds;
+
+  void ComputeBounds();
 };
 
 struct PrimitiveMesh {
@@ -31,20 +44,16 @@ struct PrimitiveMesh {
 
 // todo: move to vulkan context
 // TODO: move to vulkan_primitives
+// a section's slice of the context's geometry arena
 struct PrimitiveMeshVK {
-  PrimitiveMeshVK() {
-    vertexBuffer = nullptr;
-    indexBuffer = nullptr;
-    indexCount = 0;
-  }
-  VulkanBuffer* vertexBuffer{nullptr};
-  VulkanBuffer* indexBuffer{nullptr};
-  VkPipelineVertexInputStateCreateInfo inputState;
+  GeometryRange geometry;
+  // sections with no index data are skipped by the passes
   uint32_t indexCount{0};
+  // copied from the section, read by the culling passes
+  SectionBounds bounds;
 
-  void CreateBuffer(const MeshSection* mesh, VulkanDevice* device);
-
-  ~PrimitiveMeshVK();
+  void CreateBuffer(const MeshSection* mesh, VulkanGeometryArena* arena, VulkanUploadBatch* upload = nullptr);
+  void Release(VulkanGeometryArena* arena);
 };
 
 namespace primitive_helpers {
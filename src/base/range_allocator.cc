@@ -0,0 +1,80 @@
+#include "range_allocator.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace lvk {
+
+RangeAllocator::RangeAllocator(uint32_t capacity) { Reset(capacity); }
+
+void RangeAllocator::Reset(uint32_t capacity) {
+  free_.clear();
+  capacity_ = capacity;
+  used_ = 0;
+  if (capacity_ > 0) {
+    free_[0] = capacity_;
+  }
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t count) {
+  if (count == 0) return kInvalidOffset;
+
+  for (auto it = free_.begin(); it != free_.end(); ++it) {
+    if (it->second < count) continue;
+
+    uint32_t offset = it->first;
+    uint32_t remaining = it->second - count;
+    free_.erase(it);
+    if (remaining > 0) {
+      free_[offset + count] = remaining;
+    }
+    used_ += count;
+    return offset;
+  }
+  return kInvalidOffset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t count) {
+  if (count == 0) return;
+  assert(offset + count <= capacity_);
+  assert(used_ >= count);
+  used_ -= count;
+
+  auto next = free_.lower_bound(offset);
+  // merge with the range right after
+  if (next != free_.end() && next->first == offset + count) {
+    count += next->second;
+    next = free_.erase(next);
+  }
+  // merge with the range right before
+  if (next != free_.begin()) {
+    auto prev = std::prev(next);
+    assert(prev->first + prev->second <= offset);
+    if (prev->first + prev->second == offset) {
+      prev->second += count;
+      return;
+    }
+  }
+  free_[offset] = count;
+}
+
+void RangeAllocator::Grow(uint32_t newCapacity) {
+  if (newCapacity <= capacity_) return;
+  uint32_t old_capacity = capacity_;
+  capacity_ = newCapacity;
+  // Free() merges the new tail with a free range ending at the old capacity
+  used_ += newCapacity - old_capacity;
+  Free(old_capacity, newCapacity - old_capacity);
+}
+
+uint32_t RangeAllocator::LargestFree() const {
+  uint32_t largest = 0;
+  for (const auto &range : free_) {
+    largest = std::max(largest, range.second);
+  }
+  return largest;
+}
+
+}  // namespace lvk
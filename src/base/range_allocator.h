@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+
+namespace lvk {
+
+// 在 [0, capacity) 上做 first fit 分配, 释放时和相邻的空闲段合并.
+// 单位由调用者决定(顶点数, 索引数, 实例数...), 只管理偏移不接触任何内存.
+class RangeAllocator {
+ public:
+  static constexpr uint32_t kInvalidOffset = UINT32_MAX;
+
+  explicit RangeAllocator(uint32_t capacity = 0);
+
+  // returns kInvalidOffset when no free range is large enough
+  uint32_t Allocate(uint32_t count);
+  void Free(uint32_t offset, uint32_t count);
+  // append [capacity, newCapacity) to the free space
+  void Grow(uint32_t newCapacity);
+  void Reset(uint32_t capacity);
+
+  uint32_t capacity() const { return capacity_; }
+  uint32_t used() const { return used_; }
+  uint32_t LargestFree() const;
+  size_t FreeRangeCount() const { return free_.size(); }
+
+ private:
+  // offset -> count
+  std::map<uint32_t, uint32_t> free_;
+  uint32_t capacity_{0};
+  uint32_t used_{0};
+};
+
+}  // namespace lvk
@@ -0,0 +1,128 @@
+#include "shader_archive.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "lvk_log.h"
+
+namespace lvk {
+
+bool ShaderArchive::Open(const std::string &path) {
+  Close();
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    DEBUG_LOG("shader archive: no {}, loading loose .spv files", path);
+    return false;
+  }
+  LARGE_INTEGER file_size{};
+  GetFileSizeEx(file, &file_size);
+  HANDLE mapping = file_size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+  const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view) {
+    ERROR_LOG("shader archive: could not map {}", path);
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  file_ = file;
+  mapping_ = mapping;
+  data_ = static_cast<const uint8_t *>(view);
+  size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    DEBUG_LOG("shader archive: no {}, loading loose .spv files", path);
+    return false;
+  }
+  struct stat st {};
+  void *view = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  // the mapping keeps its own reference to the file
+  close(fd);
+  if (view == MAP_FAILED) {
+    ERROR_LOG("shader archive: could not map {}", path);
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(view);
+  size_ = static_cast<size_t>(st.st_size);
+#endif
+
+  if (!Index(path)) {
+    Close();
+    return false;
+  }
+  DEBUG_LOG("shader archive: mapped {} shaders, {} KB from {}", blobs_.size(), size_ / 1024, path);
+  return true;
+}
+
+bool ShaderArchive::Index(const std::string &path) {
+  ShaderArchiveHeader header{};
+  if (size_ < sizeof(header)) {
+    ERROR_LOG("shader archive: {} is truncated, ignored", path);
+    return false;
+  }
+  memcpy(&header, data_, sizeof(header));
+  if (header.magic != kShaderArchiveMagic || header.version != kShaderArchiveVersion) {
+    ERROR_LOG("shader archive: {} is not a version {} archive, ignored", path, kShaderArchiveVersion);
+    return false;
+  }
+  if (header.count > (size_ - sizeof(header)) / sizeof(ShaderArchiveEntry)) {
+    ERROR_LOG("shader archive: {} is truncated, ignored", path);
+    return false;
+  }
+
+  const auto *entries = reinterpret_cast<const ShaderArchiveEntry *>(data_ + sizeof(header));
+  for (uint32_t i = 0; i < header.count; i++) {
+    const ShaderArchiveEntry &entry = entries[i];
+    // 64 bit sums, offset + size must not wrap around
+    if (uint64_t(entry.nameOffset) + entry.nameSize > size_ || uint64_t(entry.codeOffset) + entry.codeSize > size_ ||
+        entry.codeOffset % 4 != 0 || entry.codeSize % 4 != 0) {
+      ERROR_LOG("shader archive: {} has a broken entry {}, ignored", path, i);
+      blobs_.clear();
+      return false;
+    }
+    Blob blob;
+    blob.code = reinterpret_cast<const uint32_t *>(data_ + entry.codeOffset);
+    blob.size = entry.codeSize;
+    blob.hash = entry.hash;
+    blobs_.emplace(std::string(reinterpret_cast<const char *>(data_ + entry.nameOffset), entry.nameSize), blob);
+  }
+  return true;
+}
+
+void ShaderArchive::Close() {
+  blobs_.clear();
+  if (!data_) return;
+#if defined(_WIN32)
+  UnmapViewOfFile(data_);
+  CloseHandle(static_cast<HANDLE>(mapping_));
+  CloseHandle(static_cast<HANDLE>(file_));
+  file_ = mapping_ = nullptr;
+#else
+  munmap(const_cast<uint8_t *>(data_), size_);
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const ShaderArchive::Blob *ShaderArchive::Find(const std::string &name) const {
+  auto iter = blobs_.find(name);
+  return iter != blobs_.end() ? &iter->second : nullptr;
+}
+
+}  // namespace lvk
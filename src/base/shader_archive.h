@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace lvk {
+
+// shaders.pak layout: header, count entries, the name table, then the spir-v blobs.
+// every blob starts at a multiple of kShaderArchiveAlignment, a mapped blob can be passed as pCode as is
+constexpr uint32_t kShaderArchiveMagic = 0x534b564c;  // "LVKS"
+constexpr uint32_t kShaderArchiveVersion = 1;
+constexpr uint32_t kShaderArchiveAlignment = 16;
+
+struct ShaderArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+struct ShaderArchiveEntry {
+  // offsets from the start of the file
+  uint32_t nameOffset;
+  uint32_t nameSize;
+  uint32_t codeOffset;
+  uint32_t codeSize;
+  // ShaderCodeHash() of the blob, computed when packing
+  uint64_t hash;
+};
+
+// FNV-1a, shared by the packer and ShaderModuleCache so archived and loose shaders get the same key
+inline uint64_t ShaderCodeHash(const void *code, size_t size) {
+  const auto *bytes = static_cast<const uint8_t *>(code);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// 只读映射构建时打包的 shaders.pak, 按文件名查找 spir-v, 返回的指针直接指向映射的内存.
+// 映射在 Close() 或析构前一直有效.
+class ShaderArchive {
+ public:
+  struct Blob {
+    const uint32_t *code{nullptr};
+    size_t size{0};
+    uint64_t hash{0};
+  };
+
+  ShaderArchive() = default;
+  ~ShaderArchive() { Close(); }
+  ShaderArchive(const ShaderArchive &) = delete;
+  ShaderArchive &operator=(const ShaderArchive &) = delete;
+
+  // false when the file is missing or malformed, shaders are then read from loose .spv files
+  bool Open(const std::string &path);
+  void Close();
+
+  bool IsOpen() const { return data_ != nullptr; }
+  // name as stored by the packer, the file name of the .spv
+  const Blob *Find(const std::string &name) const;
+  size_t count() const { return blobs_.size(); }
+  size_t mappedBytes() const { return size_; }
+
+ private:
+  bool Index(const std::string &path);
+
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+#if defined(_WIN32)
+  void *file_{nullptr};
+  void *mapping_{nullptr};
+#endif
+  std::unordered_map<std::string, Blob> blobs_;
+};
+
+}  // namespace lvk
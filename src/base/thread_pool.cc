@@ -0,0 +1,62 @@
+#include "thread_pool.h"
+
+namespace lvk {
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+  workers_.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  jobAvailable_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+    pending_++;
+  }
+  jobAvailable_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  jobsDone_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      jobAvailable_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (stop_ && jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    job();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_--;
+      if (pending_ == 0) {
+        jobsDone_.notify_all();
+      }
+    }
+  }
+}
+
+}  // namespace lvk
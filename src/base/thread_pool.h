@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lvk {
+
+// 固定数量的工作线程, 用于把一帧里可以并行的工作(比如录制 secondary command buffer)分出去.
+// Submit() 之后调用 Wait() 等待所有任务结束.
+class ThreadPool {
+ public:
+  explicit ThreadPool(uint32_t threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void Submit(std::function<void()> job);
+  // run job on a worker and hand its result back through a future
+  template <typename Job>
+  std::future<std::invoke_result_t<Job>> Async(Job job) {
+    // std::function needs a copyable callable, the task is shared instead of moved in
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Job>()>>(std::move(job));
+    auto future = task->get_future();
+    Submit([task] { (*task)(); });
+    return future;
+  }
+  // block until every submitted job has finished
+  void Wait();
+
+  uint32_t size() const { return static_cast<uint32_t>(workers_.size()); }
+
+ private:
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable jobAvailable_;
+  std::condition_variable jobsDone_;
+  // queued + running jobs
+  uint32_t pending_{0};
+  bool stop_{false};
+};
+
+}  // namespace lvk
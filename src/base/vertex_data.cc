@@ -11,22 +11,24 @@ namespace lvk {
 
 // TODO: support non-interleaved vertex data
 VkPipelineVertexInputStateCreateInfo VertexLayout::GetPiplineVertexInputState() {
-  static std::vector<VkVertexInputBindingDescription> bindingDescriptions = {
+  // the returned state points into these, they are built once and never change afterwards
+  static const std::vector<VkVertexInputBindingDescription> bindingDescriptions = {
       lvk::initializers::VertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, sizeof(VertexLayout),
                                                        VK_VERTEX_INPUT_RATE_VERTEX)};
 
-  static std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
   // Attribute descriptions
   // Describes memory layout and shader positions
-  // Location 0 : Position
-  attributeDescriptions.push_back(lvk::initializers::VertexInputAttributeDescription(
-      VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexLayout, position)));
-  // Location 1 : Vertex normal
-  attributeDescriptions.push_back(lvk::initializers::VertexInputAttributeDescription(
-      VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexLayout, normal)));
-  // Location 2 : Texture coordinates
-  attributeDescriptions.push_back(lvk::initializers::VertexInputAttributeDescription(
-      VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexLayout, uv)));
+  static const std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {
+      // Location 0 : Position
+      lvk::initializers::VertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT,
+                                                         offsetof(VertexLayout, position)),
+      // Location 1 : Vertex normal
+      lvk::initializers::VertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT,
+                                                         offsetof(VertexLayout, normal)),
+      // Location 2 : Texture coordinates
+      lvk::initializers::VertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32_SFLOAT,
+                                                         offsetof(VertexLayout, uv)),
+  };
 
   VkPipelineVertexInputStateCreateInfo inputState = lvk::initializers::PipelineVertexInputStateCreateInfo();
   inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
@@ -1,7 +1,11 @@
+#include <cstdio>
 #include <cstdlib>
 #define NOMINMAX
+#include <glm/gtc/constants.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <algorithm>
+#include <format>
 #include <iostream>
 #include <ratio>
 #include <vector>
@@ -10,11 +14,13 @@
 #include "input.h"
 #include "lvk_log.h"
 #include "lvk_math.h"
+#include "lvk_trace.h"
 #include "vulkan_app.h"
 #include "vulkan_context.h"
 #include "vulkan_debug.h"
 #include "vulkan_device.h"
 #include "vulkan_initializers.h"
+#include "vulkan_memory_allocator.h"
 #include "vulkan_tools.h"
 #include "vulkan_ui.h"
 #include "window.h"
@@ -28,6 +34,21 @@
 namespace lvk {
 std::vector<const char *> VulkanApp::args;
 
+// how the base pass gets each draw's texture, printed with the descriptor counters
+static const char *TextureBindingName(const VulkanContext *context) {
+  if (context->IsBindlessTextures()) return "bindless";
+  if (context->IsPushDescriptors()) return "push descriptors";
+  return "descriptor sets";
+}
+
+// whether the pipelines of this run were compiled against a cache loaded from disk
+static std::string PipelineCacheStartName(const VulkanContext *context) {
+  const auto &file = context->GetPipelineCacheFile();
+  if (file.path().empty()) return "no cache file";
+  if (file.loadedBytes() == 0) return "cold start";
+  return std::format("warm start, {} KB", file.loadedBytes() / 1024);
+}
+
 void DefaultCameraMoveInput::OnDirectionInput(const DirectionInput &di) {
   // DEBUG_LOG("direction input: {}, {}", (int)di.direction, di.scale);
   if (di.direction == kInputDirection::Forward) {
@@ -189,12 +210,123 @@ void DefaultCameraMoveInput::Update(float delta_time) {
 #endif
 }
 
+VulkanApp::VulkanApp() {
+  // Command line arguments
+  commandLineParser.add("help", {"--help"}, 0, "Show help");
+  commandLineParser.add("gpuselection", {"-g", "--gpu"}, 1, "Select GPU to run on");
+  commandLineParser.add("framesinflight", {"-fif", "--framesinflight"}, 1,
+                        "Number of frames in flight (default 2)");
+  commandLineParser.add("recordthreads", {"-rt", "--recordthreads"}, 1,
+                        "Record secondary command buffers on N worker threads (default 0, serial)");
+  commandLineParser.add("indirect", {"--indirect"}, 0, "Submit the draws of each pass with vkCmdDrawIndexedIndirect");
+  commandLineParser.add("gpuculling", {"--gpuculling"}, 0,
+                        "Frustum cull the draws in a compute shader, implies --indirect");
+  commandLineParser.add("cpuculling", {"--cpuculling"}, 0,
+                        "Frustum cull the camera draws on the cpu, ignored with --gpuculling");
+  commandLineParser.add("bindless", {"--bindless"}, 0,
+                        "Bind all textures once as one descriptor array, needs descriptor indexing");
+  commandLineParser.add("pushdescriptors", {"--pushdescriptors"}, 0,
+                        "Push each draw's texture with VK_KHR_push_descriptor, ignored with --bindless");
+  commandLineParser.add("pipelinecache", {"--pipelinecache"}, 1,
+                        "Keep the pipeline cache in this file (default pipeline_cache.bin), none disables it");
+  commandLineParser.add("coldpipelines", {"--coldpipelines"}, 0,
+                        "Ignore the pipeline cache file on startup, it is still written");
+  commandLineParser.add("pipelinethreads", {"--pipelinethreads"}, 1,
+                        "Compile the pipelines of the scene on this many threads (default 0: main thread)");
+  commandLineParser.add("pipelinefallback", {"--pipelinefallback"}, 0,
+                        "Draw with a flat color pipeline until a material's pipeline is compiled");
+  commandLineParser.add("shaderarchive", {"--shaderarchive"}, 1,
+                        "Map shaders from this packed archive (default shaders.pak), none loads loose .spv files");
+  commandLineParser.add("headless", {"--headless"}, 0, "Render offscreen without a window, e.g. on lavapipe");
+  commandLineParser.add("frames", {"--frames"}, 1, "Number of frames rendered in headless mode (default 300)");
+  commandLineParser.add("capture", {"--capture"}, 1, "Write headless frames as png into this directory");
+  commandLineParser.add("captureinterval", {"--captureinterval"}, 1,
+                        "Capture every N-th headless frame (default: only the last one)");
+  commandLineParser.add("trace", {"--trace"}, 1, "Write a chrome/perfetto trace json of --traceframes to this file");
+  commandLineParser.add("traceframes", {"--traceframes"}, 1, "Traced frame range first-last (default 0-100)");
+}
+
 bool VulkanApp::InitVulkan() {
   VkResult err;
   VulkanContextOptions ctx_options;
 
-  context_ = new VulkanContext();
-  window_ = Window::NewWindow(WindowType::Glfw, width, height);
+  commandLineParser.parse(args);
+  if (commandLineParser.isSet("help")) {
+    commandLineParser.printHelp();
+  }
+  if (commandLineParser.isSet("framesinflight")) {
+    settings.framesInFlight = commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight);
+  }
+  if (commandLineParser.isSet("recordthreads")) {
+    settings.recordThreads = commandLineParser.getValueAsInt("recordthreads", settings.recordThreads);
+  }
+  if (commandLineParser.isSet("indirect")) {
+    settings.indirectDraws = true;
+  }
+  if (commandLineParser.isSet("gpuculling")) {
+    settings.gpuCulling = true;
+    settings.indirectDraws = true;
+  }
+  if (commandLineParser.isSet("cpuculling")) {
+    settings.cpuCulling = true;
+  }
+  if (commandLineParser.isSet("bindless")) {
+    settings.bindlessTextures = true;
+  }
+  if (commandLineParser.isSet("pushdescriptors")) {
+    settings.pushDescriptors = true;
+  }
+  if (commandLineParser.isSet("pipelinecache")) {
+    settings.pipelineCachePath = commandLineParser.getValueAsString("pipelinecache", settings.pipelineCachePath);
+    if (settings.pipelineCachePath == "none") {
+      settings.pipelineCachePath.clear();
+    }
+  }
+  if (commandLineParser.isSet("coldpipelines")) {
+    settings.coldPipelineCache = true;
+  }
+  if (commandLineParser.isSet("pipelinethreads")) {
+    settings.pipelineThreads = commandLineParser.getValueAsInt("pipelinethreads", settings.pipelineThreads);
+  }
+  if (commandLineParser.isSet("pipelinefallback")) {
+    settings.pipelineFallback = true;
+  }
+  if (commandLineParser.isSet("shaderarchive")) {
+    settings.shaderArchivePath = commandLineParser.getValueAsString("shaderarchive", settings.shaderArchivePath);
+    if (settings.shaderArchivePath == "none") {
+      settings.shaderArchivePath.clear();
+    }
+  }
+  if (commandLineParser.isSet("headless")) {
+    settings.headless = true;
+    settings.headlessFrames = commandLineParser.getValueAsInt("frames", settings.headlessFrames);
+    settings.captureDir = commandLineParser.getValueAsString("capture", settings.captureDir);
+    settings.captureInterval = commandLineParser.getValueAsInt("captureinterval", settings.captureInterval);
+  }
+  if (commandLineParser.isSet("trace")) {
+    uint32_t first = 0, last = 100;
+    std::string range = commandLineParser.getValueAsString("traceframes", "0-100");
+    if (sscanf(range.c_str(), "%u-%u", &first, &last) != 2) {
+      std::cerr << "invalid --traceframes " << range << ", expected first-last\n";
+    }
+    trace::Configure(commandLineParser.getValueAsString("trace", "trace.json"), first, last);
+  }
+  ctx_options.maxFramesInFlight = settings.framesInFlight;
+  ctx_options.recordThreads = settings.recordThreads;
+  ctx_options.indirectDraws = settings.indirectDraws;
+  ctx_options.gpuCulling = settings.gpuCulling;
+  ctx_options.cpuCulling = settings.cpuCulling;
+  ctx_options.bindlessTextures = settings.bindlessTextures;
+  ctx_options.pushDescriptors = settings.pushDescriptors;
+  ctx_options.pipelineCachePath = settings.pipelineCachePath;
+  ctx_options.coldPipelineCache = settings.coldPipelineCache;
+  ctx_options.pipelineThreads = settings.pipelineThreads;
+  ctx_options.pipelineFallback = settings.pipelineFallback;
+  ctx_options.shaderArchivePath = settings.shaderArchivePath;
+
+  context_ = new VulkanContext(settings.headless);
+  // no window in headless mode, nothing is presented
+  window_ = settings.headless ? nullptr : Window::NewWindow(WindowType::Glfw, width, height);
   ctx_options.window = window_;
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -269,6 +401,47 @@ bool VulkanApp::InitVulkan() {
   // Derived examples can override this to set actual features (based on above
   // readings) to enable for logical device creation
   GetEnabledFeatures();
+  // indirect commands start at the group's first instance slot, without it firstInstance must be 0
+  if (settings.indirectDraws && !deviceFeatures.drawIndirectFirstInstance) {
+    std::cerr << "drawIndirectFirstInstance is not supported, falling back to direct draws\n";
+    settings.indirectDraws = ctx_options.indirectDraws = false;
+    settings.gpuCulling = ctx_options.gpuCulling = false;
+  }
+  if (settings.indirectDraws) {
+    enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+  }
+  // without it every indirect draw is its own vkCmdDrawIndexedIndirect
+  if (settings.indirectDraws && deviceFeatures.multiDrawIndirect) {
+    enabledFeatures.multiDrawIndirect = VK_TRUE;
+  }
+  VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  // queried on its own so a sample's chain doesn't hide the framework's features
+  if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceFeatures2 features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features2.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+  }
+  // culled draws are compacted on the gpu and their count read with vkCmdDrawIndexedIndirectCount
+  if (settings.gpuCulling && features12.drawIndirectCount) {
+    enabledFeatures12.drawIndirectCount = VK_TRUE;
+    ctx_options.drawIndirectCount = true;
+  }
+  // the texture array is sized per scene, partially written and indexed per draw inside one multi draw
+  if (settings.bindlessTextures) {
+    if (features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound &&
+        features12.descriptorBindingVariableDescriptorCount && features12.shaderSampledImageArrayNonUniformIndexing) {
+      enabledFeatures12.runtimeDescriptorArray = VK_TRUE;
+      enabledFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+      enabledFeatures12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+      enabledFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    } else {
+      std::cerr << "descriptor indexing is not supported, falling back to one texture set per draw\n";
+      settings.bindlessTextures = ctx_options.bindlessTextures = false;
+    }
+  }
+  if (ctx_options.drawIndirectCount || settings.bindlessTextures) {
+    ChainEnabledFeatures12();
+  }
   std::cout << "GetEnabledFeatures " << std::endl;
 
   // Vulkan device creation
@@ -282,7 +455,8 @@ bool VulkanApp::InitVulkan() {
   std::cout << "GetEnabledExtensions " << std::endl;
 
   enabledDeviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
-  VkResult res = vulkanDevice->CreateLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+  VkResult res = vulkanDevice->CreateLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain,
+                                                   !settings.headless);
   if (res != VK_SUCCESS) {
     tools::ExitFatal("Could not create Vulkan device: \n" + tools::ErrorString(res), res);
     return false;
@@ -313,6 +487,11 @@ bool VulkanApp::InitVulkan() {
       .OnMouseClick = [this](int button, int action, int mod) { input_system_.OnMouseClick(button, action); },
   };
 
+  // headless runs follow a fixed camera path and draw no overlay, so the frames are reproducible
+  if (settings.headless) {
+    return true;
+  }
+
   window_->SetEventCallbacks(callbacks);
   camera_move_input_ = new DefaultCameraMoveInput(scene.GetCamera());
   input_system_.AddInputComponent(camera_move_input_);
@@ -324,12 +503,19 @@ bool VulkanApp::InitVulkan() {
 }
 
 void VulkanApp::NextFrame(double deltaTime) {
+  trace::BeginFrame(frameCounter);
+  LVK_TRACE_SCOPE("Frame");
   // auto tStart = std::chrono::high_resolution_clock::now();
   Render(deltaTime);
   frameCounter++;
 }
 
 void VulkanApp::RenderLoop() {
+  if (settings.headless) {
+    RenderHeadless();
+    return;
+  }
+
   auto start_time = std::chrono::high_resolution_clock::now();
   auto end_time = std::chrono::high_resolution_clock::now();
   auto diff_time = end_time - start_time;
@@ -338,6 +524,7 @@ void VulkanApp::RenderLoop() {
   double second = 2.0;
 
   while (!window_->ShouldClose()) {
+    LVK_TRACE_SCOPE("RenderLoop");
     window_->PollEvents();
     if (prepared) {
       auto diffm = std::chrono::duration<double, std::milli>(end_time - start_time).count();
@@ -354,6 +541,128 @@ void VulkanApp::RenderLoop() {
     }
   }
   vkDeviceWaitIdle(device);
+  // the window was closed before the traced range ended
+  trace::Flush();
+}
+
+void VulkanApp::RenderHeadless() {
+  // fixed time step, animations depend on the frame number only
+  const double delta_time = 1.0 / 60.0;
+  const uint32_t frame_count = std::max(1u, settings.headlessFrames);
+
+  std::vector<double> frame_ms;
+  frame_ms.reserve(frame_count);
+  auto run_start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < frame_count; i++) {
+    UpdateHeadlessCamera(i);
+
+    bool last_frame = i + 1 == frame_count;
+    bool capture = settings.captureInterval > 0 ? (i % settings.captureInterval == 0) : last_frame;
+    if (!settings.captureDir.empty() && capture) {
+      context_->RequestCapture(std::format("{}/frame_{:05}.png", settings.captureDir, i));
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    NextFrame(delta_time);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    frame_ms.push_back(std::chrono::duration<double, std::milli>(end_time - start_time).count());
+  }
+  vkDeviceWaitIdle(device);
+  auto run_end = std::chrono::high_resolution_clock::now();
+  trace::Flush();
+
+  double total_ms = std::chrono::duration<double, std::milli>(run_end - run_start).count();
+  std::sort(frame_ms.begin(), frame_ms.end());
+  std::cout << std::format("headless: {} frames on {}, total {:.2f} ms, avg {:.3f} ms, min {:.3f} ms, "
+                           "median {:.3f} ms, max {:.3f} ms\n",
+                           frame_count, deviceProperties.deviceName, total_ms, total_ms / frame_count, frame_ms.front(),
+                           frame_ms[frame_ms.size() / 2], frame_ms.back());
+  const auto memory_stats = vulkanDevice->allocator()->GetStats();
+  std::cout << std::format("headless: memory {} allocations in {} blocks + {} dedicated, {:.1f} / {:.1f} MB\n",
+                           memory_stats.allocationCount, memory_stats.blockCount, memory_stats.dedicatedCount,
+                           memory_stats.allocatedBytes / (1024.0 * 1024.0),
+                           memory_stats.reservedBytes / (1024.0 * 1024.0));
+  // per type and per block fragmentation, interactive runs show the totals in the overlay only
+  std::cout << vulkanDevice->allocator()->Report();
+  const auto &descriptor_stats = context_->GetDescriptorBindingStats();
+  std::cout << std::format("headless: {}, {} set binds and {} pushes per frame, record {:.3f} ms\n",
+                           TextureBindingName(context_), descriptor_stats.setBinds, descriptor_stats.pushes,
+                           context_->GetFrameStats().recordMs);
+  std::cout << std::format("headless: {} object sets written, {} nodes reused a set with the same texture\n",
+                           descriptor_stats.objectSets, descriptor_stats.sharedObjectSets);
+  if (!settings.indirectDraws) {
+    const auto &sort_stats = context_->GetDrawSortStats();
+    std::cout << std::format("headless: {} sorted draws, {} state changes avoided, sort {:.3f} ms\n",
+                             sort_stats.draws, sort_stats.avoidedStateChanges, sort_stats.sortMs);
+  }
+  const auto pipeline_stats = context_->GetPipelineStateCacheStats();
+  std::cout << std::format("headless: {} pipelines, {} state cache hits, {} misses, created in {:.2f} ms ({}), "
+                           "waited {:.2f} ms\n",
+                           pipeline_stats.pipelines, pipeline_stats.hits, pipeline_stats.misses,
+                           pipeline_stats.createMs, PipelineCacheStartName(context_), pipeline_stats.waitMs);
+  const auto &shader_stats = context_->GetShaderModuleCacheStats();
+  std::cout << std::format("headless: {} shader modules ({} KB spir-v), {} references, {} hits, {} misses "
+                           "({} from the archive), {} destroyed\n",
+                           shader_stats.modules, shader_stats.codeBytes / 1024, shader_stats.references,
+                           shader_stats.hits, shader_stats.misses, shader_stats.archived, shader_stats.destroyed);
+  const auto &texture_stats = context_->GetTextureCacheStats();
+  std::cout << std::format("headless: {} textures ({:.2f} MB), {} references, {} hits, {} misses, {} destroyed\n",
+                           texture_stats.textures, texture_stats.gpuBytes / (1024.0 * 1024.0),
+                           texture_stats.references, texture_stats.hits, texture_stats.misses,
+                           texture_stats.destroyed);
+  const auto &pool_stats = context_->GetDescriptorAllocatorStats();
+  std::cout << std::format("headless: {} descriptor sets in {} pools, {} pools chained\n", pool_stats.sets,
+                           pool_stats.pools, pool_stats.grows);
+  if (settings.gpuCulling) {
+    const auto &culling_stats = context_->GetGpuCullingStats();
+    std::cout << std::format("headless: gpu culling, camera {} nodes in {} draws, light {} nodes in {} draws\n",
+                             culling_stats.visibleInstances[0], culling_stats.draws[0],
+                             culling_stats.visibleInstances[1], culling_stats.draws[1]);
+  }
+  if (context_->IsCpuCulling()) {
+    const auto &cull_stats = context_->GetFrustumCullStats();
+    std::cout << std::format("headless: cpu culling, {} visible, {} culled, {} bounds updated, {:.3f} ms\n",
+                             cull_stats.visible, cull_stats.culled, cull_stats.updated, cull_stats.cullMs);
+  }
+  for (const auto &gpu_scope : context_->GetGpuProfiler()->GetStats()) {
+    std::cout << std::format("headless: gpu {}: min {:.3f} ms, avg {:.3f} ms, p99 {:.3f} ms ({} samples)\n",
+                             gpu_scope.name, gpu_scope.minMs, gpu_scope.avgMs, gpu_scope.p99Ms, gpu_scope.samples);
+  }
+}
+
+// 沿初始朝向前后推拉, 同时左右小幅摇头, 一个周期正好是整个 headless 运行
+void VulkanApp::UpdateHeadlessCamera(uint32_t frame) {
+  Camera *camera = scene.GetCamera();
+  if (frame == 0) {
+    headlessCameraLocation_ = camera->GetLocation();
+    headlessCameraRotation_ = camera->GetRotation();
+    headlessCameraForward_ = camera->GetForwardVector();
+  }
+
+  const float dolly = 1.0f;
+  const float yaw = 15.0f;
+  float phase = glm::two_pi<float>() * frame / std::max(1u, settings.headlessFrames);
+  vec3f location = headlessCameraLocation_ + headlessCameraForward_ * (dolly * glm::sin(phase));
+  vec3f rotation = headlessCameraRotation_ + vec3f(0.0f, yaw * glm::sin(phase), 0.0f);
+  camera->SetLocationAndRotation(location, rotation);
+}
+
+// 样例的 pNext 链里已有 1.2 features 时合并进去, 同一结构在链里只能出现一次
+void VulkanApp::ChainEnabledFeatures12() {
+  for (auto *node = static_cast<VkBaseOutStructure *>(deviceCreatepNextChain); node; node = node->pNext) {
+    if (node->sType != VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES) {
+      continue;
+    }
+    auto *sample12 = reinterpret_cast<VkPhysicalDeviceVulkan12Features *>(node);
+    sample12->drawIndirectCount |= enabledFeatures12.drawIndirectCount;
+    sample12->runtimeDescriptorArray |= enabledFeatures12.runtimeDescriptorArray;
+    sample12->descriptorBindingPartiallyBound |= enabledFeatures12.descriptorBindingPartiallyBound;
+    sample12->descriptorBindingVariableDescriptorCount |= enabledFeatures12.descriptorBindingVariableDescriptorCount;
+    sample12->shaderSampledImageArrayNonUniformIndexing |= enabledFeatures12.shaderSampledImageArrayNonUniformIndexing;
+    return;
+  }
+  enabledFeatures12.pNext = deviceCreatepNextChain;
+  deviceCreatepNextChain = &enabledFeatures12;
 }
 
 std::string VulkanApp::GetShadersPath() const { return ""; }
@@ -361,7 +670,6 @@ std::string VulkanApp::GetShadersPath() const { return ""; }
 void VulkanApp::Prepare() {
   InitScene();
   context_->CreateVulkanScene(&scene, vulkanDevice);
-  context_->BuildCommandBuffers(&scene);
   prepared = true;
 }
 
@@ -385,6 +693,7 @@ void VulkanApp::Render(double deltaTime) {
 }
 
 void VulkanApp::Update(float delta_time) {
+  LVK_TRACE_FUNCTION();
   if (!prepared) return;
   if (camera_move_input_) {
     camera_move_input_->Update(delta_time);
@@ -392,6 +701,7 @@ void VulkanApp::Update(float delta_time) {
 }
 
 void VulkanApp::UpdateOverlay(Scene *scene) {
+  if (settings.headless) return;
   // if (!settings.overlay)
   // 	return;
 
@@ -423,7 +733,62 @@ void VulkanApp::UpdateOverlay(Scene *scene) {
                ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
   ImGui::TextUnformatted("Title Here!");
   ImGui::TextUnformatted("deviceProperties.deviceName");
-  ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / 60), 60);
+  const auto &frame_stats = context_->GetFrameStats();
+  ImGui::Text("%.2f ms/frame (%.1f fps)", frame_stats.cpuFrameMs,
+              frame_stats.cpuFrameMs > 0.0 ? 1000.0 / frame_stats.cpuFrameMs : 0.0);
+  ImGui::Text("frames in flight: %u", frame_stats.framesInFlight);
+  ImGui::Text("gpu wait: %.2f ms, overlap: %.0f%%", frame_stats.fenceWaitMs, frame_stats.overlap * 100.0);
+  ImGui::Text("record: %.2f ms on %u threads", frame_stats.recordMs, frame_stats.recordThreads);
+  const auto &upload_stats = context_->GetUniformUploadStats();
+  ImGui::Text("uniforms: %llu B uploaded, %llu B skipped", (unsigned long long)upload_stats.uploadedBytes,
+              (unsigned long long)upload_stats.skippedBytes);
+  ImGui::Text("dirty nodes: %u in %u ranges", upload_stats.dirtyNodes, upload_stats.dirtyRanges);
+  const auto &instancing_stats = context_->GetInstancingStats();
+  ImGui::Text("draws: %u instanced draws for %u nodes%s", instancing_stats.draws, instancing_stats.instances,
+              settings.indirectDraws ? ", indirect" : "");
+  const auto &descriptor_stats = context_->GetDescriptorBindingStats();
+  ImGui::Text("%s: %u set binds, %u pushes, %u object sets (%u shared)", TextureBindingName(context_),
+              descriptor_stats.setBinds, descriptor_stats.pushes, descriptor_stats.objectSets,
+              descriptor_stats.sharedObjectSets);
+  if (!settings.indirectDraws) {
+    const auto &sort_stats = context_->GetDrawSortStats();
+    ImGui::Text("sorted draws: %u, %u state changes avoided, sort %.3f ms", sort_stats.draws,
+                sort_stats.avoidedStateChanges, sort_stats.sortMs);
+  }
+  const auto pipeline_stats = context_->GetPipelineStateCacheStats();
+  ImGui::Text("pipelines: %u, %u hits, %u misses, created in %.2f ms (%s), waited %.2f ms", pipeline_stats.pipelines,
+              pipeline_stats.hits, pipeline_stats.misses, pipeline_stats.createMs,
+              PipelineCacheStartName(context_).c_str(), pipeline_stats.waitMs);
+  const auto &shader_stats = context_->GetShaderModuleCacheStats();
+  ImGui::Text("shader modules: %u (%llu KB), %u refs, %u hits, %u misses (%u archived), %u destroyed",
+              shader_stats.modules, static_cast<unsigned long long>(shader_stats.codeBytes / 1024),
+              shader_stats.references, shader_stats.hits, shader_stats.misses, shader_stats.archived,
+              shader_stats.destroyed);
+  const auto &texture_stats = context_->GetTextureCacheStats();
+  ImGui::Text("textures: %u (%.2f MB), %u refs, %u hits, %u misses, %u destroyed", texture_stats.textures,
+              texture_stats.gpuBytes / (1024.0 * 1024.0), texture_stats.references, texture_stats.hits,
+              texture_stats.misses, texture_stats.destroyed);
+  const auto &pool_stats = context_->GetDescriptorAllocatorStats();
+  ImGui::Text("descriptor sets: %u in %u pools, %u chained", pool_stats.sets, pool_stats.pools, pool_stats.grows);
+  if (settings.gpuCulling) {
+    const auto &culling_stats = context_->GetGpuCullingStats();
+    ImGui::Text("gpu culling: camera %u nodes in %u draws, light %u nodes in %u draws",
+                culling_stats.visibleInstances[0], culling_stats.draws[0], culling_stats.visibleInstances[1],
+                culling_stats.draws[1]);
+  }
+  if (context_->IsCpuCulling()) {
+    const auto &cull_stats = context_->GetFrustumCullStats();
+    ImGui::Text("cpu culling: %u visible, %u culled, %u bounds updated, %.3f ms", cull_stats.visible,
+                cull_stats.culled, cull_stats.updated, cull_stats.cullMs);
+  }
+  const auto memory_stats = vulkanDevice->allocator()->GetStats();
+  ImGui::Text("memory: %u allocations in %u blocks + %u dedicated, %.1f / %.1f MB", memory_stats.allocationCount,
+              memory_stats.blockCount, memory_stats.dedicatedCount, memory_stats.allocatedBytes / (1024.0 * 1024.0),
+              memory_stats.reservedBytes / (1024.0 * 1024.0));
+  for (const auto &gpu_scope : context_->GetGpuProfiler()->GetStats()) {
+    ImGui::Text("gpu %s: %.3f ms (min %.3f avg %.3f p99 %.3f)", gpu_scope.name.c_str(), gpu_scope.lastMs,
+                gpu_scope.minMs, gpu_scope.avgMs, gpu_scope.p99Ms);
+  }
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
   ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * ui.scale));
@@ -441,10 +806,8 @@ void VulkanApp::UpdateOverlay(Scene *scene) {
   ImGui::PopStyleVar();
   ImGui::Render();
 
-  if (ui_.Update() || ui_.updated) {
-    context_->BuildCommandBuffers(scene);
-    ui_.updated = false;
-  }
+  // the draw data is copied into the ui buffers of the next frame when it records, after its fence wait
+  ui_.updated = false;
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
   if (mouseState.buttons.left) {
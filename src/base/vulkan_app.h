@@ -74,6 +74,38 @@ class VulkanApp {
     bool vsync = false;
     /** @brief Enable UI overlay */
     bool overlay = true;
+    /** @brief Number of frames the cpu may record ahead of the gpu */
+    uint32_t framesInFlight = 2;
+    /** @brief Worker threads recording secondary command buffers, 0 records serially */
+    uint32_t recordThreads = 0;
+    /** @brief Submit the draws of each pass with vkCmdDrawIndexedIndirect */
+    bool indirectDraws = false;
+    /** @brief Frustum cull camera and shadow draws in a compute pass, implies indirectDraws */
+    bool gpuCulling = false;
+    /** @brief Frustum cull the camera draws on the cpu with per-section bounds, ignored with gpuCulling */
+    bool cpuCulling = false;
+    /** @brief Bind every texture once as a descriptor indexing array instead of one set per draw */
+    bool bindlessTextures = false;
+    /** @brief Push each draw's texture with VK_KHR_push_descriptor instead of allocating a set per node */
+    bool pushDescriptors = false;
+    /** @brief File the VkPipelineCache is kept in between runs, empty disables it */
+    std::string pipelineCachePath = "pipeline_cache.bin";
+    /** @brief Ignore the pipeline cache file on startup to time a cold start */
+    bool coldPipelineCache = false;
+    /** @brief Threads compiling the pipelines of a scene in parallel, 0 compiles them on the main thread */
+    uint32_t pipelineThreads = 0;
+    /** @brief Draw with a flat color pipeline while a material's pipeline is still compiling */
+    bool pipelineFallback = false;
+    /** @brief Packed SPIR-V built next to the .spv files, empty loads the loose files only */
+    std::string shaderArchivePath = "shaders.pak";
+    /** @brief Render offscreen without window and swapchain, for CI on software vulkan (lavapipe) */
+    bool headless = false;
+    /** @brief Number of frames rendered in headless mode */
+    uint32_t headlessFrames = 300;
+    /** @brief Directory the headless frames are written to as png, empty disables readback */
+    std::string captureDir;
+    /** @brief Write every N-th headless frame, 0 writes only the last one */
+    uint32_t captureInterval = 0;
   } settings;
 
   std::string title = "Vulkan Example";
@@ -97,6 +129,8 @@ class VulkanApp {
   VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
   VkPhysicalDeviceFeatures enabledFeatures{};
   void *deviceCreatepNextChain = nullptr;
+  // Vulkan 1.2 features enabled by the framework itself, chained into deviceCreatepNextChain
+  VkPhysicalDeviceVulkan12Features enabledFeatures12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
   VkDevice device;
   // VkQueue queue;
   // Depth buffer format (selected during Vulkan initialization)
@@ -157,8 +191,16 @@ class VulkanApp {
   virtual void InitScene() {}
   void UpdateOverlay(Scene* scene);
 
+  void UpdateHeadlessCamera(uint32_t frame);
+  // links enabledFeatures12 in front of the sample's deviceCreatepNextChain
+  void ChainEnabledFeatures12();
+
   private:
     VulkanUI ui_;
+    // camera pose the headless camera path starts from
+    vec3f headlessCameraLocation_;
+    vec3f headlessCameraRotation_;
+    vec3f headlessCameraForward_;
 #ifdef ENABLE_RENDERDOC
     void *rdoc_api_{nullptr};
 #endif
@@ -168,6 +210,8 @@ class VulkanApp {
   
   virtual void Prepare();
   void RenderLoop();
+  // fixed frame count, fixed time step and camera path, prints the frame timings at the end
+  void RenderHeadless();
   bool InitVulkan();
   // window
   void HandleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -179,6 +223,7 @@ class VulkanApp {
   void StartRenderdoc();
   void EndRenderdoc();
 
+  VulkanApp();
   virtual ~VulkanApp() {}
 };
 }  // namespace lvk
\ No newline at end of file
@@ -9,19 +9,20 @@
 
 namespace lvk {
 
+// host visible memory is mapped once by the allocator, Map/Unmap only hand out and drop the pointer
 VkResult VulkanBuffer::Map(VkDeviceSize size, VkDeviceSize offset) {
-  auto result = vkMapMemory(device_, memory_, offset, size, 0, &mapped_);
-  return result;
-}
-
-void VulkanBuffer::Unmap() {
-  if (mapped_) {
-    vkUnmapMemory(device_, memory_);
-    mapped_ = nullptr;
+  if (!allocation_.mapped) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
   }
+  mapped_ = allocation_.mapped + offset;
+  return VK_SUCCESS;
 }
 
-VkResult VulkanBuffer::Bind(VkDeviceSize offset) { return vkBindBufferMemory(device_, buffer_, memory_, offset); }
+void VulkanBuffer::Unmap() { mapped_ = nullptr; }
+
+VkResult VulkanBuffer::Bind(VkDeviceSize offset) {
+  return vkBindBufferMemory(device_, buffer_, allocation_.memory, allocation_.offset + offset);
+}
 
 void VulkanBuffer::SetupDescriptor(VkDeviceSize size, VkDeviceSize offset) {
   descriptor_.offset = offset;
@@ -35,24 +36,21 @@ void VulkanBuffer::CopyTo(const void* data, VkDeviceSize size) {
 }
 
 VkResult VulkanBuffer::Flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory_;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange = allocator_->MappedRange(allocation_, offset, size);
   return vkFlushMappedMemoryRanges(device_, 1, &mappedRange);
 }
 
 VkResult VulkanBuffer::Invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory_;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange = allocator_->MappedRange(allocation_, offset, size);
   return vkInvalidateMappedMemoryRanges(device_, 1, &mappedRange);
 }
 
 void VulkanBuffer::Update(const uint8_t* data, const VkDeviceSize size, const VkDeviceSize offset) {
+  // persistently mapped (whole buffer), write in place without a map/unmap round trip
+  if (mapped_) {
+    memcpy(reinterpret_cast<uint8_t*>(mapped_) + offset, data, size);
+    return;
+  }
   Map(size, offset);
   CopyTo(data, size);
   Unmap();
@@ -62,8 +60,8 @@ void VulkanBuffer::Destroy() {
   if (buffer_) {
     vkDestroyBuffer(device_, buffer_, nullptr);
   }
-  if (memory_) {
-    vkFreeMemory(device_, memory_, nullptr);
+  if (allocator_) {
+    allocator_->Free(allocation_);
   }
 
   delete this;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vulkan/vulkan.h"
+#include "vulkan_memory_allocator.h"
 
 namespace lvk {
 class VulkanBuffer {
@@ -10,7 +11,8 @@ class VulkanBuffer {
   void set_deivce(VkDevice device) { device_ = device; }
   VkBuffer buffer() { return buffer_; }
   const VkBuffer * bufferp() { return &buffer_; }
-  VkDeviceMemory memory() { return memory_; }
+  VkDeviceMemory memory() { return allocation_.memory; }
+  const VulkanAllocation& allocation() const { return allocation_; }
   VkResult Map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
   void Unmap();
   VkResult Bind(VkDeviceSize offset = 0);
@@ -32,7 +34,9 @@ class VulkanBuffer {
  private:
   VkBuffer buffer_{VK_NULL_HANDLE};
   VkDevice device_;
-  VkDeviceMemory memory_{VK_NULL_HANDLE};
+  // the memory object is shared with other buffers, offsets passed in are relative to the allocation
+  VulkanMemoryAllocator* allocator_{nullptr};
+  VulkanAllocation allocation_;
   VkDeviceSize size_{0};
   VkDeviceSize alignment_{0};
   void* mapped_{nullptr};
@@ -1,17 +1,25 @@
 #include "vulkan_context.h"
 
-#include <corecrt_malloc.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <filesystem>
 #include <format>
 #include <iostream>
+#include <map>
+#include <utility>
 #include <vector>
 
 #include "directional_light.h"
+#include "lvk_log.h"
 #include "lvk_math.h"
+#include "lvk_trace.h"
 #include "node.h"
 #include "primitives.h"
 #include "scene.h"
+#include "stb_image_write.h"
 #include "vertex_data.h"
 #include "vulkan/vulkan_core.h"
 #include "vulkan_debug.h"
@@ -21,51 +29,76 @@
 #include "vulkan_tools.h"
 #include "vulkan_renderpass.h"
 #include "vulkan_renderpass_shadow.h"
+#include "vulkan_upload_batch.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 
 namespace lvk {
 
-static VkClearColorValue defaultClearColor = {{0.025f, 0.025f, 0.025f, 1.0f}};
+// smaller chunks cost more in vkCmdExecuteCommands than they save in recording
+static constexpr uint32_t kMinDrawsPerChunk = 128;
 
-VulkanContext::VulkanContext() { VK_CHECK_RESULT(CreateInstance(true)); }
+VulkanContext::VulkanContext(bool headless) : headless_(headless) { VK_CHECK_RESULT(CreateInstance(true)); }
 
 VulkanContext::~VulkanContext() {
-  if (uniformBuffers_.model) {
-    free(uniformBuffers_.model);
+  // pipelines still compiling would be missing from the saved cache
+  pipelineStates_.WaitAll();
+  SavePipelineCache();
+  if (textureUpdateTemplate_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorUpdateTemplate(device_->device(), textureUpdateTemplate_, nullptr);
   }
-  for (const auto& tex : vkTextureList) {
-    delete tex;
+  retiredLayouts_.emplace_back(descriptorSetLayouts_, pipelineLayout_);
+  for (const auto& [set_layouts, pipeline_layout] : retiredLayouts_) {
+    vkDestroyPipelineLayout(device_->device(), pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device_->device(), set_layouts.shared, nullptr);
+    vkDestroyDescriptorSetLayout(device_->device(), set_layouts.object, nullptr);
+  }
+  gpuCulling_.Destroy();
+  descriptorAllocator_.Destroy();
+  pipelineStates_.Destroy();
+  if (pipelineCache_ != VK_NULL_HANDLE) {
+    vkDestroyPipelineCache(device_->device(), pipelineCache_, nullptr);
+  }
+  shaderModules_.Destroy();
+  uniformRing_.Destroy();
+  geometryArena_.Destroy();
+  gpuProfiler_.Destroy();
+  if (readbackBuffer_) {
+    readbackBuffer_->Destroy();
+  }
+  textureCache_.Destroy();
+  if (defaultTexture_) {
+    defaultTexture_->Destroy();
   }
 }
 
 void VulkanContext::InitWithOptions(const VulkanContextOptions& options, VkPhysicalDevice phy_device) {
   options_ = options;
+  pipelineCacheFile_ = VulkanPipelineCacheFile(options_.pipelineCachePath);
+  // culled draws only exist as indirect commands
+  if (options_.gpuCulling) {
+    options_.indirectDraws = true;
+  }
 
   vkGetDeviceQueue(device_->device(), device_->queueFamilyIndices_.graphics, 0, &queue_);
-
-  swapChain_.Connect(instance_, phy_device, device_->device());
-
-  // Create synchronization objects
-  VkSemaphoreCreateInfo semaphoreCreateInfo = initializers::SemaphoreCreateInfo();
-  // Create a semaphore used to synchronize image presentation
-  // Ensures that the image is displayed before we start submitting new commands
-  // to the queue
-  VK_CHECK_RESULT(vkCreateSemaphore(device_->device(), &semaphoreCreateInfo, nullptr, &semaphores_.presentComplete));
-  // Create a semaphore used to synchronize command submission
-  // Ensures that the image is not presented until all commands have been
-  // submitted and executed
-  VK_CHECK_RESULT(vkCreateSemaphore(device_->device(), &semaphoreCreateInfo, nullptr, &semaphores_.renderComplete));
+  geometryArena_.Init(device_, queue_);
+  textureCache_.Init(device_, queue_);
+  const uint8_t white[4] = {255, 255, 255, 255};
+  defaultTexture_ = std::make_unique<VulkanTexture>(device_, "default", queue_);
+  defaultTexture_->LoadPixels(white, 1, 1);
+
+  if (!headless_) {
+    swapChain_.Connect(instance_, phy_device, device_->device());
+  }
 
   // Set up submit info structure
-  // Semaphores will stay the same during application lifetime
-  // Command buffer submission info is set by each example
+  // Semaphores and command buffer are set per frame in Draw()
+  // nothing is acquired or presented in headless mode, so there is nothing to wait on or signal
   submitInfo_ = initializers::SubmitInfo();
   submitInfo_.pWaitDstStageMask = &submitPipelineStages_;
-  submitInfo_.waitSemaphoreCount = 1;
-  submitInfo_.pWaitSemaphores = &semaphores_.presentComplete;
-  submitInfo_.signalSemaphoreCount = 1;
-  submitInfo_.pSignalSemaphores = &semaphores_.renderComplete;
+  submitInfo_.waitSemaphoreCount = headless_ ? 0 : 1;
+  submitInfo_.signalSemaphoreCount = headless_ ? 0 : 1;
+  submitInfo_.commandBufferCount = 1;
 }
 
 void VulkanContext::CreateVulkanScene(Scene* scene, VulkanDevice* device) {
@@ -80,18 +113,72 @@ void VulkanContext::CreateVulkanScene(Scene* scene, VulkanDevice* device) {
     }
   }
 
+  // render components prepare their pipelines in Prepare()
+  CreatePipelineCache();
   Prepare();
 
   std::cout << std::format("VulkanScene: Total Node: {}\n", scene->GetNodeCount());
 
-  // calc total mesh sections
+  // calc total mesh sections, nodes sharing a mesh share its sections in the geometry arena
   size_t num_sections = 0;
+  std::map<std::pair<int, size_t>, size_t> mesh_sections;
+  uint32_t arena_vertices = 0;
+  uint32_t arena_indices = 0;
   for (int i = 0; i < scene->GetNodeCount(); i++) {
-    num_sections += scene->GetResourceMesh(scene->GetNode(i)->mesh)->sections.size();
+    int mesh_handle = scene->GetNode(i)->mesh;
+    const PrimitiveMesh *mesh = scene->GetResourceMesh(mesh_handle);
+    num_sections += mesh->sections.size();
+    for (size_t j = 0; j < mesh->sections.size(); j++) {
+      if (mesh_sections.emplace(std::make_pair(mesh_handle, j), mesh_sections.size()).second) {
+        arena_vertices += static_cast<uint32_t>(mesh->sections[j].vertices.size());
+        arena_indices += static_cast<uint32_t>(mesh->sections[j].indices.size());
+      }
+    }
   }
 
+  // called again when the scene is rebuilt, the old ranges are overwritten below
+  if (!vkMeshList.empty()) {
+    vkDeviceWaitIdle(device_->device());
+  }
+  for (auto& vkmesh : vkMeshList) {
+    vkmesh.Release(&geometryArena_);
+  }
+  // the per node sets are gone in bindless mode, every material needs a shader reading the array
+  for (int i = 0; i < scene->GetNodeCount() && options_.bindlessTextures; i++) {
+    if (scene->GetResourceMaterial(scene->GetNode(i)->material)->bindlessFragShaderPath.empty()) {
+      ERROR_LOG("material {} has no bindless fragment shader, bindless textures disabled", scene->GetNode(i)->material);
+      options_.bindlessTextures = false;
+    }
+  }
+
+  // materials request their base pass pipelines while loading, which needs the pipeline layout
+  SetupDescriptorSetLayout(device);
+  pipelines_.clear();
+  if (options_.pipelineFallback) {
+    // requested first, so it is the first one a compile thread picks up
+    fallbackPipeline_ = basePass_->RequestPipeline(
+        {LoadVertexShader("fallback.vert.spv"), LoadFragmentShader("fallback.frag.spv")});
+  }
+
+  // every mesh and texture upload of the scene goes out in one submission
+  VulkanUploadBatch upload(device_, queue_);
+  geometryArena_.Reserve(arena_vertices, arena_indices, &upload);
+
+  // the old nodes keep their shaders and textures referenced until the new ones acquired theirs,
+  // modules and textures used by both scenes are not recreated
+  std::vector<ShaderModuleCache::Handle> old_shaders;
+  std::vector<VulkanTextureCache::Handle> old_textures;
+  for (const auto& vknode : vkNodeList) {
+    old_shaders.insert(old_shaders.end(), vknode.shaders.begin(), vknode.shaders.end());
+    old_textures.push_back(vknode.texture);
+  }
+  vkNodeList.clear();
   vkNodeList.resize(num_sections);
-  vkMeshList.resize(num_sections);
+  vkTextureList.clear();
+  // texture cache handle -> index into vkTextureList
+  std::unordered_map<VulkanTextureCache::Handle, int> texture_slots;
+  vkMeshList.clear();
+  vkMeshList.resize(mesh_sections.size());
 
   size_t index = 0;
   for (int i = 0; i < scene->GetNodeCount(); i++) {
@@ -101,129 +188,307 @@ void VulkanContext::CreateVulkanScene(Scene* scene, VulkanDevice* device) {
       const MeshSection* section = &mesh->sections[j];
 
       VulkanNode& vknode = vkNodeList[index];
-      PrimitiveMeshVK& vkmesh = vkMeshList[index];
-      vknode.vkMesh = &vkMeshList[index];
+      PrimitiveMeshVK& vkmesh = vkMeshList[mesh_sections[std::make_pair(node->mesh, static_cast<size_t>(j))]];
+      vknode.vkMesh = &vkmesh;
       vknode.sceneNode = node;
 
       index++;
 
-      vkmesh.CreateBuffer(section, device);
-      vkmesh.indexCount = section->indices.size();
+      // no-op for a section already added by another node
+      vkmesh.CreateBuffer(section, &geometryArena_, &upload);
 
       // std::cout << std::format("VulkanScene: CreateMessBuffer,NodeMesh:{},vkMesh:{}\n", node->mesh, i);
       if (node->materialParamters.textureList.size() > 0) {
+        // nodes using the same file share one VulkanTexture, and with it one set 1 and one bindless slot
         auto texture_handle = node->materialParamters.textureList[0];
-        auto texture = new VulkanTexture(device, scene->GetResourceTexture(texture_handle)->path, queue_);
-        texture->LoadTexture();
-        vkTextureList.push_back(texture);
-        vknode.vkTexture = vkTextureList.back();
-        vknode.vkTextureHandle = 0;//vkTextureList.size() - 1;
+        vknode.texture = textureCache_.Acquire(scene->GetResourceTexture(texture_handle)->path, {}, &upload);
+        if (vknode.texture != VulkanTextureCache::kInvalidHandle) {
+          auto [slot, inserted] = texture_slots.try_emplace(vknode.texture, static_cast<int>(vkTextureList.size()));
+          if (inserted) {
+            vkTextureList.push_back(textureCache_.texture(vknode.texture));
+          }
+          vknode.vkTexture = vkTextureList[slot->second];
+          vknode.vkTextureHandle = slot->second;
+        }
         // std::cout << std::format("VulkanScene: LoadTexture,vkTextureHandle:{}\n", vknode.vkTextureHandle);
       }
+      if (!vknode.vkTexture) {
+        // set 1 is still bound for the node, a missing file degrades to white instead of a null texture
+        vknode.vkTexture = defaultTexture_.get();
+      }
 
-      LoadMaterial(&vknode, scene->GetResourceMaterial(node->material), device);
+      if (!LoadMaterial(&vknode, scene->GetResourceMaterial(node->material), device)) {
+        // a pipeline without stages cannot be created, the node is drawn with the fallback shaders instead
+        ERROR_LOG("material {} is missing a shader, node {} uses the fallback shaders", node->material, i);
+        if (!AcquireShaders(&vknode, "fallback.vert.spv", "fallback.frag.spv")) {
+          tools::ExitFatal("fallback.vert.spv / fallback.frag.spv not found, the shaders were not built", -1);
+        }
+      }
       vknode.pipelineHandle = FindOrCreatePipeline(*node, vknode);
     }
   }
-
+  for (auto shader : old_shaders) {
+    shaderModules_.Release(shader);
+  }
+  for (auto texture : old_textures) {
+    textureCache_.Release(texture);
+  }
+  upload.Submit();
+  DEBUG_LOG("scene upload: {:.2f} MB in {} submissions", upload.uploadedBytes() / (1024.0 * 1024.0),
+            upload.submitCount());
+
+  std::vector<InstanceKey> instance_keys(vkNodeList.size());
+  groupedGenerations_.resize(vkNodeList.size());
+  for (uint32_t i = 0; i < vkNodeList.size(); i++) {
+    instance_keys[i] = MakeInstanceKey(i);
+    groupedGenerations_[i] = vkNodeList[i].sceneNode->generation();
+  }
+  instanceGroups_.SetTextureRuns(!options_.bindlessTextures);
+  instanceGroups_.Build(instance_keys);
+  instancingStats_ = {static_cast<uint32_t>(instanceGroups_.groups().size()), instanceGroups_.instanceCount(), 0};
+  DEBUG_LOG("instancing: {} nodes in {} draws", instancingStats_.instances, instancingStats_.draws);
+
+  if (IsCpuCulling()) {
+    frustumCuller_.Resize(static_cast<uint32_t>(vkNodeList.size()));
+    culledGenerations_.assign(vkNodeList.size(), UINT64_MAX);
+  }
   PrepareUniformBuffers(scene, device);
-  SetupDescriptorSetLayout(device);
+  if (options_.gpuCulling) {
+    // compaction draws several commands per call and reads their count from the buffer
+    const bool compact = options_.drawIndirectCount && device_->enabledFeatures().multiDrawIndirect;
+    gpuCulling_.Init(device_, static_cast<uint32_t>(frames_.size()), uniformRing_.alignment(), compact);
+    gpuCulling_.Create(DrawCapacity(), uniformRing_.buffer(), DrawCapacity() * sizeof(_InstanceData));
+  }
+  SetupDescriptorSets(device);
   BuildPipelines();
 
   for (auto pass : allRenderPass_) {
     pass->OnSceneChanged();
   }
 
-  for (int i = 0; i < vkNodeList.size(); i++) {
+  // bindless draws only bind the texture array of set 1, pushed textures need no set at all
+  for (int i = 0; i < vkNodeList.size() && !options_.bindlessTextures && !IsPushDescriptors(); i++) {
     FindOrCreateDescriptorSet(&vkNodeList[i]);
   }
   // SetupDescriptorSet();
 }
 
-#define MIN_ALIGNMENT 64
-#define UNIFORM_ALIGNMENT(size) ((size + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1))
-
 // TODO: use global proj & view matrix
 void VulkanContext::PrepareUniformBuffers(Scene* scene, VulkanDevice* device) {
-  size_t bufferSize = vkNodeList.size() * sizeof(_UBOMesh);
-
-  VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                       &uniformBuffers_.vertex_ub.buffer, bufferSize));
-  uniformBuffers_.vertex_ub.buffer_size = bufferSize;
-  uniformBuffers_.vertex_ub.alignment = sizeof(_UBOMesh);
-
-  size_t fragment_ub_size = vkNodeList.size() * sizeof(_UBOFragment);
-  VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                       &uniformBuffers_.fragment_ub.buffer, fragment_ub_size));
-  uniformBuffers_.fragment_ub.buffer_size = fragment_ub_size;
-  uniformBuffers_.fragment_ub.alignment = sizeof(_UBOFragment);
-
-  // save all model matrix
-  // TODO: necessay?
-  uniformBuffers_.model = reinterpret_cast<_UBOMesh*>(malloc(bufferSize));
-  uniformBuffers_.fragment_data = reinterpret_cast<_UBOFragment*>(malloc(fragment_ub_size));
-
-  // shared
-  size_t shared_ub_size = UNIFORM_ALIGNMENT(sizeof(_UBOShared));
-  VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                       &uniformBuffers_.shared_ub.buffer, shared_ub_size));
-  uniformBuffers_.shared_ub.buffer_size = shared_ub_size;
-  uniformBuffers_.shared_ub.alignment = shared_ub_size;
-  uniformBuffers_.shared = reinterpret_cast<_UBOShared*>(malloc(shared_ub_size));
-  memset(uniformBuffers_.shared, 0, shared_ub_size);
+  uniformRing_.Init(device);
+
+  // one slice per frame in flight: shared | instance data | draw data | indirect commands | visible list
+  // (| culling params | group data) (| camera visible list | camera indirect commands)
+  const VkDeviceSize capacity = DrawCapacity();
+  VkDeviceSize frame_size = uniformRing_.Align(sizeof(_UBOShared)) +
+                            uniformRing_.Align(capacity * sizeof(_InstanceData)) +
+                            uniformRing_.Align(capacity * sizeof(_DrawData)) +
+                            uniformRing_.Align(capacity * sizeof(VkDrawIndexedIndirectCommand)) +
+                            uniformRing_.Align(capacity * sizeof(uint32_t));
+  if (options_.gpuCulling) {
+    frame_size += uniformRing_.Align(sizeof(VulkanGpuCulling::Params)) +
+                  uniformRing_.Align(capacity * sizeof(VulkanGpuCulling::GroupData));
+  }
+  if (IsCpuCulling()) {
+    frame_size += uniformRing_.Align(capacity * sizeof(uint32_t)) +
+                  uniformRing_.Align(capacity * sizeof(VkDrawIndexedIndirectCommand));
+  }
+  uniformRing_.Create(frame_size, static_cast<uint32_t>(frames_.size()));
+
+  // nothing has been written yet, the first use of every slice uploads all nodes
+  uploadedGenerations_.assign(frames_.size() * vkNodeList.size(), UINT64_MAX);
+  uploadedInstanceLayouts_.assign(frames_.size(), UINT64_MAX);
 
   UpdateUniformBuffers(scene);
 }
 
 void VulkanContext::UpdateUniformBuffers(Scene* scene) {
+  LVK_TRACE_FUNCTION();
+  // the fence of currentFrame_ has been waited on, its slice is free to write
+  uniformRing_.BeginFrame(currentFrame_);
+  frameUniforms_.shared = uniformRing_.Allocate(sizeof(_UBOShared));
+  const VkDeviceSize capacity = DrawCapacity();
+  frameUniforms_.instance = uniformRing_.Allocate(capacity * sizeof(_InstanceData));
+  frameUniforms_.draw = uniformRing_.Allocate(capacity * sizeof(_DrawData));
+  frameUniforms_.indirect = uniformRing_.Allocate(capacity * sizeof(VkDrawIndexedIndirectCommand));
+  frameUniforms_.visible = uniformRing_.Allocate(capacity * sizeof(uint32_t));
+  if (options_.gpuCulling) {
+    frameUniforms_.cullParams = uniformRing_.Allocate(sizeof(VulkanGpuCulling::Params));
+    frameUniforms_.cullGroups = uniformRing_.Allocate(capacity * sizeof(VulkanGpuCulling::GroupData));
+  }
+  if (IsCpuCulling()) {
+    frameUniforms_.cameraVisible = uniformRing_.Allocate(capacity * sizeof(uint32_t));
+    frameUniforms_.cameraIndirect = uniformRing_.Allocate(capacity * sizeof(VkDrawIndexedIndirectCommand));
+  }
+
+  UpdateInstanceGroups();
+  CollectDirtyRanges();
+  // a new instance layout moves nodes to other slots, the slice is rewritten as a whole
+  const bool rewrite_layout = uploadedInstanceLayouts_[currentFrame_] != instanceGroups_.layoutVersion();
   UpdateVertexUniformBuffers(scene);
   UpdateFragmentUniformBuffers(scene);
   UpdateSharedUniformBuffers(scene);
+  if (options_.gpuCulling) {
+    UpdateCullingUniformBuffers(scene);
+  }
+  if (IsCpuCulling()) {
+    CullNodes(scene);
+  }
+  // indirect draws keep the group order their commands were written in
+  if (!options_.indirectDraws) {
+    SortDraws(scene);
+  }
+  uploadedInstanceLayouts_[currentFrame_] = instanceGroups_.layoutVersion();
+
+  const uint64_t instance_nodes = rewrite_layout ? vkNodeList.size() : uploadStats_.dirtyNodes;
+  const uint64_t draw_bytes =
+      instanceGroups_.groups().size() * (sizeof(_DrawData) + sizeof(VkDrawIndexedIndirectCommand));
+  uploadStats_.uploadedBytes =
+      instance_nodes * sizeof(_InstanceData) + (rewrite_layout ? draw_bytes : 0) + sizeof(_UBOShared);
+  uploadStats_.skippedBytes =
+      (vkNodeList.size() - instance_nodes) * sizeof(_InstanceData) + (rewrite_layout ? 0 : draw_bytes);
+}
+
+InstanceKey VulkanContext::MakeInstanceKey(uint32_t nodeIndex) const {
+  const VulkanNode& vkNode = vkNodeList[nodeIndex];
+  const Node* node = vkNode.sceneNode;
+  InstanceKey key;
+  key.mesh = static_cast<uint32_t>(vkNode.vkMesh - vkMeshList.data());
+  key.pipeline = vkNode.pipelineHandle;
+  key.material = node->material;
+  // the loaded texture, scene textures of the same file group together and a failed one groups as none
+  key.texture = vkNode.vkTextureHandle;
+  key.baseColor = node->materialParamters.baseColor;
+  key.roughness = node->materialParamters.roughness;
+  key.metallic = node->materialParamters.metallic;
+  return key;
+}
+
+uint32_t VulkanContext::DrawCapacity() const { return std::max<uint32_t>(static_cast<uint32_t>(vkNodeList.size()), 1); }
+
+void VulkanContext::UpdateInstanceGroups() {
+  // a moved node only changes its key through MarkDirty(), static nodes are skipped by the generation check
+  uint32_t moved = 0;
+  for (uint32_t i = 0; i < vkNodeList.size(); i++) {
+    uint64_t generation = vkNodeList[i].sceneNode->generation();
+    if (groupedGenerations_[i] == generation) continue;
+    groupedGenerations_[i] = generation;
+    if (instanceGroups_.Update(i, MakeInstanceKey(i))) {
+      moved++;
+    }
+  }
+  if (moved == 0) return;
+
+  instanceGroups_.Layout();
+  instancingStats_.draws = static_cast<uint32_t>(instanceGroups_.groups().size());
+  instancingStats_.regroupedNodes += moved;
+}
+
+void VulkanContext::CollectDirtyRanges() {
+  dirtyRanges_.clear();
+  uploadStats_.dirtyNodes = 0;
+
+  const size_t node_count = vkNodeList.size();
+  uint64_t* uploaded = uploadedGenerations_.data() + currentFrame_ * node_count;
+  for (uint32_t i = 0; i < node_count; i++) {
+    uint64_t generation = vkNodeList[i].sceneNode->generation();
+    if (uploaded[i] == generation) continue;
+    uploaded[i] = generation;
+    uploadStats_.dirtyNodes++;
+
+    // merge with the previous run when adjacent, so neighbours are written in one pass
+    if (!dirtyRanges_.empty() && dirtyRanges_.back().first + dirtyRanges_.back().count == i) {
+      dirtyRanges_.back().count++;
+    } else {
+      dirtyRanges_.push_back({i, 1});
+    }
+  }
+  uploadStats_.dirtyRanges = static_cast<uint32_t>(dirtyRanges_.size());
 }
 
 void VulkanContext::UpdateVertexUniformBuffers(Scene* scene) {
-  const auto& camera_matrix = scene->GetCameraMatrix();
-  // update model matrix
-  for (size_t i = 0; i < vkNodeList.size(); i++) {
-    const auto& vkNode = vkNodeList[i];
-    auto& ubo = uniformBuffers_.model[i];
-    ubo.model = vkNode.sceneNode->ModelMatrix();
+  // model matrices go to the instance slot of each node, written straight into the mapped ring
+  auto* dst = reinterpret_cast<_InstanceData*>(uniformRing_.Data(frameUniforms_.instance));
+  if (uploadedInstanceLayouts_[currentFrame_] != instanceGroups_.layoutVersion()) {
+    // every instance slot is drawn, the visible list maps each slot to itself
+    auto* visible = reinterpret_cast<uint32_t*>(uniformRing_.Data(frameUniforms_.visible));
+    for (uint32_t i = 0; i < instanceGroups_.instanceCount(); i++) {
+      visible[i] = i;
+    }
+
+    const auto& groups = instanceGroups_.groups();
+    for (uint32_t g = 0; g < groups.size(); g++) {
+      for (uint32_t j = 0; j < groups[g].nodes.size(); j++) {
+        _InstanceData& instance = dst[groups[g].firstInstance + j];
+        instance.model = vkNodeList[groups[g].nodes[j]].sceneNode->ModelMatrix();
+        instance.draw = g;
+      }
+    }
+    return;
   }
 
-  // update to gpu
-  uniformBuffers_.vertex_ub.buffer.Update(reinterpret_cast<const uint8_t*>(uniformBuffers_.model),
-                                          uniformBuffers_.vertex_ub.buffer_size);
+  for (const auto& range : dirtyRanges_) {
+    for (uint32_t i = range.first; i < range.first + range.count; i++) {
+      dst[instanceGroups_.instanceSlot(i)].model = vkNodeList[i].sceneNode->ModelMatrix();
+    }
+  }
 }
 
 void VulkanContext::UpdateFragmentUniformBuffers(Scene* scene) {
-  // update model matrix
-  for (size_t i = 0; i < vkNodeList.size(); i++) {
-    const auto& vkNode = vkNodeList[i];
-    auto& data = uniformBuffers_.fragment_data[i];
-    data.color = vec4f(vkNode.sceneNode->materialParamters.baseColor, 1.0);
-    data.metallic = vkNode.sceneNode->materialParamters.metallic;
-    data.roughness = vkNode.sceneNode->materialParamters.roughness;
+  // material parameters are part of the group key, draw data only changes with the layout
+  if (uploadedInstanceLayouts_[currentFrame_] == instanceGroups_.layoutVersion()) return;
+
+  auto* draws = reinterpret_cast<_DrawData*>(uniformRing_.Data(frameUniforms_.draw));
+  auto* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(uniformRing_.Data(frameUniforms_.indirect));
+  const auto& groups = instanceGroups_.groups();
+  // slots past the capacity were never written, the shader must not index them
+  const uint32_t bindless_slots = options_.bindlessTextures ? BindlessTextureCapacity() : UINT32_MAX;
+  for (uint32_t g = 0; g < groups.size(); g++) {
+    const auto& group = groups[g];
+    draws[g].color = vec4f(group.key.baseColor, 1.0);
+    draws[g].roughness = group.key.roughness;
+    draws[g].metallic = group.key.metallic;
+    const int texture_handle = vkNodeList[group.nodes[0]].vkTextureHandle;
+    draws[g].textureIndex = texture_handle < 0 || static_cast<uint32_t>(texture_handle) >= bindless_slots
+                                ? kNoTexture
+                                : static_cast<uint32_t>(texture_handle);
+
+    const PrimitiveMeshVK& vkmesh = vkMeshList[group.key.mesh];
+    commands[g].indexCount = vkmesh.indexCount;
+    commands[g].instanceCount = static_cast<uint32_t>(group.nodes.size());
+    commands[g].firstIndex = vkmesh.geometry.firstIndex;
+    commands[g].vertexOffset = vkmesh.geometry.vertexOffset;
+    commands[g].firstInstance = group.firstInstance;
   }
 
-  // update to gpu
-  uniformBuffers_.fragment_ub.buffer.Update(reinterpret_cast<const uint8_t*>(uniformBuffers_.fragment_data),
-                                            uniformBuffers_.fragment_ub.buffer_size);
+  if (!options_.gpuCulling) return;
+  auto* cull_groups = reinterpret_cast<VulkanGpuCulling::GroupData*>(uniformRing_.Data(frameUniforms_.cullGroups));
+  const auto& runs = instanceGroups_.runs();
+  for (uint32_t g = 0; g < groups.size(); g++) {
+    const PrimitiveMeshVK& vkmesh = vkMeshList[groups[g].key.mesh];
+    VulkanGpuCulling::GroupData& data = cull_groups[g];
+    data.boundingSphere = vkmesh.bounds.sphere;
+    data.indexCount = commands[g].indexCount;
+    data.firstIndex = commands[g].firstIndex;
+    data.vertexOffset = commands[g].vertexOffset;
+    data.firstInstance = commands[g].firstInstance;
+    data.cameraRun = instanceGroups_.groupRun(g);
+    data.cameraRunFirstGroup = runs[data.cameraRun].firstGroup;
+  }
 }
 
 void VulkanContext::UpdateSharedUniformBuffers(Scene* scene) {
-  uniformBuffers_.shared->camera_position = vec4f(scene->GetCamera()->GetLocation(), 1.0);
+  auto* shared = reinterpret_cast<_UBOShared*>(uniformRing_.Data(frameUniforms_.shared));
+  shared->camera_position = vec4f(scene->GetCamera()->GetLocation(), 1.0);
 
   const auto& light_array = scene->GetAllLights();
   
   // Default light MVP
-  uniformBuffers_.shared->light_mvp = glm::mat4(1.0f);
+  shared->light_mvp = glm::mat4(1.0f);
 
   for (auto i = 0; i < light_array.size(); i++) {
-    uniformBuffers_.shared->light_direction = vec4f(light_array[i]->GetForwardVector(), 1.0);
-    uniformBuffers_.shared->light_color = vec4f(light_array[i]->color(), 1.0);
+    shared->light_direction = vec4f(light_array[i]->GetForwardVector(), 1.0);
+    shared->light_color = vec4f(light_array[i]->color(), 1.0);
     
     if (i == 0) { // Main light for shadow
         auto light = light_array[i];
@@ -234,7 +499,7 @@ void VulkanContext::UpdateSharedUniformBuffers(Scene* scene) {
         vec3f direction = glm::normalize(target - position);
         
         // Update global light direction to match
-        uniformBuffers_.shared->light_direction = vec4f(direction, 1.0);
+        shared->light_direction = vec4f(direction, 1.0);
 
         // Use a fixed up vector
         vec3f up = vec3f(0.0f, 1.0f, 0.0f);
@@ -250,43 +515,146 @@ void VulkanContext::UpdateSharedUniformBuffers(Scene* scene) {
         mat4f proj = glm::ortho(-orthoSize, orthoSize, -orthoSize, orthoSize, nearPlane, farPlane);
         proj[1][1] *= -1; // Flip Y for Vulkan
         
-        uniformBuffers_.shared->light_mvp = proj * view;
+        shared->light_mvp = proj * view;
     }
   }
 
   const auto& camera_matrix = scene->GetCameraMatrix();
-  uniformBuffers_.shared->projection = camera_matrix.proj;
-  uniformBuffers_.shared->view = camera_matrix.view;
+  shared->projection = camera_matrix.proj;
+  shared->view = camera_matrix.view;
+}
 
-  // update to gpu
-  uniformBuffers_.shared_ub.buffer.Update(reinterpret_cast<const uint8_t*>(uniformBuffers_.shared),
-                                          sizeof(*uniformBuffers_.shared));
+void VulkanContext::UpdateCullingUniformBuffers(Scene* scene) {
+  // the frustums are the ones the passes render with, read back from the shared uniforms
+  const auto* shared = reinterpret_cast<const _UBOShared*>(uniformRing_.Data(frameUniforms_.shared));
+  auto* params = reinterpret_cast<VulkanGpuCulling::Params*>(uniformRing_.Data(frameUniforms_.cullParams));
+  matrix::ExtractFrustumPlanes(shared->projection * shared->view,
+                               &params->planes[static_cast<uint32_t>(CullView::Camera) * 6]);
+  matrix::ExtractFrustumPlanes(shared->light_mvp, &params->planes[static_cast<uint32_t>(CullView::Light) * 6]);
+  params->instanceCount = instanceGroups_.instanceCount();
+  params->groupCount = static_cast<uint32_t>(instanceGroups_.groups().size());
+  params->capacity = DrawCapacity();
+  params->visibleStride = static_cast<uint32_t>(gpuCulling_.visibleRange() / sizeof(uint32_t));
+  params->compact = gpuCulling_.compact() ? 1 : 0;
 }
 
-void VulkanContext::UpdateLightsUniformBuffers(Scene* scene) {}
+void VulkanContext::CullNodes(Scene* scene) {
+  LVK_TRACE_FUNCTION();
+  auto start = std::chrono::steady_clock::now();
+
+  // world bounds only move with the node, static nodes keep the ones computed before
+  cullStats_.updated = 0;
+  for (uint32_t i = 0; i < vkNodeList.size(); i++) {
+    uint64_t generation = vkNodeList[i].sceneNode->generation();
+    if (culledGenerations_[i] == generation) continue;
+    culledGenerations_[i] = generation;
+    frustumCuller_.SetBounds(i, vkNodeList[i].vkMesh->bounds, vkNodeList[i].sceneNode->ModelMatrix());
+    cullStats_.updated++;
+  }
 
-void VulkanContext::SetupDescriptorSetLayout(VulkanDevice* device) {
-  // TODO: pool size 怎么算的?
-  // Example uses one ubo and one image sampler
-  std::vector<VkDescriptorPoolSize> pool_sizes = {
-      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 16),
-      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4)};
+  const auto& camera_matrix = scene->GetCameraMatrix();
+  vec4f planes[6];
+  matrix::ExtractFrustumPlanes(camera_matrix.proj * camera_matrix.view, planes);
+  cullStats_.visible = frustumCuller_.Cull(planes);
+  cullStats_.culled = frustumCuller_.size() - cullStats_.visible;
+
+  // visible nodes of a group are packed at its firstInstance, the commands draw only those.
+  // commands are built from the meshes, the ring is write-combined and never read back
+  auto* visible = reinterpret_cast<uint32_t*>(uniformRing_.Data(frameUniforms_.cameraVisible));
+  auto* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(uniformRing_.Data(frameUniforms_.cameraIndirect));
+  const auto& groups = instanceGroups_.groups();
+  visibleInstanceCounts_.resize(groups.size());
+  for (uint32_t g = 0; g < groups.size(); g++) {
+    const auto& group = groups[g];
+    uint32_t count = 0;
+    for (uint32_t node : group.nodes) {
+      if (frustumCuller_.visible(node)) {
+        visible[group.firstInstance + count++] = instanceGroups_.instanceSlot(node);
+      }
+    }
+    visibleInstanceCounts_[g] = count;
+
+    const PrimitiveMeshVK& vkmesh = vkMeshList[group.key.mesh];
+    commands[g].indexCount = vkmesh.indexCount;
+    commands[g].instanceCount = count;
+    commands[g].firstIndex = vkmesh.geometry.firstIndex;
+    commands[g].vertexOffset = vkmesh.geometry.vertexOffset;
+    commands[g].firstInstance = group.firstInstance;
+  }
+
+  cullStats_.cullMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void VulkanContext::SortDraws(Scene* scene) {
+  LVK_TRACE_FUNCTION();
+  auto start = std::chrono::steady_clock::now();
+  constexpr uint32_t kBasePass = 0;
+
+  // right handed view space, the camera looks down -z
+  const mat4f& view = scene->GetCameraMatrix().view;
+  const auto& groups = instanceGroups_.groups();
+  baseDrawList_.Clear();
+  for (uint32_t g = 0; g < groups.size(); g++) {
+    const auto& group = groups[g];
+    // a group is as near as its nearest drawn node
+    float depth = FLT_MAX;
+    for (uint32_t node : group.nodes) {
+      if (IsCpuCulling() && !frustumCuller_.visible(node)) continue;
+      depth = std::min(depth, -(view * vkNodeList[node].sceneNode->ModelMatrix()[3]).z);
+    }
+    // bindless draws bind no texture, only the mesh and depth order them
+    const uint32_t texture = options_.bindlessTextures || group.key.texture < 0 ? 0 : group.key.texture + 1;
+    baseDrawList_.Add(DrawList::MakeKey(kBasePass, group.key.pipeline, texture, group.key.mesh,
+                                        DrawList::DepthBucket(depth)),
+                      g);
+  }
+  baseDrawList_.Sort();
+
+  sortStats_.draws = baseDrawList_.size();
+  sortStats_.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t VulkanContext::GetVisibleInstanceCount(uint32_t group, CullView view) const {
+  if (view == CullView::Camera && IsCpuCulling()) {
+    return visibleInstanceCounts_[group];
+  }
+  return static_cast<uint32_t>(instanceGroups_.groups()[group].nodes.size());
+}
 
-  // TODO: maxSets 怎么算的?
-  VkDescriptorPoolCreateInfo descriptor_pool_create_info =
-      initializers::DescriptorPoolCreateInfo(static_cast<uint32_t>(pool_sizes.size()), pool_sizes.data(), 16);
+void VulkanContext::UpdateLightsUniformBuffers(Scene* scene) {}
 
-  VK_CHECK_RESULT(vkCreateDescriptorPool(device->device(), &descriptor_pool_create_info, nullptr, &descriptorPool_));
+void VulkanContext::SetupDescriptorSetLayout(VulkanDevice* device) {
+  // the layouts only depend on the texture binding mode, a rebuilt scene keeps them
+  if (pipelineLayout_ != VK_NULL_HANDLE) {
+    if (layoutsBindless_ == options_.bindlessTextures) return;
+    // a material without a bindless shader turned bindless off. pipeline state keys hold the old handles,
+    // the old layouts live until the context goes away so a new layout cannot get the same value
+    retiredLayouts_.emplace_back(descriptorSetLayouts_, pipelineLayout_);
+    if (textureUpdateTemplate_ != VK_NULL_HANDLE) {
+      vkDestroyDescriptorUpdateTemplate(device->device(), textureUpdateTemplate_, nullptr);
+      textureUpdateTemplate_ = VK_NULL_HANDLE;
+    }
+  }
+  layoutsBindless_ = options_.bindlessTextures;
 
   // shared descriptor set layout
   std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = {
-      // global shared uniform buffers
-      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      // global shared uniform buffers, dynamic so every frame in flight reads its own ring slice
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
       // shadow map sampler
       initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                                VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+      // per instance model matrices of the frame
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT,
+                                               2),
+      // per draw material parameters, selected by the draw index of the instance
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                                               VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+      // instance index of each drawn instance, written by the culling pass or an identity list
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT,
+                                               4),
   };
 
   VkDescriptorSetLayoutCreateInfo descriptor_layout = initializers::DescriptorSetLayoutCreateInfo(
@@ -294,18 +662,34 @@ void VulkanContext::SetupDescriptorSetLayout(VulkanDevice* device) {
 
   VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->device(), &descriptor_layout, nullptr, &descriptorSetLayouts_.shared));
 
-  // object descriptor set layout
+  // object descriptor set layout, only the texture is left, per object data lives in set 0 storage buffers
   set_layout_bindings = {
-      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT,
-                                               0),
       initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT,
                                                1),
-      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT,
-                                               2),
   };
 
+  // bindless: one array of every texture at binding 0, sized at allocation and only partially written
+  VkDescriptorBindingFlags bindless_flags =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+  binding_flags.bindingCount = 1;
+  binding_flags.pBindingFlags = &bindless_flags;
+  if (options_.bindlessTextures) {
+    set_layout_bindings = {
+        initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                 VK_SHADER_STAGE_FRAGMENT_BIT, 0, BindlessTextureCapacity()),
+    };
+  }
+
   descriptor_layout = initializers::DescriptorSetLayoutCreateInfo(
       set_layout_bindings.data(), static_cast<uint32_t>(set_layout_bindings.size()));
+  if (options_.bindlessTextures) {
+    descriptor_layout.pNext = &binding_flags;
+  }
+  if (IsPushDescriptors()) {
+    descriptor_layout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+  }
 
   VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->device(), &descriptor_layout, nullptr, &descriptorSetLayouts_.object));
 
@@ -315,11 +699,63 @@ void VulkanContext::SetupDescriptorSetLayout(VulkanDevice* device) {
 
   VK_CHECK_RESULT(vkCreatePipelineLayout(device->device(), &pipeline_layout_create_info, nullptr, &pipelineLayout_));
 
-  VkDescriptorSetAllocateInfo allocInfo =
-      initializers::DescriptorSetAllocateInfo(descriptorPool_, &descriptorSetLayouts_.shared, 1);
-  VK_CHECK_RESULT(vkAllocateDescriptorSets(device_->device(), &allocInfo, &sharedDescriptorSet_));
+  if (IsPushDescriptors()) {
+    // the pushed data is a single VkDescriptorImageInfo for binding 1 of set 1
+    VkDescriptorUpdateTemplateEntry template_entry{};
+    template_entry.dstBinding = 1;
+    template_entry.descriptorCount = 1;
+    template_entry.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    template_entry.offset = 0;
+    template_entry.stride = sizeof(VkDescriptorImageInfo);
+
+    VkDescriptorUpdateTemplateCreateInfo template_info{VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO};
+    template_info.descriptorUpdateEntryCount = 1;
+    template_info.pDescriptorUpdateEntries = &template_entry;
+    template_info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+    template_info.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    template_info.pipelineLayout = pipelineLayout_;
+    template_info.set = 1;
+    VK_CHECK_RESULT(
+        vkCreateDescriptorUpdateTemplate(device->device(), &template_info, nullptr, &textureUpdateTemplate_));
+    vkCmdPushDescriptorSetWithTemplateKHR_ = reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+        vkGetDeviceProcAddr(device->device(), "vkCmdPushDescriptorSetWithTemplateKHR"));
+    assert(vkCmdPushDescriptorSetWithTemplateKHR_);
+  }
+}
 
-  auto shared_descriptor = CreateDescriptor(&uniformBuffers_.shared_ub.buffer);
+void VulkanContext::SetupDescriptorSets(VulkanDevice* device) {
+  // pool sizes follow the layouts and the scene: set 0 once (1 uniform, 3 storage buffers, the shadow map),
+  // set 1 once per texture, or once holding the bindless array. pushed textures need no set 1.
+  // a scene outgrowing the estimate chains another pool
+  const uint32_t texture_count = std::max<uint32_t>(static_cast<uint32_t>(vkTextureList.size()), 1);
+  const uint32_t array_size = std::min(texture_count, BindlessTextureCapacity());
+  uint32_t object_sets = 0;
+  uint32_t object_samplers = 0;
+  if (options_.bindlessTextures) {
+    object_sets = 1;
+    object_samplers = array_size;
+  } else if (!IsPushDescriptors()) {
+    // one set per distinct texture plus the default one, nodes sharing a texture share the set
+    object_sets = object_samplers = std::min(static_cast<uint32_t>(vkNodeList.size()), texture_count + 1);
+  }
+  std::vector<VkDescriptorPoolSize> pool_sizes = {
+      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
+      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3),
+      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + object_samplers)};
+  // the previous scene's sets go with their pools, the device is idle while the scene is rebuilt
+  descriptorAllocator_.Destroy();
+  descriptorSetCache_.clear();
+  descriptorStats_.objectSets = descriptorStats_.sharedObjectSets = 0;
+  descriptorAllocator_.Init(device->device(), pool_sizes, 1 + object_sets);
+
+  sharedDescriptorSet_ = descriptorAllocator_.Allocate(descriptorSetLayouts_.shared);
+
+  auto shared_descriptor = CreateDescriptor(uniformRing_.buffer(), sizeof(_UBOShared));
+  auto instance_descriptor = CreateDescriptor(uniformRing_.buffer(), DrawCapacity() * sizeof(_InstanceData));
+  auto draw_descriptor = CreateDescriptor(uniformRing_.buffer(), DrawCapacity() * sizeof(_DrawData));
+  auto visible_descriptor = options_.gpuCulling
+                                ? CreateDescriptor(gpuCulling_.buffer(), gpuCulling_.visibleRange())
+                                : CreateDescriptor(uniformRing_.buffer(), DrawCapacity() * sizeof(uint32_t));
 
   // Setup a descriptor image info for the current texture to be used as a combined image sampler
   VkDescriptorImageInfo textureDescriptor;
@@ -330,13 +766,55 @@ void VulkanContext::SetupDescriptorSetLayout(VulkanDevice* device) {
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
       // Binding 0 : shared
-      initializers::WriteDescriptorSet(sharedDescriptorSet_, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &shared_descriptor),
+      initializers::WriteDescriptorSet(sharedDescriptorSet_, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0,
+                                       &shared_descriptor),
       // Binding 1 : shadow map
       initializers::WriteDescriptorSet(sharedDescriptorSet_, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
                                        &textureDescriptor),
+      // Binding 2 : instance data
+      initializers::WriteDescriptorSet(sharedDescriptorSet_, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2,
+                                       &instance_descriptor),
+      // Binding 3 : draw data
+      initializers::WriteDescriptorSet(sharedDescriptorSet_, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3,
+                                       &draw_descriptor),
+      // Binding 4 : visible instances
+      initializers::WriteDescriptorSet(sharedDescriptorSet_, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4,
+                                       &visible_descriptor),
   };
   vkUpdateDescriptorSets(device_->device(), static_cast<uint32_t>(writeDescriptorSets.size()),
                          writeDescriptorSets.data(), 0, NULL);
+
+  if (!options_.bindlessTextures) return;
+
+  if (vkTextureList.size() > BindlessTextureCapacity()) {
+    ERROR_LOG("{} textures do not fit the bindless array of {}, the rest are drawn untextured", vkTextureList.size(),
+              BindlessTextureCapacity());
+  }
+  VkDescriptorSetVariableDescriptorCountAllocateInfo variable_count{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO};
+  variable_count.descriptorSetCount = 1;
+  variable_count.pDescriptorCounts = &array_size;
+  textureDescriptorSet_ = descriptorAllocator_.Allocate(descriptorSetLayouts_.object, &variable_count);
+
+  // slot i is vkTextureList[i], the vkTextureHandle of the nodes that loaded it
+  std::vector<VkDescriptorImageInfo> texture_descriptors;
+  for (uint32_t i = 0; i < std::min<size_t>(vkTextureList.size(), array_size); i++) {
+    texture_descriptors.push_back(vkTextureList[i]->GetDescriptorImageInfo());
+  }
+  if (texture_descriptors.empty()) return;
+  VkWriteDescriptorSet texture_write =
+      initializers::WriteDescriptorSet(textureDescriptorSet_, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0,
+                                       texture_descriptors.data(), static_cast<uint32_t>(texture_descriptors.size()));
+  vkUpdateDescriptorSets(device_->device(), 1, &texture_write, 0, nullptr);
+}
+
+uint32_t VulkanContext::BindlessTextureCapacity() const {
+  // the fragment stage also samples the shadow map from set 0
+  constexpr uint32_t kMaxBindlessTextures = 4096;
+  const VkPhysicalDeviceLimits& limits = device_->properties().limits;
+  return std::min({kMaxBindlessTextures, limits.maxPerStageDescriptorSamplers - 1,
+                   limits.maxPerStageDescriptorSampledImages - 1, limits.maxDescriptorSetSamplers - 1,
+                   limits.maxDescriptorSetSampledImages - 1});
 }
 
 #if 0
@@ -382,9 +860,11 @@ VkResult VulkanContext::CreateInstance(bool enableValidation) {
   appInfo.pEngineName = "Learn Vulkan";
   appInfo.apiVersion = VK_API_VERSION_1_2;
 
-  std::vector<const char*> instanceExtensions = {VK_KHR_SURFACE_EXTENSION_NAME};
+  std::vector<const char*> instanceExtensions;
 
-  // Enable surface extensions depending on os
+  // Enable surface extensions depending on os, a headless context has no surface
+  if (!headless_) {
+    instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
   instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -404,6 +884,7 @@ VkResult VulkanContext::CreateInstance(bool enableValidation) {
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
   instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
 #endif
+  }
 
   // Get extensions supported by the instance and store for later use
   uint32_t extCount = 0;
@@ -522,26 +1003,38 @@ VkDescriptorBufferInfo VulkanContext::CreateDescriptor(VulkanBuffer* buffer, VkD
 
 VkPipelineShaderStageCreateInfo VulkanContext::LoadShader(std::string fileName, VkShaderStageFlagBits stage,
                                                           VulkanDevice* device) {
-  VkPipelineShaderStageCreateInfo shaderStage = {};
-  shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  shaderStage.stage = stage;
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-  shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
-#else
-  shaderStage.module = tools::LoadShader(fileName.c_str(), device->device());
-#endif
-  shaderStage.pName = "main";
-  assert(shaderStage.module != VK_NULL_HANDLE);
-  // shaderModules.push_back(shaderStage.module);
-  return shaderStage;
+  // the module handle is part of the pipeline state key, loading a file twice would split equal pipelines.
+  // passes and render components keep their shaders for the lifetime of the context, never released
+  ShaderModuleCache::Handle shader = shaderModules_.Acquire(fileName, stage);
+  assert(shader != ShaderModuleCache::kInvalidHandle);
+  return shaderModules_.StageInfo(shader);
 }
 
 bool VulkanContext::LoadMaterial(VulkanNode* vkNode, const Material* mat, VulkanDevice* device) {
-  vkNode->shaderStages.push_back(LoadShader(mat->vertShaderPath, VK_SHADER_STAGE_VERTEX_BIT, device));
-  vkNode->shaderStages.push_back(LoadShader(mat->fragShaderPath, VK_SHADER_STAGE_FRAGMENT_BIT, device));
+  const std::string& frag_path = options_.bindlessTextures ? mat->bindlessFragShaderPath : mat->fragShaderPath;
+  return AcquireShaders(vkNode, mat->vertShaderPath, frag_path);
+}
+
+bool VulkanContext::AcquireShaders(VulkanNode* vkNode, const std::string& vertPath, const std::string& fragPath) {
+  ShaderModuleCache::Handle vert = shaderModules_.Acquire(vertPath, VK_SHADER_STAGE_VERTEX_BIT);
+  ShaderModuleCache::Handle frag = shaderModules_.Acquire(fragPath, VK_SHADER_STAGE_FRAGMENT_BIT);
+  if (vert == ShaderModuleCache::kInvalidHandle || frag == ShaderModuleCache::kInvalidHandle) {
+    shaderModules_.Release(vert);
+    shaderModules_.Release(frag);
+    return false;
+  }
+  vkNode->shaders = {vert, frag};
   return true;
 }
 
+std::vector<VkPipelineShaderStageCreateInfo> VulkanContext::GetShaderStages(const VulkanNode& vkNode) const {
+  std::vector<VkPipelineShaderStageCreateInfo> stages;
+  for (auto shader : vkNode.shaders) {
+    stages.push_back(shaderModules_.StageInfo(shader));
+  }
+  return stages;
+}
+
 #if 0
 void VulkanContext::SetupShadowRenderPass() {
   VkAttachmentDescription attachmentDescription{};
@@ -595,14 +1088,48 @@ void VulkanContext::SetupShadowRenderPass() {
 #endif
 
 void VulkanContext::CreatePipelineCache() {
+  if (pipelineCache_ != VK_NULL_HANDLE) return;
+  std::vector<uint8_t> initial_data;
+  if (!options_.coldPipelineCache) {
+    initial_data = pipelineCacheFile_.Load(device_->properties());
+  }
   VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
   pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-  VK_CHECK_RESULT(vkCreatePipelineCache(device_->device(), &pipelineCacheCreateInfo, nullptr, &pipelineCache_));
+  pipelineCacheCreateInfo.initialDataSize = initial_data.size();
+  pipelineCacheCreateInfo.pInitialData = initial_data.data();
+  VkResult result = vkCreatePipelineCache(device_->device(), &pipelineCacheCreateInfo, nullptr, &pipelineCache_);
+  if (result != VK_SUCCESS && !initial_data.empty()) {
+    // the header matched but the driver still refused the data, start empty
+    ERROR_LOG("vkCreatePipelineCache rejected {}: {}, cold start", pipelineCacheFile_.path(),
+              tools::ErrorString(result));
+    pipelineCacheCreateInfo.initialDataSize = 0;
+    pipelineCacheCreateInfo.pInitialData = nullptr;
+    result = vkCreatePipelineCache(device_->device(), &pipelineCacheCreateInfo, nullptr, &pipelineCache_);
+  }
+  VK_CHECK_RESULT(result);
+  if (options_.pipelineThreads > 0) {
+    pipelinePool_ = std::make_unique<ThreadPool>(options_.pipelineThreads);
+  }
+  pipelineStates_.Init(device_->device(), pipelineCache_, pipelinePool_.get());
+  if (!options_.shaderArchivePath.empty()) {
+    shaderArchive_.Open(options_.shaderArchivePath);
+  }
+  shaderModules_.Init(device_->device(), shaderArchive_.IsOpen() ? &shaderArchive_ : nullptr);
+  shaderModules_.SetDestroyCallback([this](VkShaderModule module) { pipelineStates_.ForgetModule(module); });
+  pipelineCacheSaveTime_ = std::chrono::steady_clock::now();
+}
+
+void VulkanContext::SavePipelineCache() {
+  pipelineCacheSaveTime_ = std::chrono::steady_clock::now();
+  pipelineCacheFile_.Save(device_->device(), pipelineCache_);
 }
 
 void VulkanContext::BuildPipelines() {
-  // todo
-  CreatePipelineCache();
+  // graphics pipelines are created on demand by the passes through pipelineStates_
+  if (options_.gpuCulling) {
+    gpuCulling_.BuildPipelines(pipelineCache_, LoadComputeShader("cull_instances.comp.spv"),
+                               LoadComputeShader("cull_draws.comp.spv"));
+  }
   // todo
   // pipelineList.resize(static_cast<std::size_t>(NodeType::MAX));
 
@@ -619,7 +1146,7 @@ void VulkanContext::BuildPipelines() {
       .depthWriteEnable(true)
       .depthCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL)
       .rasterizationSamples(VK_SAMPLE_COUNT_1_BIT)
-      .shaderStages(GetVkNode(0)->shaderStages)
+      .shaderStages(GetShaderStages(*GetVkNode(0)))
       .build(device_->device(), pipelineCache_, PipelineLayout(), renderPass_,
              &pipelineList[static_cast<std::size_t>(NodeType::Object)], "shadowmap");
 #endif
@@ -640,7 +1167,7 @@ void VulkanContext::BuildPipelines() {
       .depthWriteEnable(true)
       .depthCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL)
       .rasterizationSamples(VK_SAMPLE_COUNT_1_BIT)
-      .shaderStages(GetVkNode(0)->shaderStages)
+      .shaderStages(GetShaderStages(*GetVkNode(0)))
       .build(device_->device(), pipelineCache_, PipelineLayout(), basePass_->GetRenderPassData().renderPassHandle,
              &pipelineList[static_cast<std::size_t>(NodeType::Object)], "05-GraphicPipline");
 #endif
@@ -657,38 +1184,18 @@ void VulkanContext::BuildPipelines() {
       .depthWriteEnable(true)
       .depthCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL)
       .rasterizationSamples(VK_SAMPLE_COUNT_1_BIT)
-      .shaderStages(GetVkNode(0)->shaderStages)
+      .shaderStages(GetShaderStages(*GetVkNode(0)))
       .build(device_->device(), pipelineCache_, PipelineLayout(), renderPass_,
              &pipelineList[static_cast<std::size_t>(NodeType::Skybox)], "05-GraphicPipline");
 #endif
 }
 
-VkDescriptorSet VulkanContext::AllocDescriptorSet(VulkanNode* vkNode) {
-  // todo:
-  // descriptorSetList.resize(1);
-  std::cout << std::format("AllocDescriptorSet for vkNode: {:010x}\n", (uintptr_t)vkNode);
-
-  VkDescriptorSetAllocateInfo allocInfo =
-      initializers::DescriptorSetAllocateInfo(descriptorPool_, &descriptorSetLayouts_.object, 1);
-
-  VkDescriptorSet descriptor_set{VK_NULL_HANDLE};
-  VK_CHECK_RESULT(vkAllocateDescriptorSets(device_->device(), &allocInfo, &descriptor_set));
-
-  // Setup a descriptor image info for the current texture to be used as a
-  // combined image sampler
-  VkDescriptorImageInfo textureDescriptor =
-      vkNode->vkTexture->GetDescriptorImageInfo();  // texture_->GetDescriptorImageInfo();
-
-  auto shared_descriptor = CreateDescriptor(&uniformBuffers_.shared_ub.buffer);
-  auto dynamic_descriptor = CreateDescriptor(&uniformBuffers_.vertex_ub.buffer, uniformBuffers_.vertex_ub.alignment);
-  auto fragment_descriptor =
-      CreateDescriptor(&uniformBuffers_.fragment_ub.buffer, uniformBuffers_.fragment_ub.alignment);
+VkDescriptorSet VulkanContext::AllocDescriptorSet(const VkDescriptorImageInfo& texture) {
+  VkDescriptorSet descriptor_set = descriptorAllocator_.Allocate(descriptorSetLayouts_.object);
+  VkDescriptorImageInfo textureDescriptor = texture;
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-      // Binding 1 : Vertex shader uniform buffer
-      initializers::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0,
-                                       &dynamic_descriptor),
-      // Binding 2 : Fragment shader texture sampler
+      // Binding 1 : Fragment shader texture sampler
       initializers::WriteDescriptorSet(descriptor_set,
                                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // The descriptor set will
                                                                                    // use a combined image
@@ -697,41 +1204,210 @@ VkDescriptorSet VulkanContext::AllocDescriptorSet(VulkanNode* vkNode) {
                                        1,                                          // Shader binding point 1
                                        &textureDescriptor),  // Pointer to the descriptor image for our
                                                              // texture
-      // Binding3 : Fragment shader uniform buffer
-      initializers::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2,
-                                       &fragment_descriptor),
   };
 
   vkUpdateDescriptorSets(device_->device(), static_cast<uint32_t>(writeDescriptorSets.size()),
                          writeDescriptorSets.data(), 0, NULL);
-
-  // save to cache
-  DescriptorSetKey key((void*)&uniformBuffers_, vkNode->vkTextureHandle);
-  descriptorSetCache_[key] = descriptor_set;
   return descriptor_set;
-}  // namespace lvk
+}
+
+void VulkanContext::BindSharedDescriptorSet(VkCommandBuffer cmdBuffer, CullView view) {
+  // in binding order: shared uniforms, instance data, draw data, visible instances
+  std::array<uint32_t, 4> offset_array;
+  offset_array[0] = static_cast<uint32_t>(frameUniforms_.shared);
+  offset_array[1] = static_cast<uint32_t>(frameUniforms_.instance);
+  offset_array[2] = static_cast<uint32_t>(frameUniforms_.draw);
+  if (options_.gpuCulling) {
+    offset_array[3] = static_cast<uint32_t>(gpuCulling_.VisibleOffset(currentFrame_, view));
+  } else if (IsCpuCulling() && view == CullView::Camera) {
+    offset_array[3] = static_cast<uint32_t>(frameUniforms_.cameraVisible);
+  } else {
+    offset_array[3] = static_cast<uint32_t>(frameUniforms_.visible);
+  }
+  // bindless: the texture array goes with set 0, no draw of the pass binds anything else
+  std::array<VkDescriptorSet, 2> sets = {sharedDescriptorSet_, textureDescriptorSet_};
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 0,
+                          options_.bindlessTextures ? 2 : 1, sets.data(), static_cast<uint32_t>(offset_array.size()),
+                          offset_array.data());
+  recordedSetBinds_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VulkanContext::BindObjectDescriptorSet(VkCommandBuffer cmdBuffer, uint32_t nodeIndex) {
+  if (IsPushDescriptors()) {
+    // the descriptor is copied into the command buffer, nothing has to outlive the recording
+    VkDescriptorImageInfo texture_descriptor = vkNodeList[nodeIndex].vkTexture->GetDescriptorImageInfo();
+    vkCmdPushDescriptorSetWithTemplateKHR_(cmdBuffer, textureUpdateTemplate_, PipelineLayout(), 1,
+                                           &texture_descriptor);
+    recordedPushes_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 1, 1,
+                          &vkNodeList[nodeIndex].descriptorSet, 0, nullptr);
+  recordedSetBinds_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VulkanContext::DrawIndirect(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count, CullView view) {
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  VkBuffer buffer = uniformRing_.buffer()->buffer();
+  VkDeviceSize offset = frameUniforms_.indirect + first * stride;
+  if (IsCpuCulling() && view == CullView::Camera) {
+    offset = frameUniforms_.cameraIndirect + first * stride;
+  }
+  if (options_.gpuCulling) {
+    buffer = gpuCulling_.buffer()->buffer();
+    offset = gpuCulling_.CommandOffset(currentFrame_, view, first);
+    if (gpuCulling_.compact()) {
+      // the visible draws of a run were compacted to its start, the gpu counted them
+      const uint32_t run = view == CullView::Camera ? instanceGroups_.groupRun(first) : 0;
+      assert(view == CullView::Camera ? instanceGroups_.runs()[run].firstGroup == first : first == 0);
+      vkCmdDrawIndexedIndirectCount(cmdBuffer, buffer, offset, buffer,
+                                    gpuCulling_.DrawCountOffset(currentFrame_, view, run), count, stride);
+      return;
+    }
+  }
+  // without multiDrawIndirect drawCount must be 0 or 1
+  const uint32_t max_count =
+      device_->enabledFeatures().multiDrawIndirect ? device_->properties().limits.maxDrawIndirectCount : 1;
+  for (uint32_t i = 0; i < count; i += max_count) {
+    vkCmdDrawIndexedIndirect(cmdBuffer, buffer, offset + i * stride,
+                             std::min(max_count, count - i), stride);
+  }
+}
 
 void VulkanContext::FindOrCreateDescriptorSet(VulkanNode* vkNode) {
-  vkNode->descriptorSet = AllocDescriptorSet(vkNode);
-  #if 0
-  DescriptorSetKey key((void*)&uniformBuffers_, vkNode->vkTextureHandle);
-  auto iter = descriptorSetCache_.find(key);
-  if (iter == descriptorSetCache_.end()) {
-    vkNode->descriptorSet = AllocDescriptorSet(vkNode);
+  // keyed on the bound resources, not on the node: nodes drawing the same texture share one set
+  const VkDescriptorImageInfo texture = vkNode->vkTexture->GetDescriptorImageInfo();
+  DescriptorSetKey key;
+  key.layout = descriptorSetLayouts_.object;
+  key.imageView = texture.imageView;
+  key.sampler = texture.sampler;
+  key.imageLayout = texture.imageLayout;
+  auto [iter, inserted] = descriptorSetCache_.try_emplace(key, VK_NULL_HANDLE);
+  if (inserted) {
+    iter->second = AllocDescriptorSet(texture);
+    descriptorStats_.objectSets++;
   } else {
-    vkNode->descriptorSet = iter->second;
+    descriptorStats_.sharedObjectSets++;
   }
-  #endif
+  vkNode->descriptorSet = iter->second;
 }
 
 int VulkanContext::FindOrCreatePipeline(const Node& node, const VulkanNode& vkNode) {
-  // TODO: 目前假定 pipeline 都是预先创建好了的
-  return static_cast<std::size_t>(node.node_type);
+  // only queued here, the first recording that draws with it waits for the compile
+  PipelineStateCache::Handle pipeline = basePass_->RequestPipeline(GetShaderStages(vkNode));
+  // nodes of identical materials get the same pipeline from the state cache and share a handle
+  auto it = std::find(pipelines_.begin(), pipelines_.end(), pipeline);
+  if (it != pipelines_.end()) {
+    return static_cast<int>(it - pipelines_.begin());
+  }
+  pipelines_.push_back(pipeline);
+  return static_cast<int>(pipelines_.size() - 1);
 }
 
-void VulkanContext::InitSwapchain() { swapChain_.InitSurface(NULL, options_.window); }
+VkPipeline VulkanContext::GetPipeline(int handle) {
+  if (options_.pipelineFallback) {
+    VkPipeline pipeline = pipelineStates_.TryGet(pipelines_[handle]);
+    return pipeline != VK_NULL_HANDLE ? pipeline : pipelineStates_.Wait(fallbackPipeline_);
+  }
+  return pipelineStates_.Wait(pipelines_[handle]);
+}
 
-void VulkanContext::SetupSwapchain() { swapChain_.Create(&width, &height, false, false); }
+void VulkanContext::InitSwapchain() {
+  if (headless_) return;
+  swapChain_.InitSurface(NULL, options_.window);
+}
+
+void VulkanContext::SetupSwapchain() {
+  if (headless_) {
+    SetupOffscreenTargets();
+    return;
+  }
+  swapChain_.Create(&width, &height, false, false);
+}
+
+uint32_t VulkanContext::QueueFamilyIndex() {
+  return headless_ ? device_->queueFamilyIndices_.graphics : swapChain_.queueNodeIndex();
+}
+
+void VulkanContext::SetupOffscreenTargets() {
+  // one target per frame in flight, the image index of a frame is its frame slot
+  offscreenTargets_.resize(std::max(1u, options_.maxFramesInFlight));
+  for (auto& target : offscreenTargets_) {
+    VkImageCreateInfo image = initializers::ImageCreateInfo();
+    image.imageType = VK_IMAGE_TYPE_2D;
+    image.format = offscreenFormat_;
+    image.extent = {width, height, 1};
+    image.mipLevels = 1;
+    image.arrayLayers = 1;
+    image.samples = VK_SAMPLE_COUNT_1_BIT;
+    image.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    VK_CHECK_RESULT(vkCreateImage(device_->device(), &image, nullptr, &target.image));
+
+    VK_CHECK_RESULT(
+        device_->allocator()->AllocateForImage(target.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &target.allocation));
+
+    VkImageViewCreateInfo view = initializers::ImageViewCreateInfo();
+    view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view.format = offscreenFormat_;
+    view.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    view.image = target.image;
+    VK_CHECK_RESULT(vkCreateImageView(device_->device(), &view, nullptr, &target.view));
+  }
+
+  readbackBuffer_ = VulkanBuffer::Create(device_, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         static_cast<VkDeviceSize>(width) * height * 4);
+  DEBUG_LOG("headless: {} offscreen targets {}x{}", offscreenTargets_.size(), width, height);
+}
+
+// the base pass leaves the color target in TRANSFER_SRC_OPTIMAL in headless mode
+void VulkanContext::RecordCapture(VkCommandBuffer cmdBuffer) {
+  VkImage image = offscreenTargets_[currentBuffer_].image;
+
+  VkImageMemoryBarrier barrier = initializers::ImageMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                       nullptr, 0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {width, height, 1};
+  vkCmdCopyImageToBuffer(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer_->buffer(), 1,
+                         &region);
+
+  VkBufferMemoryBarrier host_barrier{};
+  host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.buffer = readbackBuffer_->buffer();
+  host_barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                       &host_barrier, 0, nullptr);
+}
+
+void VulkanContext::WriteCapture() {
+  // the capture is rare, simply wait for this frame instead of keeping one readback buffer per frame
+  VK_CHECK_RESULT(vkWaitForFences(device_->device(), 1, &frames_[currentFrame_].fence, VK_TRUE, UINT64_MAX));
+
+  VK_CHECK_RESULT(readbackBuffer_->Map());
+  const auto parent = std::filesystem::path(capturePath_).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent);
+  }
+  if (!stbi_write_png(capturePath_.c_str(), width, height, 4, readbackBuffer_->mapped(), width * 4)) {
+    ERROR_LOG("failed to write {}", capturePath_);
+  }
+  readbackBuffer_->Unmap();
+  capturePath_.clear();
+}
 
 #if 0
 void VulkanContext::SetupShadowFrameBuffer() {
@@ -805,104 +1481,213 @@ void VulkanContext::SetupShadowFrameBuffer() {
 void VulkanContext::CreateCommandPool() {
   VkCommandPoolCreateInfo cmdPoolInfo = {};
   cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  cmdPoolInfo.queueFamilyIndex = swapChain_.queueNodeIndex();
+  cmdPoolInfo.queueFamilyIndex = QueueFamilyIndex();
   cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
   VK_CHECK_RESULT(vkCreateCommandPool(device_->device(), &cmdPoolInfo, nullptr, &cmdPool_));
 }
 
 void VulkanContext::CreateCommandBuffers() {
-  // Create one command buffer for each swap chain image and reuse for rendering
-  drawCmdBuffers_.resize(swapChain_.imageCount());
+  // Create one command buffer for each frame in flight, re-recorded every frame
+  frames_.resize(std::max(1u, options_.maxFramesInFlight));
 
+  std::vector<VkCommandBuffer> cmdBuffers(frames_.size());
   VkCommandBufferAllocateInfo cmdBufAllocateInfo = initializers::CommandBufferAllocateInfo(
-      cmdPool_, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(drawCmdBuffers_.size()));
+      cmdPool_, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(cmdBuffers.size()));
+
+  VK_CHECK_RESULT(vkAllocateCommandBuffers(device_->device(), &cmdBufAllocateInfo, cmdBuffers.data()));
+  for (size_t i = 0; i < frames_.size(); i++) {
+    frames_[i].commandBuffer = cmdBuffers[i];
+  }
+
+  if (options_.recordThreads > 0) {
+    recordPool_ = std::make_unique<ThreadPool>(options_.recordThreads);
+    CreateRecordSlots();
+  }
+}
+
+void VulkanContext::CreateRecordSlots() {
+  // shadow chunks + base chunks + one for the render components
+  const uint32_t slot_count = recordPool_->size() * 2 + 1;
 
-  VK_CHECK_RESULT(vkAllocateCommandBuffers(device_->device(), &cmdBufAllocateInfo, drawCmdBuffers_.data()));
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.queueFamilyIndex = QueueFamilyIndex();
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  for (auto& frame : frames_) {
+    frame.recordSlots.resize(slot_count);
+    for (auto& slot : frame.recordSlots) {
+      VK_CHECK_RESULT(vkCreateCommandPool(device_->device(), &cmdPoolInfo, nullptr, &slot.pool));
+      VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+          initializers::CommandBufferAllocateInfo(slot.pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+      VK_CHECK_RESULT(vkAllocateCommandBuffers(device_->device(), &cmdBufAllocateInfo, &slot.commandBuffer));
+    }
+  }
+  frameStats_.recordThreads = recordPool_->size();
 }
 
 void VulkanContext::BuildCommandBuffers(Scene* scene) {
+  LVK_TRACE_FUNCTION();
+  // command buffers are recorded every frame from Draw(), after the frame's fence has been waited on.
+  // recording from outside Draw() could touch a command buffer the gpu is still executing.
+  if (!frameInProgress_) {
+    return;
+  }
+
+  VkCommandBuffer cmdBuffer = frames_[currentFrame_].commandBuffer;
+  const uint32_t i = currentBuffer_;
+
   VkCommandBufferBeginInfo cmdBufInfo = initializers::CommandBufferBeginInfo();
+  cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-  VkClearValue clearValues[2];
-  clearValues[0].color = defaultClearColor;
-  clearValues[1].depthStencil = {1.0f, 0};
+  VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+  gpuProfiler_.BeginFrame(cmdBuffer, currentFrame_);
 
-  for (int32_t i = 0; i < drawCmdBuffers_.size(); ++i) {
-    VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers_[i], &cmdBufInfo));
+  // the indirect commands of both passes are produced before any render pass begins
+  if (options_.gpuCulling) {
+    GpuProfileScope scope(&gpuProfiler_, cmdBuffer, "Culling");
+    gpuCulling_.Record(cmdBuffer, currentFrame_, frameUniforms_.instance, frameUniforms_.cullGroups,
+                       frameUniforms_.cullParams, instanceGroups_.instanceCount(),
+                       static_cast<uint32_t>(instanceGroups_.groups().size()));
+  }
 
+  if (recordPool_) {
+    BuildCommandBuffersParallel(scene, cmdBuffer);
+  } else {
     // shadow pass
     if (shadowPass_) {
-      shadowPass_->BuildCommandBuffer(i, drawCmdBuffers_[i], &cmdBufInfo);
+      GpuProfileScope scope(&gpuProfiler_, cmdBuffer, "ShadowPass");
+      shadowPass_->BuildCommandBuffer(i, cmdBuffer, &cmdBufInfo);
     }
 
-    // base pass starts here
-    {
-      VkRenderPassBeginInfo renderPassBeginInfo = initializers::RenderPassBeginInfo();
-      renderPassBeginInfo.renderPass = GetBasePassVkHandle();
-      renderPassBeginInfo.renderArea.offset.x = 0;
-      renderPassBeginInfo.renderArea.offset.y = 0;
-      renderPassBeginInfo.renderArea.extent.width = width;
-      renderPassBeginInfo.renderArea.extent.height = height;
-      renderPassBeginInfo.clearValueCount = 2;
-      renderPassBeginInfo.pClearValues = clearValues;
-      renderPassBeginInfo.framebuffer = basePass_->GetRenderPassData().frameBuffers[i];
-
-      // begin base pass
-      vkCmdBeginRenderPass(drawCmdBuffers_[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-      VkViewport viewport = initializers::Viewport((float)width, (float)height, 0.0f, 1.0f);
-      vkCmdSetViewport(drawCmdBuffers_[i], 0, 1, &viewport);
-
-      VkRect2D scissor = initializers::Rect2D(width, height, 0, 0);
-      vkCmdSetScissor(drawCmdBuffers_[i], 0, 1, &scissor);
-
-      // uint32_t dynamic_offset = 0;
-      // vkCmdBindDescriptorSets(drawCmdBuffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 0, 1,
-      //                        GetDescriptorSetP(vkNode->descriptorSetHandle), 1, &dynamic_offset);
-      vkCmdBindPipeline(drawCmdBuffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        basePass_->GetRenderPassData().pipelineHandle);
-
-      vkCmdBindDescriptorSets(drawCmdBuffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 0, 1,
-                              &sharedDescriptorSet_, 0, nullptr);
-
-      VkDeviceSize offsets[1] = {0};
-      for (auto node_index = 0; node_index < vkNodeList.size(); node_index++) {
-        const auto& vkn = &vkNodeList[node_index];
-        auto vkvb = vkn->vkMesh->vertexBuffer->buffer();
-        auto vkib = vkn->vkMesh->indexBuffer->buffer();
-        vkCmdBindVertexBuffers(drawCmdBuffers_[i], VERTEX_BUFFER_BIND_ID, 1, &vkvb, offsets);
-        vkCmdBindIndexBuffer(drawCmdBuffers_[i], vkib, 0, VK_INDEX_TYPE_UINT32);
-
-        std::array<uint32_t, 2> offset_array;
-        offset_array[0] = node_index * uniformBuffers_.vertex_ub.alignment;
-        offset_array[1] = node_index * uniformBuffers_.fragment_ub.alignment;
-        vkCmdBindDescriptorSets(drawCmdBuffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 1, 1,
-                                &vkn->descriptorSet, 2, &offset_array[0]);
-        vkCmdDrawIndexed(drawCmdBuffers_[i], vkn->vkMesh->indexCount, 1, 0, 0, 0);
-      }
+    // base pass
+    GpuProfileScope scope(&gpuProfiler_, cmdBuffer, "BasePass");
+    basePass_->BeginRenderPass(i, cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    basePass_->RecordDraws(cmdBuffer, 0, static_cast<uint32_t>(GetDrawGroups().size()));
+    RenderComponentBuildCommandBuffers(scene, cmdBuffer);
+    vkCmdEndRenderPass(cmdBuffer);
+  }
 
-      RenderComponentBuildCommandBuffers(scene, drawCmdBuffers_[i]);
+  if (headless_ && !capturePath_.empty()) {
+    RecordCapture(cmdBuffer);
+  }
 
-      // end base pass
-      vkCmdEndRenderPass(drawCmdBuffers_[i]);
+  VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+}
+
+// 把 draw list 切成若干段, 每段由一个 worker 录制到自己的 secondary 里, 最后由 primary 依次执行
+void VulkanContext::BuildCommandBuffersParallel(Scene* scene, VkCommandBuffer primary) {
+  FrameData& frame = frames_[currentFrame_];
+  const uint32_t image_index = currentBuffer_;
+  const uint32_t draw_count = static_cast<uint32_t>(GetDrawGroups().size());
+  // indirect draws cost the same whatever the count, splitting them would only add vkCmdExecuteCommands
+  const uint32_t chunk_count =
+      options_.indirectDraws ? 1u
+                             : std::clamp((draw_count + kMinDrawsPerChunk - 1) / kMinDrawsPerChunk, 1u,
+                                          recordPool_->size());
+  const uint32_t chunk_size = (draw_count + chunk_count - 1) / chunk_count;
+
+  // the frame fence has been waited on, recycle every secondary of this frame at once
+  for (const auto& slot : frame.recordSlots) {
+    VK_CHECK_RESULT(vkResetCommandPool(device_->device(), slot.pool, 0));
+  }
+
+  uint32_t slot_index = 0;
+  auto record_chunks = [&](VulkanRenderPass* pass, std::vector<VkCommandBuffer>& secondaries) {
+    for (uint32_t c = 0; c < chunk_count; c++) {
+      RecordSlot* slot = &frame.recordSlots[slot_index++];
+      const uint32_t first = std::min(draw_count, c * chunk_size);
+      const uint32_t count = std::min(draw_count - first, chunk_size);
+      secondaries.push_back(slot->commandBuffer);
+      recordPool_->Submit([this, pass, slot, image_index, first, count] {
+        LVK_TRACE_SCOPE("RecordDrawChunk");
+        BeginSecondaryCommandBuffer(slot->commandBuffer, pass, image_index);
+        pass->RecordDraws(slot->commandBuffer, first, count);
+        VK_CHECK_RESULT(vkEndCommandBuffer(slot->commandBuffer));
+      });
     }
+  };
 
-    VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers_[i]));
+  std::vector<VkCommandBuffer> shadow_secondaries;
+  std::vector<VkCommandBuffer> base_secondaries;
+  if (shadowPass_) {
+    record_chunks(shadowPass_, shadow_secondaries);
+  }
+  record_chunks(basePass_, base_secondaries);
+
+  // render components (ui) are recorded here while the workers are busy, executed after the draws
+  RecordSlot& rc_slot = frame.recordSlots[slot_index++];
+  BeginSecondaryCommandBuffer(rc_slot.commandBuffer, basePass_, image_index);
+  RenderComponentBuildCommandBuffers(scene, rc_slot.commandBuffer);
+  VK_CHECK_RESULT(vkEndCommandBuffer(rc_slot.commandBuffer));
+  base_secondaries.push_back(rc_slot.commandBuffer);
+
+  recordPool_->Wait();
+
+  if (shadowPass_) {
+    GpuProfileScope scope(&gpuProfiler_, primary, "ShadowPass");
+    shadowPass_->BeginRenderPass(image_index, primary, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(primary, static_cast<uint32_t>(shadow_secondaries.size()), shadow_secondaries.data());
+    vkCmdEndRenderPass(primary);
   }
+
+  GpuProfileScope scope(&gpuProfiler_, primary, "BasePass");
+  basePass_->BeginRenderPass(image_index, primary, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  vkCmdExecuteCommands(primary, static_cast<uint32_t>(base_secondaries.size()), base_secondaries.data());
+  vkCmdEndRenderPass(primary);
+}
+
+void VulkanContext::BeginSecondaryCommandBuffer(VkCommandBuffer cmdBuffer, VulkanRenderPass* pass,
+                                                uint32_t imageIndex) {
+  const auto& pass_data = pass->GetRenderPassData();
+  VkCommandBufferInheritanceInfo inheritanceInfo = initializers::CommandBufferInheritanceInfo();
+  inheritanceInfo.renderPass = pass_data.renderPassHandle;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = pass_data.frameBuffers[imageIndex];
+
+  VkCommandBufferBeginInfo cmdBufInfo = initializers::CommandBufferBeginInfo();
+  cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+  VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 }
 
 void VulkanContext::CreateSynchronizationPrimitives() {
-  // Wait fences to sync command buffer access
+  VkSemaphoreCreateInfo semaphoreCreateInfo = initializers::SemaphoreCreateInfo();
+  // Fences start signaled so the first wait on every frame returns immediately
   VkFenceCreateInfo fenceCreateInfo = initializers::FenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-  waitFences_.resize(drawCmdBuffers_.size());
-  for (auto& fence : waitFences_) {
-    VK_CHECK_RESULT(vkCreateFence(device_->device(), &fenceCreateInfo, nullptr, &fence));
+  for (auto& frame : frames_) {
+    VK_CHECK_RESULT(vkCreateFence(device_->device(), &fenceCreateInfo, nullptr, &frame.fence));
+    // Ensures that the image is displayed before we start submitting new commands to the queue
+    VK_CHECK_RESULT(vkCreateSemaphore(device_->device(), &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+  }
+
+  // Ensures that the image is not presented until all commands have been submitted and executed.
+  // present may still wait on it after the frame fence signaled, so this one is per swapchain image.
+  renderCompleteSemaphores_.resize(GetSwapChainImageCount());
+  for (auto& semaphore : renderCompleteSemaphores_) {
+    VK_CHECK_RESULT(vkCreateSemaphore(device_->device(), &semaphoreCreateInfo, nullptr, &semaphore));
   }
+  imagesInFlight_.assign(GetSwapChainImageCount(), VK_NULL_HANDLE);
+
+  frameStats_.framesInFlight = static_cast<uint32_t>(frames_.size());
+}
+
+// returns the time in ms the cpu was blocked
+double VulkanContext::WaitForFence(VkFence fence) {
+  LVK_TRACE_FUNCTION();
+  auto start = std::chrono::high_resolution_clock::now();
+  VK_CHECK_RESULT(vkWaitForFences(device_->device(), 1, &fence, VK_TRUE, UINT64_MAX));
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
 }
 
 void VulkanContext::PrepareFrame() {
+  if (headless_) {
+    currentBuffer_ = currentFrame_;
+    return;
+  }
   // Acquire the next image from the swap chain
-  VkResult result = swapChain_.AcquireNextImage(semaphores_.presentComplete, &currentBuffer_);
+  VkResult result = swapChain_.AcquireNextImage(frames_[currentFrame_].presentComplete, &currentBuffer_);
   // Recreate the swapchain if it's no longer compatible with the surface
   // (OUT_OF_DATE) SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until
   // submitFrame() in case number of swapchain images will change on resize
@@ -917,7 +1702,8 @@ void VulkanContext::PrepareFrame() {
 }
 
 void VulkanContext::SubmitFrame() {
-  VkResult result = swapChain_.QueuePresent(queue_, currentBuffer_, semaphores_.renderComplete);
+  if (headless_) return;
+  VkResult result = swapChain_.QueuePresent(queue_, currentBuffer_, renderCompleteSemaphores_[currentBuffer_]);
   // Recreate the swapchain if it's no longer compatible with the surface
   // (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
   if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
@@ -928,23 +1714,78 @@ void VulkanContext::SubmitFrame() {
   } else {
     VK_CHECK_RESULT(result);
   }
-  VK_CHECK_RESULT(vkQueueWaitIdle(queue_));
+  // no vkQueueWaitIdle here, the per frame fence throttles the cpu instead
 }
 
 void VulkanContext::Draw(Scene* scene) {
+  LVK_TRACE_FUNCTION();
+  auto frame_start = std::chrono::high_resolution_clock::now();
+  FrameData& frame = frames_[currentFrame_];
+
+  // wait until the gpu is done with the resources of this frame slot
+  double wait_ms = WaitForFence(frame.fence);
+
   PrepareFrame();
 
+  // the acquired image may still be rendered by an older frame when
+  // there are more frames in flight than swapchain images
+  VkFence image_fence = imagesInFlight_[currentBuffer_];
+  if (image_fence != VK_NULL_HANDLE && image_fence != frame.fence) {
+    wait_ms += WaitForFence(image_fence);
+  }
+  imagesInFlight_[currentBuffer_] = frame.fence;
+
+  frameInProgress_ = true;
+
   UpdateUniformBuffers(scene);
+  recordedSetBinds_ = 0;
+  recordedPushes_ = 0;
+  recordedAvoidedChanges_ = 0;
+  auto record_start = std::chrono::high_resolution_clock::now();
+  BuildCommandBuffers(scene);
+  auto record_end = std::chrono::high_resolution_clock::now();
+  descriptorStats_.setBinds = recordedSetBinds_.load();
+  descriptorStats_.pushes = recordedPushes_.load();
+  sortStats_.avoidedStateChanges = recordedAvoidedChanges_.load();
+  double record_ms = std::chrono::duration<double, std::milli>(record_end - record_start).count();
 
   // Command buffer to be submitted to the queue
-  submitInfo_.commandBufferCount = 1;
-  submitInfo_.pCommandBuffers = &drawCmdBuffers_[currentBuffer_];
+  submitInfo_.pWaitSemaphores = &frame.presentComplete;
+  submitInfo_.pSignalSemaphores = &renderCompleteSemaphores_[currentBuffer_];
+  submitInfo_.pCommandBuffers = &frame.commandBuffer;
 
-  // Submit to queue
-  VK_CHECK_RESULT(vkQueueSubmit(queue_, 1, &submitInfo_, VK_NULL_HANDLE));
+  // Submit to queue, the fence signals once this frame's commands are done
+  VK_CHECK_RESULT(vkResetFences(device_->device(), 1, &frame.fence));
+  VK_CHECK_RESULT(vkQueueSubmit(queue_, 1, &submitInfo_, frame.fence));
 
   SubmitFrame();
 
+  if (headless_ && !capturePath_.empty()) {
+    WriteCapture();
+  }
+
+  frameInProgress_ = false;
+  currentFrame_ = (currentFrame_ + 1) % frames_.size();
+
+  // smooth the numbers a bit so they are readable in the overlay
+  auto frame_end = std::chrono::high_resolution_clock::now();
+  double frame_ms = std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+  const double k = 0.05;
+  frameStats_.cpuFrameMs += (frame_ms - frameStats_.cpuFrameMs) * k;
+  frameStats_.fenceWaitMs += (wait_ms - frameStats_.fenceWaitMs) * k;
+  frameStats_.recordMs += (record_ms - frameStats_.recordMs) * k;
+  if (frameStats_.cpuFrameMs > 0.0) {
+    frameStats_.overlap = 1.0 - std::min(1.0, frameStats_.fenceWaitMs / frameStats_.cpuFrameMs);
+  }
+
+  // pipelines created on demand after loading end up on disk too. the driver serializes the cache and the
+  // file is written on a background thread, the frame does not wait for either
+  constexpr auto kPipelineCacheSaveInterval = std::chrono::seconds(30);
+  if (std::chrono::steady_clock::now() - pipelineCacheSaveTime_ > kPipelineCacheSaveInterval) {
+    pipelineCacheSaveTime_ = std::chrono::steady_clock::now();
+    pipelineCacheFile_.SaveAsync(device_->device(), pipelineCache_);
+  }
+
   // UpdateOverlay(scene);
 }
 
@@ -954,6 +1795,8 @@ void VulkanContext::Prepare() {
   SetupSwapchain();
   CreateCommandBuffers();
   CreateSynchronizationPrimitives();
+  gpuProfiler_.Init(device_, static_cast<uint32_t>(frames_.size()),
+                    device_->queueFamilyProperties_[QueueFamilyIndex()].timestampValidBits);
   #if 0
   SetupDepthStencil();
   SetupRenderPass();
@@ -974,6 +1817,10 @@ VkPipelineShaderStageCreateInfo VulkanContext::LoadFragmentShader(const std::str
   return LoadShader(path, VK_SHADER_STAGE_FRAGMENT_BIT, device_);
 }
 
+VkPipelineShaderStageCreateInfo VulkanContext::LoadComputeShader(const std::string& path) {
+  return LoadShader(path, VK_SHADER_STAGE_COMPUTE_BIT, device_);
+}
+
 void VulkanContext::RenderComponentPrepare() {
   for (const auto& rc : rc_array_) {
     rc->Prepare(device_, this);
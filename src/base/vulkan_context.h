@@ -1,18 +1,36 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "draw_list.h"
+#include "frustum_culling.h"
+#include "instance_groups.h"
 #include "lvk_math.h"
 #include "primitives.h"
 #include "node.h"
+#include "thread_pool.h"
 #include "vulkan/vulkan_core.h"
 #include "vulkan_buffer.h"
+#include "vulkan_descriptor_allocator.h"
 #include "vulkan_device.h"
+#include "vulkan_geometry_arena.h"
+#include "vulkan_gpu_culling.h"
+#include "vulkan_gpu_profiler.h"
+#include "vulkan_pipeline_cache_file.h"
+#include "vulkan_pipeline_state_cache.h"
+#include "vulkan_renderpass.h"
+#include "vulkan_shader_cache.h"
 #include "vulkan_swapchain.h"
 #include "vulkan_texture.h"
+#include "vulkan_texture_cache.h"
+#include "vulkan_uniform_ring.h"
 
 namespace lvk {
 class VulkanDevice;
@@ -20,6 +38,7 @@ class Scene;
 class Material;
 class Window;
 class VulkanContext;
+class VulkanRenderPass;
 
 enum class PipelineType {
   Shadow,
@@ -46,14 +65,88 @@ class RenderComponent {
 struct VulkanContextOptions {
   Window *window{nullptr};
   VkFormat depthFormat{VK_FORMAT_UNDEFINED};
+  // 同时在 GPU 上执行的帧数, CPU 可以提前准备后面的帧
+  uint32_t maxFramesInFlight{2};
+  // 录制 secondary command buffer 的线程数, 0 表示在主线程上直接录制 primary
+  uint32_t recordThreads{0};
+  // 每个 pass 用 vkCmdDrawIndexedIndirect 一次提交所有 draw, 命令由 context 每帧写入
+  bool indirectDraws{false};
+  // 在 compute shader 里对相机和主光源做视锥剔除, 生成每个 pass 的 indirect 命令, 隐含 indirectDraws
+  bool gpuCulling{false};
+  // the device enabled drawIndirectCount, culled draws are compacted and counted on the gpu
+  bool drawIndirectCount{false};
+  // 每帧在 CPU 上对相机视锥剔除节点, 只影响 base pass. gpuCulling 打开时不生效
+  bool cpuCulling{false};
+  // the device enabled descriptor indexing: set 1 holds every texture in one array, bound once per pass,
+  // and draws select theirs by the texture index in _DrawData
+  bool bindlessTextures{false};
+  // set 1 is pushed into the command buffer with vkCmdPushDescriptorSetWithTemplateKHR,
+  // no per node set is allocated. ignored when bindlessTextures is on
+  bool pushDescriptors{false};
+  // VkPipelineCache data is loaded from and saved to this file, empty keeps the cache in memory only
+  std::string pipelineCachePath;
+  // ignore the file on startup to measure a cold start, it is still written
+  bool coldPipelineCache{false};
+  // 编译 pipeline 的线程数, 加载场景时所有 pipeline 同时编译. 0 表示在主线程上逐个编译
+  uint32_t pipelineThreads{0};
+  // base pass draws whose pipeline is still compiling use a flat color pipeline instead of waiting
+  bool pipelineFallback{false};
+  // packed spir-v mapped at startup, shaders missing from it or an empty path load loose .spv files
+  std::string shaderArchivePath;
+};
+
+// frames in flight 的统计数据, 用于观察 CPU/GPU 的并行程度
+struct FrameStats {
+  uint32_t framesInFlight{0};
+  // cpu time of the whole Draw() call
+  double cpuFrameMs{0.0};
+  // cpu time blocked on fences, waiting for the gpu to release a frame
+  double fenceWaitMs{0.0};
+  // fraction of the frame the cpu was not blocked by the gpu, 1.0 = fully overlapped
+  double overlap{0.0};
+  // cpu time spent recording the frame's command buffers
+  double recordMs{0.0};
+  uint32_t recordThreads{0};
+};
+
+// per-frame counters of the per object uniform upload, static nodes are skipped
+struct UniformUploadStats {
+  uint64_t uploadedBytes{0};
+  uint64_t skippedBytes{0};
+  // contiguous runs of dirty nodes written this frame
+  uint32_t dirtyRanges{0};
+  uint32_t dirtyNodes{0};
+};
+
+// descriptor calls recorded by the last frame's passes, compares the ways set 1 is bound
+struct DescriptorBindingStats {
+  // vkCmdBindDescriptorSets calls
+  uint32_t setBinds{0};
+  // vkCmdPushDescriptorSetWithTemplateKHR calls
+  uint32_t pushes{0};
+  // set 1 of the scene: sets written and nodes that reused a set with the same bindings
+  uint32_t objectSets{0};
+  uint32_t sharedObjectSets{0};
+};
+
+// nodes drawing the same section with the same pipeline and material share one instanced draw
+struct InstancingStats {
+  uint32_t draws{0};
+  uint32_t instances{0};
+  // nodes moved to another group after the scene was built, e.g. by a material change
+  uint32_t regroupedNodes{0};
 };
 
 struct VulkanNode {
   PrimitiveMeshVK *vkMesh{nullptr};
   VulkanTexture *vkTexture{nullptr};
-  int vkTextureHandle{0};
-  // alias shaders
-  std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+  // index into vkTextureList, also the node's slot in the bindless texture array. -1 without texture
+  int vkTextureHandle{-1};
+  // reference into the context's texture cache, vkTexture points at its texture.
+  // nodes without one (or whose file failed to load) draw with the context's 1x1 default texture
+  VulkanTextureCache::Handle texture{VulkanTextureCache::kInvalidHandle};
+  // vertex and fragment shader, references into the context's shader module cache
+  std::vector<ShaderModuleCache::Handle> shaders;
   int pipelineHandle{0};
   // int descriptorSetHandle{0};
   VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
@@ -63,24 +156,22 @@ struct VulkanNode {
 
 // 如果使用不同的 unitofrm 或者不同的 texture,
 // 则需要创建新的 DescriptorSet
+// everything a set 1 binds, nodes with equal keys share one set.
+// per object buffers live in set 0 with dynamic offsets, set 1 only holds the texture
 struct DescriptorSetKey {
-  DescriptorSetKey() {}
-  DescriptorSetKey(void *ptr, int handle) : uniformBufferPtr(ptr), textureHandle(handle) {}
-  void *uniformBufferPtr;
-  int textureHandle;
-
-  bool operator==(const DescriptorSetKey &other) const {
-    if (this->uniformBufferPtr == other.uniformBufferPtr && this->textureHandle == other.textureHandle)
-      return true;
-    else
-      return false;
-  }
+  VkDescriptorSetLayout layout{VK_NULL_HANDLE};
+  VkImageView imageView{VK_NULL_HANDLE};
+  VkSampler sampler{VK_NULL_HANDLE};
+  VkImageLayout imageLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+
+  bool operator==(const DescriptorSetKey &other) const = default;
 
   struct HashFunction {
     size_t operator()(const DescriptorSetKey &key) const {
-      size_t rowHash = std::hash<void *>()(key.uniformBufferPtr);
-      size_t colHash = std::hash<int>()(key.textureHandle) << 1;
-      return rowHash ^ colHash;
+      size_t hash = std::hash<VkDescriptorSetLayout>()(key.layout);
+      hash = hash * 31 + std::hash<VkImageView>()(key.imageView);
+      hash = hash * 31 + std::hash<VkSampler>()(key.sampler);
+      return hash * 31 + std::hash<int>()(key.imageLayout);
     }
   };
 };
@@ -89,7 +180,8 @@ class VulkanContext {
   friend class VulkanShadowPass;
  public:
   // todo:
-  VulkanContext();
+  // headless 模式不创建 surface 和 swapchain, 渲染到离屏 image 上
+  explicit VulkanContext(bool headless = false);
   ~VulkanContext();
 
   // todo:
@@ -106,8 +198,11 @@ class VulkanContext {
   void UpdateSharedUniformBuffers(Scene *scene);
   void UpdateLightsUniformBuffers(Scene *scene);
 
+  // set layouts and the pipeline layout, needed before the first pipeline is created
   void SetupDescriptorSetLayout(VulkanDevice *device);
-  VkDescriptorSet AllocDescriptorSet(VulkanNode *vkNode);
+  // pool and sets, written once the buffers and textures of the scene exist
+  void SetupDescriptorSets(VulkanDevice *device);
+  VkDescriptorSet AllocDescriptorSet(const VkDescriptorImageInfo &texture);
   void CreatePipelineCache();
   void BuildPipelines();
 
@@ -122,12 +217,29 @@ class VulkanContext {
   void PrepareFrame();
   void SubmitFrame();
   void Draw(Scene *scene);
+  const FrameStats &GetFrameStats() const { return frameStats_; }
+  const UniformUploadStats &GetUniformUploadStats() const { return uploadStats_; }
+  const InstancingStats &GetInstancingStats() const { return instancingStats_; }
+  const DescriptorBindingStats &GetDescriptorBindingStats() const { return descriptorStats_; }
+  const DrawSortStats &GetDrawSortStats() const { return sortStats_; }
+  // lags frames in flight frames behind, all zero without gpu culling
+  const GpuCullingStats &GetGpuCullingStats() const { return gpuCulling_.stats(); }
+  const FrustumCullStats &GetFrustumCullStats() const { return cullStats_; }
+  PipelineStateCacheStats GetPipelineStateCacheStats() const { return pipelineStates_.stats(); }
+  const ShaderModuleCacheStats &GetShaderModuleCacheStats() const { return shaderModules_.stats(); }
+  const TextureCacheStats &GetTextureCacheStats() const { return textureCache_.stats(); }
+  const DescriptorAllocatorStats &GetDescriptorAllocatorStats() const { return descriptorAllocator_.stats(); }
+  // passes and render components open named scopes on it while recording
+  VulkanGpuProfiler *GetGpuProfiler() { return &gpuProfiler_; }
+  // vertex and index data of every mesh section, passes bind it once per recording
+  const VulkanGeometryArena *GetGeometryArena() const { return &geometryArena_; }
 
   void Prepare();
 
   // utils
   VkPipelineShaderStageCreateInfo LoadVertexShader(const std::string& path);
   VkPipelineShaderStageCreateInfo LoadFragmentShader(const std::string& path);
+  VkPipelineShaderStageCreateInfo LoadComputeShader(const std::string& path);
 
   VkInstance instance() const { return instance_; }
   // VkRenderPass renderPass() const { return renderPass_; }
@@ -141,20 +253,56 @@ class VulkanContext {
   //   return CreateDescriptor(&uniformBuffers_.dynamic, uniformBuffers_.dynamicAlignment);
   // }
 
-  VkDescriptorPool DescriptorPool() { return descriptorPool_; }
+  // bind set 0 / set 1 with the dynamic offsets of the frame being recorded.
+  // view selects the visible instance list the vertex shaders read
+  void BindSharedDescriptorSet(VkCommandBuffer cmdBuffer, CullView view = CullView::Camera);
+  void BindObjectDescriptorSet(VkCommandBuffer cmdBuffer, uint32_t nodeIndex);
+  // one instanced draw per group, passes record groups [first, first + count)
+  const std::vector<InstanceGroups::Group> &GetDrawGroups() const { return instanceGroups_.groups(); }
+  // direct draws only: group indices of the base pass in state and depth order, same size as GetDrawGroups()
+  const std::vector<uint32_t> &GetSortedDraws() const { return baseDrawList_.values(); }
+  // called by passes while recording, possibly from several threads
+  void CountAvoidedStateChanges(uint32_t count) { recordedAvoidedChanges_.fetch_add(count, std::memory_order_relaxed); }
+  // consecutive groups drawn with the same pipeline and texture
+  const std::vector<InstanceGroups::Run> &GetDrawRuns() const { return instanceGroups_.runs(); }
+  bool IsIndirectDraws() const { return options_.indirectDraws; }
+  bool IsGpuCulling() const { return options_.gpuCulling; }
+  bool IsCpuCulling() const { return options_.cpuCulling && !options_.gpuCulling; }
+  bool IsBindlessTextures() const { return options_.bindlessTextures; }
+  bool IsPushDescriptors() const { return options_.pushDescriptors && !options_.bindlessTextures; }
+  // instances of group the given view draws this frame, fewer than its nodes when culled on the cpu
+  uint32_t GetVisibleInstanceCount(uint32_t group, CullView view = CullView::Camera) const;
+  // draw groups [first, first + count) from the frame's indirect commands, one vkCmdDrawIndexedIndirect
+  // when multiDrawIndirect is enabled.
+  // with compacted gpu culling a camera call covers exactly one run and a light call all groups
+  void DrawIndirect(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count, CullView view = CullView::Camera);
   // const VkDescriptorSetLayout *DescriptorSetLayout() { return &descriptorSetLayout_; }
   VkPipelineLayout PipelineLayout() { return pipelineLayout_; }
 
   const VulkanNode *GetVkNode(int handle) { return &vkNodeList[handle]; }
-  // VkPipeline GetPipeline(int handle) { return pipelineList[handle]; }
+  // handle is VulkanNode::pipelineHandle. waits for a pipeline that is still compiling, unless the fallback is on
+  VkPipeline GetPipeline(int handle);
   VkQueue GetQueue() { return queue_; }
+  // frame in flight being recorded, its fence has been waited on
+  uint32_t GetCurrentFrame() const { return currentFrame_; }
   VkPipelineCache GetPipelineCache() { return pipelineCache_; }
+  // graphics pipelines of every pass, shared by all requests with the same state
+  PipelineStateCache *GetPipelineStateCache() { return &pipelineStates_; }
+  const VulkanPipelineCacheFile &GetPipelineCacheFile() const { return pipelineCacheFile_; }
+  // compile threads of the pipelines, nullptr when they are compiled on the calling thread
+  ThreadPool *GetPipelinePool() { return pipelinePool_.get(); }
   // VkRenderPass GetRenderPass() { return renderPass_; }
   VkRenderPass GetBasePassVkHandle();
-  VkFormat GetColorFormat() { return swapChain_.colorFormat(); }
+  VkFormat GetColorFormat() { return headless_ ? offscreenFormat_ : swapChain_.colorFormat(); }
   VkFormat GetDepthFormat() { return options_.depthFormat; }
-  size_t GetSwapChainImageCount() { return swapChain_.imageCount_; }
-  VkImageView GetSwapChainImageView(size_t i) { return swapChain_.buffers_[i].view; }
+  size_t GetSwapChainImageCount() { return headless_ ? offscreenTargets_.size() : swapChain_.imageCount_; }
+  VkImageView GetSwapChainImageView(size_t i) {
+    return headless_ ? offscreenTargets_[i].view : swapChain_.buffers_[i].view;
+  }
+  bool IsHeadless() const { return headless_; }
+
+  // headless only: copy the color target of the next Draw() back and write it to a png
+  void RequestCapture(const std::string &path) { capturePath_ = path; }
 
   // return vulkan device wrapper
   VulkanDevice* GetVulkanDevice() { return device_; };
@@ -173,7 +321,8 @@ class VulkanContext {
   VulkanContextOptions options_;
   VkInstance instance_{VK_NULL_HANDLE};
   VulkanSwapchain swapChain_;
-  VkDescriptorPool descriptorPool_{VK_NULL_HANDLE};
+  // sets of the scene, sized from its node and texture counts, recreated with the scene
+  VulkanDescriptorAllocator descriptorAllocator_;
   // VkDescriptorSet descriptorSet_{VK_NULL_HANDLE};
   // VkDescriptorSetLayout descriptorSetLayout_{VK_NULL_HANDLE};
   // VkDescriptorSetLayout sharedDescriptorSetLayout_{VK_NULL_HANDLE};
@@ -184,21 +333,85 @@ class VulkanContext {
 	  VkDescriptorSetLayout object{ VK_NULL_HANDLE };
     // extend here?
   } descriptorSetLayouts_;
+  // the mode descriptorSetLayouts_ and pipelineLayout_ were created for
+  bool layoutsBindless_{false};
+  // replaced when bindless got turned off by a rebuilt scene, destroyed with the context
+  std::vector<std::pair<DescriptorSetLayouts, VkPipelineLayout>> retiredLayouts_;
 
   VkDescriptorSet sharedDescriptorSet_{VK_NULL_HANDLE};
+  // bindless only: the texture array, replaces the per node sets
+  VkDescriptorSet textureDescriptorSet_{VK_NULL_HANDLE};
+  // upper bound of the array in the set 1 layout, the set itself is allocated with vkTextureList.size()
+  uint32_t BindlessTextureCapacity() const;
+  // push descriptors only: writes the texture of binding 1 straight from a VkDescriptorImageInfo
+  VkDescriptorUpdateTemplate textureUpdateTemplate_{VK_NULL_HANDLE};
+  PFN_vkCmdPushDescriptorSetWithTemplateKHR vkCmdPushDescriptorSetWithTemplateKHR_{nullptr};
+
+  // counted while recording, possibly from several threads, and published once the frame is recorded
+  std::atomic<uint32_t> recordedSetBinds_{0};
+  std::atomic<uint32_t> recordedPushes_{0};
+  DescriptorBindingStats descriptorStats_;
+
+  // base pass draw order of the frame, rebuilt after culling
+  DrawList baseDrawList_;
+  DrawSortStats sortStats_;
+  std::atomic<uint32_t> recordedAvoidedChanges_{0};
+  void SortDraws(Scene *scene);
 
   VkPipelineLayout pipelineLayout_{VK_NULL_HANDLE};
   // VkRenderPass renderPass_ = VK_NULL_HANDLE;
   VulkanDevice *device_{nullptr};
   VkPipelineCache pipelineCache_{VK_NULL_HANDLE};
+  PipelineStateCache pipelineStates_;
+  VulkanPipelineCacheFile pipelineCacheFile_;
+  // the cache is also saved while running, a crash or kill keeps the pipelines compiled so far
+  std::chrono::steady_clock::time_point pipelineCacheSaveTime_;
+  void SavePipelineCache();
+  // distinct base pass pipelines of the scene, indexed by VulkanNode::pipelineHandle
+  std::vector<PipelineStateCache::Handle> pipelines_;
+  PipelineStateCache::Handle fallbackPipeline_{PipelineStateCache::kInvalidHandle};
+  std::unique_ptr<ThreadPool> pipelinePool_;
 
   // std::vector<VkFramebuffer> frameBuffers_;
   uint32_t currentBuffer_ = 0;
   VkQueue queue_;
 
   VkCommandPool cmdPool_;
-  std::vector<VkCommandBuffer> drawCmdBuffers_;
-  std::vector<VkFence> waitFences_;
+
+  // 每个录制任务独占一个 command pool, 所以不同线程录制时不需要加锁
+  struct RecordSlot {
+    VkCommandPool pool{VK_NULL_HANDLE};
+    VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+  };
+
+  // 每个 in-flight 帧独立的资源, 等待 fence 之后才能复用
+  struct FrameData {
+    VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+    // secondaries of the parallel recording mode, pools are reset in bulk every frame
+    std::vector<RecordSlot> recordSlots;
+    VkFence fence{VK_NULL_HANDLE};
+    // Swap chain image presentation
+    VkSemaphore presentComplete{VK_NULL_HANDLE};
+  };
+  std::vector<FrameData> frames_;
+  uint32_t currentFrame_{0};
+  bool frameInProgress_{false};
+  // Command buffer submission and execution, one per swapchain image
+  std::vector<VkSemaphore> renderCompleteSemaphores_;
+  // fence of the frame currently rendering to each swapchain image
+  std::vector<VkFence> imagesInFlight_;
+  FrameStats frameStats_;
+  VulkanGpuProfiler gpuProfiler_;
+
+  bool headless_{false};
+  // replace the swapchain images in headless mode, one per frame in flight
+  std::vector<FrameBufferAttachment> offscreenTargets_;
+  VkFormat offscreenFormat_{VK_FORMAT_R8G8B8A8_UNORM};
+  // host visible copy of the captured color target
+  VulkanBuffer *readbackBuffer_{nullptr};
+  std::string capturePath_;
+  // workers recording secondaries, null when recording serially
+  std::unique_ptr<ThreadPool> recordPool_;
 
   std::vector<std::string> supportedInstanceExtensions;
   /** @brief Set of device extensions to be enabled for this example (must be
@@ -212,26 +425,27 @@ class VulkanContext {
   //   VkImageView view;
   // } depthStencil_;
 
-  struct {
-    // Swap chain image presentation
-    VkSemaphore presentComplete;
-    // Command buffer submission and execution
-    VkSemaphore renderComplete;
-  } semaphores_;
   VkSubmitInfo submitInfo_;
   VkPipelineStageFlags submitPipelineStages_ = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
-  struct _UBOMesh {
+  // one per instance slot, read by the vertex shaders with gl_InstanceIndex (std430)
+  struct _InstanceData {
     glm::mat4 model;
+    // index of the draw group, selects the _DrawData of the instance
+    uint32_t draw;
+    uint32_t padding[3];
   };
 
-  struct _UBOFragment {
+  // one per draw group, the nodes of a group share their material parameters (std430)
+  struct _DrawData {
     vec4f color;
     float roughness;
     float metallic;
-    float padding[2];
-    float padding2[8];
+    // slot in the bindless texture array, kNoTexture when the group has none
+    uint32_t textureIndex;
+    float padding;
   };
+  static constexpr uint32_t kNoTexture = UINT32_MAX;
 
   struct _UBOShared {
     vec4f camera_position;
@@ -242,30 +456,61 @@ class VulkanContext {
     mat4f view;
   };
 
-  struct UniformBuffer {
-    VulkanBuffer buffer;
-    size_t buffer_size{0};
-    size_t alignment{0};
+  // 所有 uniform 数据都放在这个常驻 map 的 ring 里, 每个 in-flight 帧一段
+  VulkanUniformRing uniformRing_;
+
+  // offsets of the current frame's uniform data inside uniformRing_, used as dynamic offsets
+  struct FrameUniforms {
+    VkDeviceSize shared{0};
+    // _InstanceData indexed by instance slot, tightly packed
+    VkDeviceSize instance{0};
+    // _DrawData and VkDrawIndexedIndirectCommand indexed by draw group
+    VkDeviceSize draw{0};
+    VkDeviceSize indirect{0};
+    // identity visible list, bound when the draws are not culled on the gpu
+    VkDeviceSize visible{0};
+    // gpu culling only: VulkanGpuCulling::Params and one GroupData per draw group
+    VkDeviceSize cullParams{0};
+    VkDeviceSize cullGroups{0};
+    // cpu culling only: visible list and indirect commands of the camera view, rewritten every frame
+    VkDeviceSize cameraVisible{0};
+    VkDeviceSize cameraIndirect{0};
+  } frameUniforms_;
+
+  // Node::generation() last written into each ring slice, [frame * nodeCount + nodeIndex].
+  // every slice keeps its old contents, so each one catches up on the nodes changed since its last use.
+  std::vector<uint64_t> uploadedGenerations_;
+  // [first, first + count) runs of vkNodeList that need to be written this frame
+  struct DirtyRange {
+    uint32_t first;
+    uint32_t count;
   };
-
-  struct _UniformBuffers {
-    _UBOMesh *model{nullptr};
-    _UBOFragment *fragment_data{nullptr};
-    _UBOShared *shared;
-    // uniform buffer for global proj & view matrix
-    // VulkanBuffer view;
-
-    UniformBuffer shared_ub;
-    // uniform buffer in vertex shader, per object data, all packed here
-    UniformBuffer vertex_ub;
-    // uniform buffer in pixel shader, per object data, all packed here
-    UniformBuffer fragment_ub;
-
-    // VulkanBuffer dynamic;
-    // size_t dynamicBufferSize{0};
-    // size_t dynamicAlignment{0};
-    // VulkanBuffer fragment;
-  } uniformBuffers_;
+  std::vector<DirtyRange> dirtyRanges_;
+  UniformUploadStats uploadStats_;
+  void CollectDirtyRanges();
+
+  InstanceGroups instanceGroups_;
+  // Node::generation() each node was last grouped with, only changed nodes are checked for a new group
+  std::vector<uint64_t> groupedGenerations_;
+  // InstanceGroups::layoutVersion() last written into each frame slice, a new layout rewrites every slot
+  std::vector<uint64_t> uploadedInstanceLayouts_;
+  InstancingStats instancingStats_;
+  VulkanGpuCulling gpuCulling_;
+  void UpdateCullingUniformBuffers(Scene *scene);
+
+  // world bounds of every node, indexed like vkNodeList
+  FrustumCuller frustumCuller_;
+  // Node::generation() each node's world bounds were computed from
+  std::vector<uint64_t> culledGenerations_;
+  // visible instances of each draw group in the camera view
+  std::vector<uint32_t> visibleInstanceCounts_;
+  FrustumCullStats cullStats_;
+  void CullNodes(Scene *scene);
+  InstanceKey MakeInstanceKey(uint32_t nodeIndex) const;
+  // instance slots and draw groups reserved per frame, never 0 so the descriptor ranges stay valid.
+  // there are never more groups than nodes.
+  uint32_t DrawCapacity() const;
+  void UpdateInstanceGroups();
 
   struct _VertexInputState {
     std::array<VkVertexInputBindingDescription, 1> bindingDescriptions;
@@ -276,13 +521,23 @@ class VulkanContext {
   // std::vector<VkPipeline> pipelineList;
   // std::vector<VkDescriptorSet> descriptorSetList;
 
+  // the distinct textures of the scene, owned by textureCache_
   std::vector<VulkanTexture *> vkTextureList;
+  VulkanGeometryArena geometryArena_;
+  // one per unique (mesh, section), nodes drawing the same section point at the same entry
   std::vector<PrimitiveMeshVK> vkMeshList;
   std::vector<VulkanNode> vkNodeList;
 
   // caches
   // std::map<DescriptorSetKey, VkDescriptorSet> descriptorSetCache_;
   std::unordered_map<DescriptorSetKey, VkDescriptorSet, DescriptorSetKey::HashFunction> descriptorSetCache_;
+  // one module per spv file and content, materials with the same shaders end up with the same pipeline
+  ShaderModuleCache shaderModules_;
+  ShaderArchive shaderArchive_;
+  // one texture per file and import settings, whatever number of nodes and scene textures use it
+  VulkanTextureCache textureCache_;
+  // white 1x1, bound as set 1 for nodes without a texture so every draw has a valid one
+  std::unique_ptr<VulkanTexture> defaultTexture_;
 
   std::vector<RenderComponent*> rc_array_;
 
@@ -305,12 +560,23 @@ class VulkanContext {
   VkResult CreateInstance(bool enableValidation);
   VkPipelineShaderStageCreateInfo LoadShader(std::string fileName, VkShaderStageFlagBits stage, VulkanDevice *device);
   bool LoadMaterial(VulkanNode *vkNode, const Material *mat, VulkanDevice *device);
+  // false and no reference kept when either file cannot be read
+  bool AcquireShaders(VulkanNode *vkNode, const std::string &vertPath, const std::string &fragPath);
+  std::vector<VkPipelineShaderStageCreateInfo> GetShaderStages(const VulkanNode &vkNode) const;
 
   void BuildLinePipeline();
   int FindOrCreatePipeline(const Node& node, const VulkanNode& vkNode);
   void FindOrCreateDescriptorSet(VulkanNode *vkNode);
   // void BuildPipelines();
   void UpdateOverlay(Scene* scene);
+  double WaitForFence(VkFence fence);
+  void CreateRecordSlots();
+  uint32_t QueueFamilyIndex();
+  void SetupOffscreenTargets();
+  void RecordCapture(VkCommandBuffer cmdBuffer);
+  void WriteCapture();
+  void BuildCommandBuffersParallel(Scene *scene, VkCommandBuffer primary);
+  void BeginSecondaryCommandBuffer(VkCommandBuffer cmdBuffer, VulkanRenderPass *pass, uint32_t imageIndex);
 
   void RenderComponentPrepare();
   void RenderComponentBuildCommandBuffers(Scene* scene, VkCommandBuffer command_buffer);
@@ -0,0 +1,97 @@
+#include "vulkan_descriptor_allocator.h"
+
+#include <algorithm>
+
+#include "lvk_log.h"
+#include "vulkan_initializers.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+void VulkanDescriptorAllocator::Init(VkDevice device, const std::vector<VkDescriptorPoolSize> &sizes,
+                                     uint32_t maxSets) {
+  device_ = device;
+  sizes_ = sizes;
+  maxSets_ = std::clamp(maxSets, 1u, kMaxSetsPerPool);
+  scale_ = 1;
+}
+
+void VulkanDescriptorAllocator::Destroy() {
+  if (current_ != VK_NULL_HANDLE) {
+    fullPools_.push_back(current_);
+    current_ = VK_NULL_HANDLE;
+  }
+  for (VkDescriptorPool pool : fullPools_) {
+    vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+  for (VkDescriptorPool pool : freePools_) {
+    vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+  fullPools_.clear();
+  freePools_.clear();
+  stats_.pools = stats_.sets = 0;
+}
+
+VkDescriptorPool VulkanDescriptorAllocator::NextPool() {
+  if (!freePools_.empty()) {
+    VkDescriptorPool pool = freePools_.back();
+    freePools_.pop_back();
+    return pool;
+  }
+
+  const uint32_t max_sets = std::min(maxSets_ * scale_, kMaxSetsPerPool);
+  std::vector<VkDescriptorPoolSize> sizes = sizes_;
+  for (auto &size : sizes) {
+    size.descriptorCount = std::max(size.descriptorCount * (max_sets / maxSets_), 1u);
+  }
+  // the next pool is twice as large, a scene that outgrew its estimate needs few chained pools
+  if (maxSets_ * scale_ < kMaxSetsPerPool) {
+    scale_ *= 2;
+  }
+
+  VkDescriptorPoolCreateInfo pool_info = initializers::DescriptorPoolCreateInfo(sizes, max_sets);
+  VkDescriptorPool pool{VK_NULL_HANDLE};
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device_, &pool_info, nullptr, &pool));
+  stats_.pools++;
+  return pool;
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::Allocate(VkDescriptorSetLayout layout, const void *pNext) {
+  if (current_ == VK_NULL_HANDLE) {
+    current_ = NextPool();
+  }
+  VkDescriptorSetAllocateInfo alloc_info = initializers::DescriptorSetAllocateInfo(current_, &layout, 1);
+  alloc_info.pNext = pNext;
+  VkDescriptorSet set{VK_NULL_HANDLE};
+  VkResult result = vkAllocateDescriptorSets(device_, &alloc_info, &set);
+  while (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+    // a reused pool may be smaller than the set, a new one that still fails is a real error
+    const bool new_pool = freePools_.empty();
+    fullPools_.push_back(current_);
+    current_ = NextPool();
+    stats_.grows++;
+    DEBUG_LOG("descriptor allocator: pool {} is full, chained pool {}", fullPools_.size(), stats_.pools);
+    alloc_info.descriptorPool = current_;
+    result = vkAllocateDescriptorSets(device_, &alloc_info, &set);
+    if (new_pool) break;
+  }
+  VK_CHECK_RESULT(result);
+  stats_.sets++;
+  return set;
+}
+
+void VulkanDescriptorAllocator::Reset() {
+  if (current_ != VK_NULL_HANDLE) {
+    fullPools_.push_back(current_);
+    current_ = VK_NULL_HANDLE;
+  }
+  // one call per pool returns all of its sets, nothing is freed set by set
+  for (VkDescriptorPool pool : fullPools_) {
+    VK_CHECK_RESULT(vkResetDescriptorPool(device_, pool, 0));
+    freePools_.push_back(pool);
+  }
+  fullPools_.clear();
+  stats_.sets = 0;
+}
+
+}  // namespace lvk
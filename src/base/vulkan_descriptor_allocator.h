@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+struct DescriptorAllocatorStats {
+  uint32_t pools{0};
+  // sets allocated since the last Reset()
+  uint32_t sets{0};
+  // pools chained because the current one returned OUT_OF_POOL_MEMORY or FRAGMENTED_POOL
+  uint32_t grows{0};
+};
+
+// 可以增长的 descriptor pool 分配器. 当前 pool 用完 (OUT_OF_POOL_MEMORY / FRAGMENTED_POOL) 时
+// 接上一个容量翻倍的新 pool 重试. set 不单独释放, Reset() 一次重置所有 pool, pool 留着下次复用.
+// pool 在第一次 Allocate() 时才创建, 不用的分配器没有开销.
+class VulkanDescriptorAllocator {
+ public:
+  // sizes and maxSets of the first pool, chained pools scale both by 2 up to kMaxSetsPerPool sets
+  void Init(VkDevice device, const std::vector<VkDescriptorPoolSize> &sizes, uint32_t maxSets);
+  void Destroy();
+
+  // pNext goes to VkDescriptorSetAllocateInfo, e.g. a variable descriptor count
+  VkDescriptorSet Allocate(VkDescriptorSetLayout layout, const void *pNext = nullptr);
+  // every set allocated so far becomes invalid, the gpu must be done with them
+  void Reset();
+
+  const DescriptorAllocatorStats &stats() const { return stats_; }
+
+ private:
+  static constexpr uint32_t kMaxSetsPerPool = 4096;
+
+  VkDescriptorPool NextPool();
+
+  VkDevice device_{VK_NULL_HANDLE};
+  std::vector<VkDescriptorPoolSize> sizes_;
+  uint32_t maxSets_{0};
+  // size of the next pool created, relative to sizes_ and maxSets_
+  uint32_t scale_{1};
+  VkDescriptorPool current_{VK_NULL_HANDLE};
+  // pools that ran out since the last Reset()
+  std::vector<VkDescriptorPool> fullPools_;
+  // reset pools waiting to be used again
+  std::vector<VkDescriptorPool> freePools_;
+  DescriptorAllocatorStats stats_;
+};
+
+}  // namespace lvk
@@ -8,6 +8,7 @@
 #include "lvk_log.h"
 #include "vulkan_buffer.h"
 #include "vulkan_initializers.h"
+#include "vulkan_memory_allocator.h"
 #include "vulkan_tools.h"
 
 
@@ -44,6 +45,13 @@ VulkanDevice::VulkanDevice(VkPhysicalDevice physicalDevice) {
   }
 }
 
+VulkanDevice::~VulkanDevice() {
+  if (allocator_) {
+    DEBUG_LOG("{}", allocator_->Report());
+    allocator_.reset();
+  }
+}
+
 uint32_t VulkanDevice::GetMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties,
                                      VkBool32 *memTypeFound) const {
   for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; i++) {
@@ -228,6 +236,8 @@ VkResult VulkanDevice::CreateLogicalDevice(VkPhysicalDeviceFeatures enabledFeatu
   // Create a default command pool for graphics command buffers
   commandPool_ = CreateCommandPool(queueFamilyIndices_.graphics);
 
+  allocator_ = std::make_unique<VulkanMemoryAllocator>(this);
+
   return result;
 }
 
@@ -302,22 +312,18 @@ VkResult VulkanDevice::CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPrope
   VkBufferCreateInfo bufferCreateInfo = initializers::BufferCreateInfo(usageFlags, size);
   VK_CHECK_RESULT(vkCreateBuffer(logicalDevice_, &bufferCreateInfo, nullptr, &buffer->buffer_));
 
-  // Create the memory backing up the buffer handle
+  // Sub-allocate the memory backing up the buffer handle
   VkMemoryRequirements memReqs;
-  VkMemoryAllocateInfo memAlloc = initializers::MemoryAllocateInfo();
   vkGetBufferMemoryRequirements(logicalDevice_, buffer->buffer_, &memReqs);
-  memAlloc.allocationSize = memReqs.size;
-  // Find a memory type index that fits the properties of the buffer
-  memAlloc.memoryTypeIndex = GetMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
   // If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also
   // need to enable the appropriate flag during allocation
-  VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+  VkMemoryAllocateFlags allocateFlags = 0;
   if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-    allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-    allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-    memAlloc.pNext = &allocFlagsInfo;
+    allocateFlags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
   }
-  VK_CHECK_RESULT(vkAllocateMemory(logicalDevice_, &memAlloc, nullptr, &buffer->memory_));
+  buffer->allocator_ = allocator_.get();
+  VK_CHECK_RESULT(allocator_->Allocate(memReqs, memoryPropertyFlags, VulkanMemoryAllocator::ResourceKind::kLinear,
+                                       &buffer->allocation_, allocateFlags));
 
   buffer->alignment_ = memReqs.alignment;
   buffer->size_ = size;
@@ -415,6 +421,18 @@ bool VulkanDevice::ExtensionSupported(std::string extension) {
   return (std::find(supportedExtensions_.begin(), supportedExtensions_.end(), extension) != supportedExtensions_.end());
 }
 
+bool VulkanDevice::IsUnifiedMemory() const {
+  if (properties_.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
+    return true;
+  }
+  for (uint32_t i = 0; i < memoryProperties_.memoryHeapCount; i++) {
+    if ((memoryProperties_.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
 VkFormat VulkanDevice::GetSupportedDepthFormat(bool checkSamplingSupport) {
   // All depth formats may be optional, so we need to find a suitable depth
   // format to use
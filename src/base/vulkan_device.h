@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -8,6 +9,7 @@
 namespace lvk {
 
 class VulkanBuffer;
+class VulkanMemoryAllocator;
 
 class VulkanDevice {
   friend class VulkanApp;
@@ -51,10 +53,17 @@ class VulkanDevice {
   void FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue,
                           bool free = true);
   bool ExtensionSupported(std::string extension);
+  // integrated GPUs and other devices whose memory is all device local, uploads can skip staging there
+  bool IsUnifiedMemory() const;
   VkFormat GetSupportedDepthFormat(bool checkSamplingSupport);
 
   const VkPhysicalDeviceFeatures& features() { return features_;}
+  // features the logical device was created with, a subset of features()
+  const VkPhysicalDeviceFeatures& enabledFeatures() const { return enabledFeatures_; }
   const VkPhysicalDeviceProperties& properties() { return properties_; }
+  const VkPhysicalDeviceMemoryProperties& memoryProperties() const { return memoryProperties_; }
+  // created with the logical device, VulkanBuffer and images sub-allocate from it
+  VulkanMemoryAllocator* allocator() { return allocator_.get(); }
   VkDevice device() const { return logicalDevice_; }
   VkPhysicalDevice physicalDevice() const { return vkPhysicalDevice_; }
 
@@ -68,6 +77,7 @@ class VulkanDevice {
   std::vector<VkQueueFamilyProperties> queueFamilyProperties_;
   std::vector<std::string> supportedExtensions_;
   VkCommandPool commandPool_{VK_NULL_HANDLE};
+  std::unique_ptr<VulkanMemoryAllocator> allocator_;
   struct {
     uint32_t graphics;
     uint32_t compute;
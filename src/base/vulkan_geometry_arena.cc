@@ -0,0 +1,181 @@
+#include "vulkan_geometry_arena.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "lvk_log.h"
+#include "primitives.h"
+#include "vertex_data.h"
+#include "vulkan_buffer.h"
+#include "vulkan_device.h"
+#include "vulkan_initializers.h"
+#include "vulkan_tools.h"
+#include "vulkan_upload_batch.h"
+
+namespace lvk {
+
+namespace {
+
+// first buffer sizes, a scene load normally calls Reserve() with the exact counts
+constexpr uint32_t kInitialVertices = 64 * 1024;
+constexpr uint32_t kInitialIndices = 192 * 1024;
+
+constexpr VkMemoryPropertyFlags kUnifiedMemoryFlags =
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+}  // namespace
+
+void VulkanGeometryArena::Init(VulkanDevice *device, VkQueue queue) {
+  device_ = device;
+  queue_ = queue;
+
+  VkBool32 unified_type_found = VK_FALSE;
+  device_->GetMemoryType(~0u, kUnifiedMemoryFlags, &unified_type_found);
+  hostVisible_ = device_->IsUnifiedMemory() && unified_type_found;
+  DEBUG_LOG("geometry arena: {}", hostVisible_ ? "unified memory, written in place" : "device local, staged uploads");
+
+  vertices_.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  vertices_.stride = sizeof(VertexLayout);
+  indices_.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+  indices_.stride = sizeof(uint32_t);
+  Grow(vertices_, kInitialVertices, nullptr);
+  Grow(indices_, kInitialIndices, nullptr);
+  grows_ = 0;
+}
+
+void VulkanGeometryArena::Destroy() {
+  for (Storage *storage : {&vertices_, &indices_}) {
+    if (storage->buffer) {
+      storage->buffer->Unmap();
+      // VulkanBuffer::Destroy deletes the object
+      storage->buffer->Destroy();
+      storage->buffer = nullptr;
+    }
+    storage->ranges.Reset(0);
+  }
+  sections_ = 0;
+}
+
+void VulkanGeometryArena::Grow(Storage &storage, uint32_t minCapacity, VulkanUploadBatch *upload) {
+  uint32_t old_capacity = storage.ranges.capacity();
+  if (minCapacity <= old_capacity) return;
+  // doubling keeps the number of copies logarithmic when sections trickle in
+  uint32_t capacity = std::max(minCapacity, old_capacity * 2);
+
+  VulkanBuffer *buffer = VulkanBuffer::Create(
+      device_, storage.usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      hostVisible_ ? kUnifiedMemoryFlags : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, capacity * storage.stride);
+  if (hostVisible_) {
+    VK_CHECK_RESULT(buffer->Map());
+  }
+
+  if (storage.buffer) {
+    // frames in flight may still read the old buffer
+    vkDeviceWaitIdle(device_->device());
+    VkDeviceSize old_size = old_capacity * storage.stride;
+    if (hostVisible_) {
+      memcpy(buffer->mapped(), storage.buffer->mapped(), old_size);
+      storage.buffer->Unmap();
+      storage.buffer->Destroy();
+    } else {
+      VulkanUploadBatch local_upload(device_, queue_);
+      VulkanUploadBatch *batch = upload ? upload : &local_upload;
+      VkCommandBuffer cmd = batch->commandBuffer();
+      // copies already recorded in the batch may target the old buffer
+      VkMemoryBarrier barrier = initializers::MemoryBarrierInfo();
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                           nullptr, 0, nullptr);
+      VkBufferCopy region{0, 0, old_size};
+      vkCmdCopyBuffer(cmd, storage.buffer->buffer(), buffer->buffer(), 1, &region);
+      batch->DeferDestroy(storage.buffer);
+    }
+    grows_++;
+  }
+  storage.buffer = buffer;
+  storage.ranges.Grow(capacity);
+
+  DEBUG_LOG("geometry arena: {} buffer {} -> {} elements", &storage == &vertices_ ? "vertex" : "index", old_capacity,
+            capacity);
+}
+
+uint32_t VulkanGeometryArena::AllocateRange(Storage &storage, uint32_t count, VulkanUploadBatch *upload) {
+  uint32_t offset = storage.ranges.Allocate(count);
+  if (offset == RangeAllocator::kInvalidOffset) {
+    Grow(storage, storage.ranges.capacity() + count, upload);
+    offset = storage.ranges.Allocate(count);
+  }
+  assert(offset != RangeAllocator::kInvalidOffset);
+  return offset;
+}
+
+void VulkanGeometryArena::Write(Storage &storage, uint32_t first, const void *data, uint32_t count,
+                                VulkanUploadBatch *upload) {
+  VkDeviceSize offset = first * storage.stride;
+  VkDeviceSize size = count * storage.stride;
+  if (hostVisible_) {
+    memcpy(reinterpret_cast<uint8_t *>(storage.buffer->mapped()) + offset, data, size);
+  } else if (upload) {
+    upload->CopyToBuffer(storage.buffer->buffer(), offset, data, size);
+  } else {
+    VulkanUploadBatch local_upload(device_, queue_);
+    local_upload.CopyToBuffer(storage.buffer->buffer(), offset, data, size);
+  }
+}
+
+void VulkanGeometryArena::Reserve(uint32_t vertexCount, uint32_t indexCount, VulkanUploadBatch *upload) {
+  // free space may be split, only the tail is guaranteed to be contiguous, so size against the used count
+  Grow(vertices_, vertices_.ranges.used() + vertexCount, upload);
+  Grow(indices_, indices_.ranges.used() + indexCount, upload);
+}
+
+GeometryRange VulkanGeometryArena::Add(const MeshSection &section, VulkanUploadBatch *upload) {
+  GeometryRange range;
+  if (section.vertices.empty() || section.indices.empty()) {
+    return range;
+  }
+
+  range.vertexCount = static_cast<uint32_t>(section.vertices.size());
+  range.indexCount = static_cast<uint32_t>(section.indices.size());
+  range.vertexOffset = static_cast<int32_t>(AllocateRange(vertices_, range.vertexCount, upload));
+  range.firstIndex = AllocateRange(indices_, range.indexCount, upload);
+
+  // indices stay relative to the section, vertexOffset is added by the draw
+  Write(vertices_, static_cast<uint32_t>(range.vertexOffset), section.vertices.data(), range.vertexCount, upload);
+  Write(indices_, range.firstIndex, section.indices.data(), range.indexCount, upload);
+
+  sections_++;
+  return range;
+}
+
+void VulkanGeometryArena::Remove(GeometryRange &range) {
+  if (!range.valid()) return;
+  vertices_.ranges.Free(static_cast<uint32_t>(range.vertexOffset), range.vertexCount);
+  indices_.ranges.Free(range.firstIndex, range.indexCount);
+  sections_--;
+  range = {};
+}
+
+void VulkanGeometryArena::Bind(VkCommandBuffer cmdBuffer) const {
+  VkBuffer vertex_buffer = vertices_.buffer->buffer();
+  VkDeviceSize offsets[1] = {0};
+  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertex_buffer, offsets);
+  vkCmdBindIndexBuffer(cmdBuffer, indices_.buffer->buffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+GeometryArenaStats VulkanGeometryArena::GetStats() const {
+  GeometryArenaStats stats;
+  stats.sections = sections_;
+  stats.vertexCapacity = vertices_.ranges.capacity();
+  stats.vertexUsed = vertices_.ranges.used();
+  stats.indexCapacity = indices_.ranges.capacity();
+  stats.indexUsed = indices_.ranges.used();
+  stats.grows = grows_;
+  stats.hostVisible = hostVisible_;
+  return stats;
+}
+
+}  // namespace lvk
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "range_allocator.h"
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class VulkanDevice;
+class VulkanBuffer;
+class VulkanUploadBatch;
+struct MeshSection;
+
+// 一个 MeshSection 在 arena 里的位置, 直接作为 vkCmdDrawIndexed 的参数
+struct GeometryRange {
+  int32_t vertexOffset{0};
+  uint32_t vertexCount{0};
+  uint32_t firstIndex{0};
+  uint32_t indexCount{0};
+
+  bool valid() const { return vertexCount > 0; }
+};
+
+struct GeometryArenaStats {
+  uint32_t sections{0};
+  uint32_t vertexCapacity{0};
+  uint32_t vertexUsed{0};
+  uint32_t indexCapacity{0};
+  uint32_t indexUsed{0};
+  // buffer reallocations since Init, each one costs a device wait and a copy
+  uint32_t grows{0};
+  bool hostVisible{false};
+};
+
+// 所有 mesh section 共用一个 vertex buffer 和一个 index buffer.
+// pass 每次录制只需要绑定一次, 每个 draw 通过 vertexOffset/firstIndex 找到自己的数据.
+// 顶点和索引各用一个 RangeAllocator 管理, section 可以随时加入和移除, 空间不够时 buffer 扩容.
+// buffer 放在 device local 内存里, 数据通过 VulkanUploadBatch 的 staging 拷贝进去;
+// UMA 设备上 device local 内存本身 host visible, 直接写入.
+class VulkanGeometryArena {
+ public:
+  void Init(VulkanDevice *device, VkQueue queue);
+  void Destroy();
+
+  // grow once for a whole batch of sections instead of once per Add().
+  // without an upload batch the copies are submitted right away
+  void Reserve(uint32_t vertexCount, uint32_t indexCount, VulkanUploadBatch *upload = nullptr);
+  GeometryRange Add(const MeshSection &section, VulkanUploadBatch *upload = nullptr);
+  // the caller makes sure no frame in flight still draws the range
+  void Remove(GeometryRange &range);
+
+  // vertex binding 0 + uint32 indices
+  void Bind(VkCommandBuffer cmdBuffer) const;
+
+  GeometryArenaStats GetStats() const;
+
+ private:
+  struct Storage {
+    VulkanBuffer *buffer{nullptr};
+    RangeAllocator ranges;
+    VkBufferUsageFlags usage{0};
+    VkDeviceSize stride{0};
+  };
+
+  void Grow(Storage &storage, uint32_t minCapacity, VulkanUploadBatch *upload);
+  uint32_t AllocateRange(Storage &storage, uint32_t count, VulkanUploadBatch *upload);
+  void Write(Storage &storage, uint32_t first, const void *data, uint32_t count, VulkanUploadBatch *upload);
+
+  VulkanDevice *device_{nullptr};
+  VkQueue queue_{VK_NULL_HANDLE};
+  // UMA: device local and host visible, written in place
+  bool hostVisible_{false};
+  Storage vertices_;
+  Storage indices_;
+  uint32_t sections_{0};
+  uint32_t grows_{0};
+};
+
+}  // namespace lvk
@@ -0,0 +1,244 @@
+#include "vulkan_gpu_culling.h"
+
+#include <assert.h>
+
+#include <array>
+#include <cstring>
+
+#include "lvk_log.h"
+#include "vulkan_buffer.h"
+#include "vulkan_device.h"
+#include "vulkan_initializers.h"
+#include "vulkan_pipelinebuilder.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+// must match local_size_x of cull_instances.comp and cull_draws.comp
+static constexpr uint32_t kCullGroupSize = 64;
+
+// counters of one frame: per group visible instances | per run compacted draws | totals, each for both views
+static constexpr uint32_t kTotalCounters = 2 * kCullViewCount;
+
+static VkDeviceSize AlignTo(VkDeviceSize size, VkDeviceSize alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+void VulkanGpuCulling::Init(VulkanDevice *device, uint32_t frameCount, VkDeviceSize alignment, bool compact) {
+  device_ = device;
+  frameCount_ = frameCount;
+  alignment_ = alignment;
+  compact_ = compact;
+}
+
+void VulkanGpuCulling::Create(uint32_t capacity, VulkanBuffer *ring, VkDeviceSize instanceRange) {
+  assert(device_);
+  // called again when the scene is rebuilt
+  Destroy();
+  capacity_ = capacity;
+
+  visibleBytes_ = AlignTo(capacity_ * sizeof(uint32_t), alignment_);
+  commandBytes_ = kCullViewCount * capacity_ * sizeof(VkDrawIndexedIndirectCommand);
+  counterBytes_ = (2 * kCullViewCount * capacity_ + kTotalCounters) * sizeof(uint32_t);
+  frameSize_ = kCullViewCount * visibleBytes_ + AlignTo(commandBytes_, alignment_) + AlignTo(counterBytes_, alignment_);
+
+  buffer_ = VulkanBuffer::Create(device_,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frameSize_ * frameCount_);
+  readback_ = VulkanBuffer::Create(device_, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   frameCount_ * kTotalCounters * sizeof(uint32_t));
+  VK_CHECK_RESULT(readback_->Map());
+  memset(readback_->mapped(), 0, frameCount_ * kTotalCounters * sizeof(uint32_t));
+  stats_ = {};
+
+  VkDevice device = device_->device();
+  std::vector<VkDescriptorPoolSize> pool_sizes = {
+      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 * frameCount_),
+      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frameCount_),
+      initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frameCount_)};
+  VkDescriptorPoolCreateInfo pool_info = initializers::DescriptorPoolCreateInfo(pool_sizes, frameCount_);
+  VK_CHECK_RESULT(vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptorPool_));
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {
+      // instance data of the frame, the same slice the vertex shaders read
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT,
+                                               0),
+      // group data
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT,
+                                               1),
+      // params
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT,
+                                               2),
+      // outputs of the frame: visible lists, indirect commands, counters
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+      initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+  };
+  VkDescriptorSetLayoutCreateInfo layout_info =
+      initializers::DescriptorSetLayoutCreateInfo(bindings.data(), static_cast<uint32_t>(bindings.size()));
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &descriptorSetLayout_));
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = initializers::PipelineLayoutCreateInfo(&descriptorSetLayout_, 1);
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipelineLayout_));
+
+  std::vector<VkDescriptorSetLayout> layouts(frameCount_, descriptorSetLayout_);
+  descriptorSets_.resize(frameCount_);
+  VkDescriptorSetAllocateInfo alloc_info =
+      initializers::DescriptorSetAllocateInfo(descriptorPool_, layouts.data(), frameCount_);
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &alloc_info, descriptorSets_.data()));
+
+  VkDescriptorBufferInfo instances{ring->buffer(), 0, instanceRange};
+  VkDescriptorBufferInfo groups{ring->buffer(), 0, capacity_ * sizeof(GroupData)};
+  VkDescriptorBufferInfo params{ring->buffer(), 0, sizeof(Params)};
+  for (uint32_t i = 0; i < frameCount_; i++) {
+    VkDescriptorBufferInfo visible{buffer_->buffer(), VisibleOffset(i, CullView::Camera),
+                                   kCullViewCount * visibleBytes_};
+    VkDescriptorBufferInfo commands{buffer_->buffer(), CommandsBase(i), commandBytes_};
+    VkDescriptorBufferInfo counters{buffer_->buffer(), CountersBase(i), counterBytes_};
+    std::vector<VkWriteDescriptorSet> writes = {
+        initializers::WriteDescriptorSet(descriptorSets_[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0, &instances),
+        initializers::WriteDescriptorSet(descriptorSets_[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, &groups),
+        initializers::WriteDescriptorSet(descriptorSets_[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2, &params),
+        initializers::WriteDescriptorSet(descriptorSets_[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &visible),
+        initializers::WriteDescriptorSet(descriptorSets_[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &commands),
+        initializers::WriteDescriptorSet(descriptorSets_[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &counters),
+    };
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  }
+
+  DEBUG_LOG("gpu culling: {} frames x {} bytes, {}", frameCount_, frameSize_,
+            compact_ ? "compacted draws" : "uncompacted draws");
+}
+
+void VulkanGpuCulling::BuildPipelines(VkPipelineCache pipelineCache,
+                                      const VkPipelineShaderStageCreateInfo &cullInstances,
+                                      const VkPipelineShaderStageCreateInfo &cullDraws) {
+  VulkanComputePipelineBuilder()
+      .shaderStage(cullInstances)
+      .build(device_->device(), pipelineCache, pipelineLayout_, &cullInstancesPipeline_, "CullInstances");
+  VulkanComputePipelineBuilder()
+      .shaderStage(cullDraws)
+      .build(device_->device(), pipelineCache, pipelineLayout_, &cullDrawsPipeline_, "CullDraws");
+}
+
+void VulkanGpuCulling::Destroy() {
+  if (!device_) return;
+  VkDevice device = device_->device();
+  if (cullInstancesPipeline_ != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, cullInstancesPipeline_, nullptr);
+    cullInstancesPipeline_ = VK_NULL_HANDLE;
+  }
+  if (cullDrawsPipeline_ != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, cullDrawsPipeline_, nullptr);
+    cullDrawsPipeline_ = VK_NULL_HANDLE;
+  }
+  if (pipelineLayout_ != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pipelineLayout_, nullptr);
+    pipelineLayout_ = VK_NULL_HANDLE;
+  }
+  if (descriptorSetLayout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout_, nullptr);
+    descriptorSetLayout_ = VK_NULL_HANDLE;
+  }
+  if (descriptorPool_ != VK_NULL_HANDLE) {
+    // frees the sets as well
+    vkDestroyDescriptorPool(device, descriptorPool_, nullptr);
+    descriptorPool_ = VK_NULL_HANDLE;
+    descriptorSets_.clear();
+  }
+  if (buffer_) {
+    buffer_->Destroy();
+    buffer_ = nullptr;
+  }
+  if (readback_) {
+    readback_->Unmap();
+    readback_->Destroy();
+    readback_ = nullptr;
+  }
+}
+
+void VulkanGpuCulling::Record(VkCommandBuffer cmdBuffer, uint32_t frameIndex, VkDeviceSize instanceOffset,
+                              VkDeviceSize groupOffset, VkDeviceSize paramsOffset, uint32_t instanceCount,
+                              uint32_t groupCount) {
+  frameIndex %= frameCount_;
+
+  // the fence of this slot has been waited on, the totals it copied last time are visible
+  const auto *totals = reinterpret_cast<const uint32_t *>(readback_->mapped()) + frameIndex * kTotalCounters;
+  for (uint32_t v = 0; v < kCullViewCount; v++) {
+    stats_.visibleInstances[v] = totals[v];
+    stats_.draws[v] = totals[kCullViewCount + v];
+  }
+
+  vkCmdFillBuffer(cmdBuffer, buffer_->buffer(), CountersBase(frameIndex), counterBytes_, 0);
+
+  // the counters are cleared before the atomics, earlier draws of this slot are done reading (fence)
+  VkMemoryBarrier barrier = initializers::MemoryBarrierInfo();
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  std::array<uint32_t, 3> offsets = {static_cast<uint32_t>(instanceOffset), static_cast<uint32_t>(groupOffset),
+                                     static_cast<uint32_t>(paramsOffset)};
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1,
+                          &descriptorSets_[frameIndex], static_cast<uint32_t>(offsets.size()), offsets.data());
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullInstancesPipeline_);
+  vkCmdDispatch(cmdBuffer, (instanceCount + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+  // the draw pass reads the per group counts of every instance
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullDrawsPipeline_);
+  vkCmdDispatch(cmdBuffer, (groupCount + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+  // commands and counts are read as indirect arguments, the visible lists by the vertex shaders
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  VkBufferCopy copy{};
+  copy.srcOffset = CountersBase(frameIndex) + 2 * kCullViewCount * capacity_ * sizeof(uint32_t);
+  copy.dstOffset = frameIndex * kTotalCounters * sizeof(uint32_t);
+  copy.size = kTotalCounters * sizeof(uint32_t);
+  vkCmdCopyBuffer(cmdBuffer, buffer_->buffer(), readback_->buffer(), 1, &copy);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+VkDeviceSize VulkanGpuCulling::VisibleOffset(uint32_t frameIndex, CullView view) const {
+  return frameIndex * frameSize_ + static_cast<uint32_t>(view) * visibleBytes_;
+}
+
+VkDeviceSize VulkanGpuCulling::CommandsBase(uint32_t frameIndex) const {
+  return frameIndex * frameSize_ + kCullViewCount * visibleBytes_;
+}
+
+VkDeviceSize VulkanGpuCulling::CountersBase(uint32_t frameIndex) const {
+  return CommandsBase(frameIndex) + AlignTo(commandBytes_, alignment_);
+}
+
+VkDeviceSize VulkanGpuCulling::CommandOffset(uint32_t frameIndex, CullView view, uint32_t group) const {
+  return CommandsBase(frameIndex) +
+         (static_cast<uint32_t>(view) * capacity_ + group) * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+VkDeviceSize VulkanGpuCulling::DrawCountOffset(uint32_t frameIndex, CullView view, uint32_t run) const {
+  // run counters follow the per group counters of both views
+  return CountersBase(frameIndex) +
+         ((kCullViewCount + static_cast<uint32_t>(view)) * capacity_ + run) * sizeof(uint32_t);
+}
+
+}  // namespace lvk
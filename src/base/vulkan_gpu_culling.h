@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "lvk_math.h"
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class VulkanDevice;
+class VulkanBuffer;
+
+// 剔除的视锥, 每个 view 有自己的可见列表和 indirect 命令
+enum class CullView : uint32_t {
+  Camera = 0,
+  // main light, read by the shadow pass
+  Light = 1,
+};
+constexpr uint32_t kCullViewCount = 2;
+
+// results of the culling pass, read back frames in flight frames later
+struct GpuCullingStats {
+  uint32_t visibleInstances[kCullViewCount]{};
+  uint32_t draws[kCullViewCount]{};
+};
+
+// GPU 视锥剔除.
+// 第一个 compute pass 每个 instance 一个线程, 用包围球测试相机和主光源的视锥,
+// 可见的 instance 追加到所在组的可见列表里 (从组的 firstInstance 开始连续存放).
+// 第二个 pass 每组一个线程, 把可见数量写成 indirect 命令, 空组被压缩掉, 数量由 vkCmdDrawIndexedIndirectCount 读取.
+// vertex shader 通过可见列表找到 instance, 所以剔除不需要搬动 instance 数据.
+// 每个 in-flight 帧有自己的一段输出, 不会覆盖 GPU 还在读的命令.
+class VulkanGpuCulling {
+ public:
+  // input of the culling pass, written by the context into the uniform ring (std140)
+  struct Params {
+    // 6 planes per view, see matrix::ExtractFrustumPlanes
+    vec4f planes[kCullViewCount * 6];
+    uint32_t instanceCount;
+    uint32_t groupCount;
+    uint32_t capacity;
+    // uints between the visible lists of two views
+    uint32_t visibleStride;
+    // 1 when empty draws are compacted away and counted on the gpu
+    uint32_t compact;
+    uint32_t padding[3];
+  };
+
+  // one per draw group, written with the draw data whenever the instance layout changes (std430)
+  struct GroupData {
+    vec4f boundingSphere;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+    // camera draws are compacted per texture run, so each run keeps its own set 1 binding.
+    // the light view does not sample textures and compacts every group into one run.
+    uint32_t cameraRun;
+    uint32_t cameraRunFirstGroup;
+    uint32_t padding[2];
+  };
+
+  // compact needs drawIndirectCount and multiDrawIndirect, without them every group keeps its
+  // slot and culled groups are drawn with instanceCount 0
+  void Init(VulkanDevice *device, uint32_t frameCount, VkDeviceSize alignment, bool compact);
+  // output buffers and descriptor sets for capacity instances and groups.
+  // bindings 0-2 read the instance data, group data and params from ring at dynamic offsets
+  void Create(uint32_t capacity, VulkanBuffer *ring, VkDeviceSize instanceRange);
+  void BuildPipelines(VkPipelineCache pipelineCache, const VkPipelineShaderStageCreateInfo &cullInstances,
+                      const VkPipelineShaderStageCreateInfo &cullDraws);
+  void Destroy();
+
+  // record both dispatches outside any render pass, the draws of frameIndex may read the output afterwards.
+  // also resolves the counters this slot wrote frameCount frames ago.
+  void Record(VkCommandBuffer cmdBuffer, uint32_t frameIndex, VkDeviceSize instanceOffset, VkDeviceSize groupOffset,
+              VkDeviceSize paramsOffset, uint32_t instanceCount, uint32_t groupCount);
+
+  VulkanBuffer *buffer() { return buffer_; }
+  bool compact() const { return compact_; }
+  const GpuCullingStats &stats() const { return stats_; }
+  // size of one view's visible list, the range of the graphics descriptor
+  VkDeviceSize visibleRange() const { return visibleBytes_; }
+
+  // offsets into buffer() for the current frame's output
+  VkDeviceSize VisibleOffset(uint32_t frameIndex, CullView view) const;
+  VkDeviceSize CommandOffset(uint32_t frameIndex, CullView view, uint32_t group) const;
+  VkDeviceSize DrawCountOffset(uint32_t frameIndex, CullView view, uint32_t run) const;
+
+ private:
+  VkDeviceSize CommandsBase(uint32_t frameIndex) const;
+  VkDeviceSize CountersBase(uint32_t frameIndex) const;
+
+  VulkanDevice *device_{nullptr};
+  uint32_t frameCount_{0};
+  VkDeviceSize alignment_{256};
+  bool compact_{false};
+  uint32_t capacity_{0};
+
+  // per frame: visible lists of both views | indirect commands of both views | counters
+  VulkanBuffer *buffer_{nullptr};
+  VkDeviceSize visibleBytes_{0};
+  VkDeviceSize commandBytes_{0};
+  VkDeviceSize counterBytes_{0};
+  VkDeviceSize frameSize_{0};
+  // the totals of the counters are copied here for the stats
+  VulkanBuffer *readback_{nullptr};
+  GpuCullingStats stats_;
+
+  VkDescriptorPool descriptorPool_{VK_NULL_HANDLE};
+  VkDescriptorSetLayout descriptorSetLayout_{VK_NULL_HANDLE};
+  // one per frame in flight, the output bindings point at the frame's region
+  std::vector<VkDescriptorSet> descriptorSets_;
+  VkPipelineLayout pipelineLayout_{VK_NULL_HANDLE};
+  VkPipeline cullInstancesPipeline_{VK_NULL_HANDLE};
+  VkPipeline cullDrawsPipeline_{VK_NULL_HANDLE};
+};
+
+}  // namespace lvk
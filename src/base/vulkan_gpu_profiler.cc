@@ -0,0 +1,139 @@
+#include "vulkan_gpu_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "lvk_log.h"
+#include "vulkan_device.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+void VulkanGpuProfiler::Init(VulkanDevice *device, uint32_t frameCount, uint32_t timestampValidBits) {
+  device_ = device->device();
+  frameCount_ = frameCount;
+  frameScopes_.assign(frameCount_, {});
+
+  const auto &limits = device->properties().limits;
+  if (!limits.timestampComputeAndGraphics || timestampValidBits == 0) {
+    DEBUG_LOG("gpu profiler disabled, timestamps are not supported on the graphics queue");
+    return;
+  }
+  timestampPeriod_ = limits.timestampPeriod;
+  timestampMask_ = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+
+  // begin + end query per scope
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = frameCount_ * kMaxScopesPerFrame * 2;
+  VK_CHECK_RESULT(vkCreateQueryPool(device_, &queryPoolInfo, nullptr, &queryPool_));
+}
+
+void VulkanGpuProfiler::Destroy() {
+  if (queryPool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device_, queryPool_, nullptr);
+    queryPool_ = VK_NULL_HANDLE;
+  }
+}
+
+void VulkanGpuProfiler::BeginFrame(VkCommandBuffer cmdBuffer, uint32_t frameIndex) {
+  if (!enabled()) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  frameIndex_ = frameIndex % frameCount_;
+  // the fence of this slot has been waited on, its queries are available without blocking
+  Resolve(frameIndex_);
+  frameScopes_[frameIndex_].clear();
+
+  uint32_t first_query = frameIndex_ * kMaxScopesPerFrame * 2;
+  vkCmdResetQueryPool(cmdBuffer, queryPool_, first_query, kMaxScopesPerFrame * 2);
+}
+
+uint32_t VulkanGpuProfiler::BeginScope(VkCommandBuffer cmdBuffer, const char *name) {
+  if (!enabled()) return UINT32_MAX;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &scopes = frameScopes_[frameIndex_];
+  if (scopes.size() >= kMaxScopesPerFrame) {
+    return UINT32_MAX;
+  }
+
+  uint32_t scope_id = static_cast<uint32_t>(scopes.size());
+  uint32_t query = (frameIndex_ * kMaxScopesPerFrame + scope_id) * 2;
+  scopes.push_back({name, query});
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool_, query);
+  return scope_id;
+}
+
+void VulkanGpuProfiler::EndScope(VkCommandBuffer cmdBuffer, uint32_t scopeId) {
+  if (!enabled() || scopeId == UINT32_MAX) return;
+
+  uint32_t query = (frameIndex_ * kMaxScopesPerFrame + scopeId) * 2 + 1;
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool_, query);
+}
+
+void VulkanGpuProfiler::Resolve(uint32_t frameIndex) {
+  const auto &scopes = frameScopes_[frameIndex];
+  if (scopes.empty()) return;
+
+  // value + availability per query, a scope whose queries are not both available is dropped
+  const uint32_t query_count = static_cast<uint32_t>(scopes.size()) * 2;
+  std::vector<uint64_t> results(query_count * 2);
+  VkResult result = vkGetQueryPoolResults(device_, queryPool_, frameIndex * kMaxScopesPerFrame * 2, query_count,
+                                          results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t) * 2,
+                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_SUCCESS && result != VK_NOT_READY) {
+    VK_CHECK_RESULT(result);
+  }
+
+  for (size_t i = 0; i < scopes.size(); i++) {
+    const uint64_t *begin = &results[i * 4];
+    const uint64_t *end = &results[i * 4 + 2];
+    if (!begin[1] || !end[1]) continue;
+
+    uint64_t ticks = ((end[0] & timestampMask_) - (begin[0] & timestampMask_)) & timestampMask_;
+    double ms = ticks * timestampPeriod_ / 1000000.0;
+
+    auto &history = FindOrAddHistory(scopes[i].name);
+    history.samples.push_back(ms);
+    if (history.samples.size() > kHistorySize) {
+      history.samples.pop_front();
+    }
+  }
+}
+
+VulkanGpuProfiler::History &VulkanGpuProfiler::FindOrAddHistory(const char *name) {
+  for (auto &history : history_) {
+    if (history.name == name) return history;
+  }
+  history_.push_back({name, {}});
+  return history_.back();
+}
+
+std::vector<GpuScopeStats> VulkanGpuProfiler::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::vector<GpuScopeStats> stats;
+  stats.reserve(history_.size());
+  std::vector<double> sorted;
+  for (const auto &history : history_) {
+    if (history.samples.empty()) continue;
+
+    sorted.assign(history.samples.begin(), history.samples.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    GpuScopeStats s;
+    s.name = history.name;
+    s.lastMs = history.samples.back();
+    s.minMs = sorted.front();
+    for (double v : sorted) s.avgMs += v;
+    s.avgMs /= sorted.size();
+    s.p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+    s.samples = static_cast<uint32_t>(sorted.size());
+    stats.push_back(s);
+  }
+  return stats;
+}
+
+}  // namespace lvk
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class VulkanDevice;
+
+// 一个命名区间最近若干帧的 GPU 耗时统计
+struct GpuScopeStats {
+  std::string name;
+  double lastMs{0.0};
+  double minMs{0.0};
+  double avgMs{0.0};
+  double p99Ms{0.0};
+  uint32_t samples{0};
+};
+
+// 基于 timestamp query 的 GPU profiler.
+// 每个 in-flight 帧有自己的一段 query, 这一段在下一次复用时(帧 fence 已经等过)才读回,
+// 所以读结果不会阻塞 CPU, 数据比当前帧晚 frames in flight 帧.
+class VulkanGpuProfiler {
+ public:
+  void Init(VulkanDevice *device, uint32_t frameCount, uint32_t timestampValidBits);
+  void Destroy();
+
+  // call right after vkBeginCommandBuffer of the frame's primary, outside any render pass.
+  // resolves the results this slot recorded frameCount frames ago and resets its queries.
+  void BeginFrame(VkCommandBuffer cmdBuffer, uint32_t frameIndex);
+
+  // returns a scope id for EndScope(), may be recorded into secondaries as well.
+  // name is kept until the scope is resolved, pass a string literal
+  uint32_t BeginScope(VkCommandBuffer cmdBuffer, const char *name);
+  void EndScope(VkCommandBuffer cmdBuffer, uint32_t scopeId);
+
+  // rolling statistics, one entry per scope name in first seen order
+  std::vector<GpuScopeStats> GetStats() const;
+  bool enabled() const { return queryPool_ != VK_NULL_HANDLE; }
+
+  static constexpr uint32_t kMaxScopesPerFrame = 32;
+  static constexpr size_t kHistorySize = 256;
+
+ private:
+  struct Scope {
+    const char *name;
+    uint32_t query;
+  };
+  struct History {
+    std::string name;
+    std::deque<double> samples;
+  };
+
+  void Resolve(uint32_t frameIndex);
+  History &FindOrAddHistory(const char *name);
+
+  VkDevice device_{VK_NULL_HANDLE};
+  VkQueryPool queryPool_{VK_NULL_HANDLE};
+  // nanoseconds per tick
+  double timestampPeriod_{1.0};
+  uint64_t timestampMask_{~0ull};
+  uint32_t frameCount_{0};
+  uint32_t frameIndex_{0};
+
+  // scopes opened in each frame slot, waiting to be resolved
+  std::vector<std::vector<Scope>> frameScopes_;
+  std::vector<History> history_;
+  // scopes may be opened while other threads record secondaries
+  mutable std::mutex mutex_;
+};
+
+// RAII helper, closes the scope at the end of the block
+class GpuProfileScope {
+ public:
+  GpuProfileScope(VulkanGpuProfiler *profiler, VkCommandBuffer cmdBuffer, const char *name)
+      : profiler_(profiler), cmdBuffer_(cmdBuffer) {
+    if (profiler_) scopeId_ = profiler_->BeginScope(cmdBuffer_, name);
+  }
+  ~GpuProfileScope() {
+    if (profiler_) profiler_->EndScope(cmdBuffer_, scopeId_);
+  }
+
+ private:
+  VulkanGpuProfiler *profiler_;
+  VkCommandBuffer cmdBuffer_;
+  uint32_t scopeId_{UINT32_MAX};
+};
+
+}  // namespace lvk
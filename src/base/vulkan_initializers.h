@@ -33,6 +33,12 @@ inline VkCommandBufferBeginInfo CommandBufferBeginInfo() {
   return cmdBufferBeginInfo;
 }
 
+inline VkCommandBufferInheritanceInfo CommandBufferInheritanceInfo() {
+  VkCommandBufferInheritanceInfo cmdBufferInheritanceInfo{};
+  cmdBufferInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  return cmdBufferInheritanceInfo;
+}
+
 inline VkBufferCreateInfo BufferCreateInfo() {
   VkBufferCreateInfo bufCreateInfo{};
   bufCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -398,6 +404,13 @@ inline VkFramebufferCreateInfo FramebufferCreateInfo() {
 	return framebufferCreateInfo;
 }
 
+// not MemoryBarrier(), that is a macro in winnt.h
+inline VkMemoryBarrier MemoryBarrierInfo() {
+  VkMemoryBarrier memoryBarrier{};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  return memoryBarrier;
+}
+
 /** @brief Initialize an image memory barrier with no image transfer ownership
  */
 inline VkImageMemoryBarrier ImageMemoryBarrier() {
@@ -0,0 +1,372 @@
+#include "vulkan_memory_allocator.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <bit>
+#include <format>
+
+#include "lvk_log.h"
+#include "vulkan_device.h"
+#include "vulkan_initializers.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+namespace {
+
+constexpr double kMiB = 1024.0 * 1024.0;
+
+uint32_t OrderOf(VkDeviceSize chunkSize) {
+  return static_cast<uint32_t>(std::countr_zero(chunkSize / VulkanMemoryAllocator::kMinAllocationSize));
+}
+
+}  // namespace
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(VulkanDevice *device)
+    : device_(device->device()), vulkanDevice_(device), memoryProperties_(device->memoryProperties()) {
+  const auto &limits = device->properties().limits;
+  nonCoherentAtomSize_ = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+  maxDeviceMemoryCount_ = limits.maxMemoryAllocationCount;
+  // pieces are aligned to their own size, a granularity up to the smallest piece never puts a buffer and an optimal
+  // image on the same page
+  separateImagePools_ = limits.bufferImageGranularity > kMinAllocationSize;
+
+  pools_.resize(memoryProperties_.memoryTypeCount * kPoolCount);
+  typeStats_.resize(memoryProperties_.memoryTypeCount);
+  blockSizes_.resize(memoryProperties_.memoryTypeCount);
+  for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; i++) {
+    VkDeviceSize heap_size = memoryProperties_.memoryHeaps[memoryProperties_.memoryTypes[i].heapIndex].size;
+    VkDeviceSize block_size = std::bit_floor(std::max<VkDeviceSize>(heap_size / 8, kMinAllocationSize));
+    blockSizes_[i] = std::min(block_size, kMaxBlockSize);
+  }
+
+  DEBUG_LOG("memory allocator: {} memory types, bufferImageGranularity {}, nonCoherentAtomSize {}",
+            memoryProperties_.memoryTypeCount, limits.bufferImageGranularity, nonCoherentAtomSize_);
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &pool : pools_) {
+    for (auto &block : pool.blocks) {
+      if (!block) continue;
+      if (block->allocationCount) {
+        ERROR_LOG("memory block destroyed with {} live allocations", block->allocationCount);
+      }
+      FreeDeviceMemory(block->memory, block->mapped);
+    }
+    pool.blocks.clear();
+  }
+  for (const auto &stats : typeStats_) {
+    if (stats.dedicatedCount) {
+      ERROR_LOG("{} dedicated allocations leaked", stats.dedicatedCount);
+    }
+  }
+}
+
+VkResult VulkanMemoryAllocator::AllocateDeviceMemory(uint32_t memoryType, VkDeviceSize size,
+                                                     VkMemoryAllocateFlags allocateFlags, VkDeviceMemory *memory,
+                                                     uint8_t **mapped) {
+  VkMemoryAllocateInfo memAlloc = initializers::MemoryAllocateInfo();
+  memAlloc.allocationSize = size;
+  memAlloc.memoryTypeIndex = memoryType;
+  VkMemoryAllocateFlagsInfo allocFlagsInfo{};
+  if (allocateFlags) {
+    allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    allocFlagsInfo.flags = allocateFlags;
+    memAlloc.pNext = &allocFlagsInfo;
+  }
+  VkResult result = vkAllocateMemory(device_, &memAlloc, nullptr, memory);
+  if (result != VK_SUCCESS) {
+    ERROR_LOG("vkAllocateMemory of {} bytes on memory type {} failed: {}", size, memoryType,
+              tools::ErrorString(result));
+    return result;
+  }
+  deviceMemoryCount_++;
+  if (deviceMemoryCount_ > maxDeviceMemoryCount_ * 9 / 10) {
+    ERROR_LOG("{} device memory objects, close to maxMemoryAllocationCount {}", deviceMemoryCount_,
+              maxDeviceMemoryCount_);
+  }
+
+  *mapped = nullptr;
+  if (memoryProperties_.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    // mapped once, a VkDeviceMemory can not be mapped twice for the resources sharing it
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(device_, *memory, 0, VK_WHOLE_SIZE, 0, &data));
+    *mapped = reinterpret_cast<uint8_t *>(data);
+  }
+  return VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory, uint8_t *mapped) {
+  if (mapped) {
+    vkUnmapMemory(device_, memory);
+  }
+  vkFreeMemory(device_, memory, nullptr);
+  deviceMemoryCount_--;
+}
+
+bool VulkanMemoryAllocator::AllocateFromBlock(Block &block, uint32_t order, VkDeviceSize *offset) {
+  uint32_t found = order;
+  while (found < block.freeLists.size() && block.freeLists[found].empty()) {
+    found++;
+  }
+  if (found == block.freeLists.size()) {
+    return false;
+  }
+
+  // lowest offset first keeps the live pieces packed at the front of the block
+  VkDeviceSize chunk = *block.freeLists[found].begin();
+  block.freeLists[found].erase(block.freeLists[found].begin());
+  // split down, the upper halves go back to the free lists
+  while (found > order) {
+    found--;
+    block.freeLists[found].insert(chunk + (kMinAllocationSize << found));
+  }
+
+  block.freeBytes -= kMinAllocationSize << order;
+  block.allocationCount++;
+  *offset = chunk;
+  return true;
+}
+
+void VulkanMemoryAllocator::FreeToBlock(Block &block, VkDeviceSize offset, uint32_t order) {
+  block.freeBytes += kMinAllocationSize << order;
+  block.allocationCount--;
+
+  // merge with the buddy as long as it is free as well
+  const uint32_t max_order = static_cast<uint32_t>(block.freeLists.size()) - 1;
+  while (order < max_order) {
+    VkDeviceSize buddy = offset ^ (kMinAllocationSize << order);
+    auto it = block.freeLists[order].find(buddy);
+    if (it == block.freeLists[order].end()) break;
+    block.freeLists[order].erase(it);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+  block.freeLists[order].insert(offset);
+}
+
+VkDeviceSize VulkanMemoryAllocator::LargestFree(const Block &block) {
+  for (size_t order = block.freeLists.size(); order-- > 0;) {
+    if (!block.freeLists[order].empty()) return kMinAllocationSize << order;
+  }
+  return 0;
+}
+
+VkResult VulkanMemoryAllocator::Allocate(const VkMemoryRequirements &memReqs, VkMemoryPropertyFlags properties,
+                                         ResourceKind kind, VulkanAllocation *allocation,
+                                         VkMemoryAllocateFlags allocateFlags) {
+  const uint32_t memory_type = vulkanDevice_->GetMemoryType(memReqs.memoryTypeBits, properties);
+  const VkDeviceSize chunk_size =
+      std::bit_ceil(std::max({memReqs.size, memReqs.alignment, kMinAllocationSize}));
+  const VkDeviceSize block_size = blockSizes_[memory_type];
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &type_stats = typeStats_[memory_type];
+
+  *allocation = {};
+  allocation->memoryType = memory_type;
+  allocation->requestedSize = memReqs.size;
+
+  // big resources would waste most of a block, allocate flags would apply to the whole block
+  if (chunk_size > block_size / 2 || allocateFlags) {
+    VkResult result =
+        AllocateDeviceMemory(memory_type, memReqs.size, allocateFlags, &allocation->memory, &allocation->mapped);
+    if (result != VK_SUCCESS) return result;
+    allocation->size = memReqs.size;
+    type_stats.dedicatedCount++;
+    type_stats.dedicatedBytes += memReqs.size;
+    type_stats.requestedBytes += memReqs.size;
+    type_stats.allocatedBytes += memReqs.size;
+    type_stats.allocationCount++;
+    return VK_SUCCESS;
+  }
+
+  const uint32_t pool_index = separateImagePools_ ? static_cast<uint32_t>(kind) : 0;
+  auto &pool = pools_[memory_type * kPoolCount + pool_index];
+  const uint32_t order = OrderOf(chunk_size);
+
+  VkDeviceSize offset = 0;
+  uint32_t block_index = UINT32_MAX;
+  for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+    if (pool.blocks[i] && pool.blocks[i]->freeBytes >= chunk_size && AllocateFromBlock(*pool.blocks[i], order, &offset)) {
+      block_index = i;
+      break;
+    }
+  }
+
+  if (block_index == UINT32_MAX) {
+    auto block = std::make_unique<Block>();
+    VkResult result = AllocateDeviceMemory(memory_type, block_size, 0, &block->memory, &block->mapped);
+    if (result != VK_SUCCESS) return result;
+    block->size = block_size;
+    block->freeBytes = block_size;
+    block->freeLists.resize(OrderOf(block_size) + 1);
+    block->freeLists.back().insert(0);
+
+    auto empty_slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+    block_index = static_cast<uint32_t>(empty_slot - pool.blocks.begin());
+    if (empty_slot == pool.blocks.end()) {
+      pool.blocks.push_back(std::move(block));
+    } else {
+      *empty_slot = std::move(block);
+    }
+    AllocateFromBlock(*pool.blocks[block_index], order, &offset);
+    DEBUG_LOG("memory type {}: new {} MB block, {} blocks in pool {}", memory_type, block_size / kMiB,
+              pool.blocks.size(), pool_index);
+  }
+
+  const Block &block = *pool.blocks[block_index];
+  allocation->memory = block.memory;
+  allocation->offset = offset;
+  allocation->size = chunk_size;
+  allocation->mapped = block.mapped ? block.mapped + offset : nullptr;
+  allocation->block = block_index;
+  allocation->pool = static_cast<uint8_t>(pool_index);
+  allocation->order = static_cast<uint8_t>(order);
+
+  type_stats.requestedBytes += memReqs.size;
+  type_stats.allocatedBytes += chunk_size;
+  type_stats.allocationCount++;
+  return VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::Free(VulkanAllocation &allocation) {
+  if (!allocation.valid()) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &type_stats = typeStats_[allocation.memoryType];
+  type_stats.requestedBytes -= allocation.requestedSize;
+  type_stats.allocatedBytes -= allocation.size;
+  type_stats.allocationCount--;
+
+  if (allocation.dedicated()) {
+    FreeDeviceMemory(allocation.memory, allocation.mapped);
+    type_stats.dedicatedCount--;
+    type_stats.dedicatedBytes -= allocation.size;
+    allocation = {};
+    return;
+  }
+
+  auto &pool = pools_[allocation.memoryType * kPoolCount + allocation.pool];
+  auto &block = pool.blocks[allocation.block];
+  assert(block && block->memory == allocation.memory);
+  FreeToBlock(*block, allocation.offset, allocation.order);
+
+  // keep one empty block around, so a resource recreated every frame does not hit the driver each time
+  if (block->allocationCount == 0) {
+    size_t live_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const auto &b) { return b != nullptr; });
+    if (live_blocks > 1) {
+      FreeDeviceMemory(block->memory, block->mapped);
+      block.reset();
+    }
+  }
+  allocation = {};
+}
+
+VkResult VulkanMemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties,
+                                                  VulkanAllocation *allocation, VkMemoryAllocateFlags allocateFlags) {
+  VkMemoryRequirements memReqs;
+  vkGetBufferMemoryRequirements(device_, buffer, &memReqs);
+  VkResult result = Allocate(memReqs, properties, ResourceKind::kLinear, allocation, allocateFlags);
+  if (result != VK_SUCCESS) return result;
+  return vkBindBufferMemory(device_, buffer, allocation->memory, allocation->offset);
+}
+
+VkResult VulkanMemoryAllocator::AllocateForImage(VkImage image, VkMemoryPropertyFlags properties,
+                                                 VulkanAllocation *allocation, VkImageTiling tiling) {
+  VkMemoryRequirements memReqs;
+  vkGetImageMemoryRequirements(device_, image, &memReqs);
+  ResourceKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::kOptimal : ResourceKind::kLinear;
+  VkResult result = Allocate(memReqs, properties, kind, allocation);
+  if (result != VK_SUCCESS) return result;
+  return vkBindImageMemory(device_, image, allocation->memory, allocation->offset);
+}
+
+VkMappedMemoryRange VulkanMemoryAllocator::MappedRange(const VulkanAllocation &allocation, VkDeviceSize offset,
+                                                       VkDeviceSize size) const {
+  VkMappedMemoryRange range = initializers::MappedMemoryRange();
+  range.memory = allocation.memory;
+  if (allocation.dedicated()) {
+    range.offset = offset;
+    range.size = size;
+    return range;
+  }
+
+  // other allocations share the memory object, so VK_WHOLE_SIZE would flush them as well.
+  // pieces are at least kMinAllocationSize aligned, widening to the atom size stays inside the piece
+  VkDeviceSize begin = allocation.offset + offset;
+  VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+  begin = begin / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+  end = (end + nonCoherentAtomSize_ - 1) / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+  range.offset = begin;
+  range.size = std::min(end, allocation.offset + allocation.size) - begin;
+  return range;
+}
+
+VulkanMemoryStats VulkanMemoryAllocator::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  VulkanMemoryStats stats;
+  stats.deviceMemoryCount = deviceMemoryCount_;
+  for (const auto &type_stats : typeStats_) {
+    stats.dedicatedCount += type_stats.dedicatedCount;
+    stats.allocationCount += type_stats.allocationCount;
+    stats.reservedBytes += type_stats.dedicatedBytes;
+    stats.requestedBytes += type_stats.requestedBytes;
+    stats.allocatedBytes += type_stats.allocatedBytes;
+  }
+  for (const auto &pool : pools_) {
+    for (const auto &block : pool.blocks) {
+      if (!block) continue;
+      stats.blockCount++;
+      stats.reservedBytes += block->size;
+      stats.freeBytes += block->freeBytes;
+      stats.largestFreeBytes = std::max(stats.largestFreeBytes, LargestFree(*block));
+    }
+  }
+  return stats;
+}
+
+std::string VulkanMemoryAllocator::Report() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::string report =
+      std::format("device memory objects {} / {}, bufferImageGranularity pools {}\n", deviceMemoryCount_,
+                  maxDeviceMemoryCount_, separateImagePools_ ? "split" : "shared");
+  for (uint32_t type = 0; type < memoryProperties_.memoryTypeCount; type++) {
+    const auto &type_stats = typeStats_[type];
+    if (type_stats.allocationCount == 0) continue;
+
+    // internal: lost to rounding up to a buddy size
+    double internal = type_stats.allocatedBytes
+                          ? 1.0 - static_cast<double>(type_stats.requestedBytes) / type_stats.allocatedBytes
+                          : 0.0;
+    report += std::format(
+        "type {} (flags {:#x}, heap {}): {} allocations, {:.2f} MB requested, {:.2f} MB allocated, internal "
+        "fragmentation {:.1f}%, {} dedicated ({:.2f} MB)\n",
+        type, memoryProperties_.memoryTypes[type].propertyFlags, memoryProperties_.memoryTypes[type].heapIndex,
+        type_stats.allocationCount, type_stats.requestedBytes / kMiB, type_stats.allocatedBytes / kMiB,
+        internal * 100.0, type_stats.dedicatedCount, type_stats.dedicatedBytes / kMiB);
+
+    for (uint32_t pool_index = 0; pool_index < kPoolCount; pool_index++) {
+      const auto &pool = pools_[type * kPoolCount + pool_index];
+      for (size_t i = 0; i < pool.blocks.size(); i++) {
+        const auto &block = pool.blocks[i];
+        if (!block) continue;
+        // external: free space that can not be handed out as one piece
+        VkDeviceSize largest = LargestFree(*block);
+        double external = block->freeBytes ? 1.0 - static_cast<double>(largest) / block->freeBytes : 0.0;
+        report += std::format(
+            "  {} block {}: {} allocations, {:.2f} / {:.2f} MB used, largest free {:.2f} MB, external "
+            "fragmentation {:.1f}%\n",
+            pool_index == 0 ? "linear" : "optimal", i, block->allocationCount,
+            (block->size - block->freeBytes) / kMiB, block->size / kMiB, largest / kMiB, external * 100.0);
+      }
+    }
+  }
+  return report;
+}
+
+}  // namespace lvk
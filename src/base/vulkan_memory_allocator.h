@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class VulkanDevice;
+
+// 从一个 VkDeviceMemory block 里切出来的一段
+struct VulkanAllocation {
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  VkDeviceSize offset{0};
+  // size reserved for the allocation, the requested size rounded up to a buddy size
+  VkDeviceSize size{0};
+  // host visible blocks stay mapped for their whole life, points at offset
+  uint8_t *mapped{nullptr};
+  uint32_t memoryType{UINT32_MAX};
+  // slot of the block in its pool, UINT32_MAX for a dedicated allocation
+  uint32_t block{UINT32_MAX};
+  uint8_t pool{0};
+  uint8_t order{0};
+  VkDeviceSize requestedSize{0};
+
+  bool valid() const { return memory != VK_NULL_HANDLE; }
+  bool dedicated() const { return block == UINT32_MAX; }
+};
+
+struct VulkanMemoryStats {
+  // live vkAllocateMemory objects, compare against maxMemoryAllocationCount
+  uint32_t deviceMemoryCount{0};
+  uint32_t blockCount{0};
+  uint32_t dedicatedCount{0};
+  uint32_t allocationCount{0};
+  // bytes held from the driver, blocks + dedicated allocations
+  VkDeviceSize reservedBytes{0};
+  // bytes asked for by the callers
+  VkDeviceSize requestedBytes{0};
+  // requested bytes rounded up to buddy sizes, the difference is internal fragmentation
+  VkDeviceSize allocatedBytes{0};
+  VkDeviceSize freeBytes{0};
+  VkDeviceSize largestFreeBytes{0};
+};
+
+// 按 memory type 分池的 buddy allocator.
+// 每个池由固定大小的 block 组成, 一个 block 是一次 vkAllocateMemory, 里面按 2 的幂切分,
+// 每一段都按自己的大小对齐, 所以只要段大小不小于 alignment 就满足对齐要求.
+// bufferImageGranularity 大于最小段时, buffer 和 optimal image 放在不同的 block 里, 永远不会相邻.
+// 超过半个 block 的请求直接单独分配.
+class VulkanMemoryAllocator {
+ public:
+  enum class ResourceKind : uint8_t {
+    // buffers and linear images
+    kLinear = 0,
+    kOptimal = 1,
+  };
+
+  explicit VulkanMemoryAllocator(VulkanDevice *device);
+  ~VulkanMemoryAllocator();
+
+  VkResult Allocate(const VkMemoryRequirements &memReqs, VkMemoryPropertyFlags properties, ResourceKind kind,
+                    VulkanAllocation *allocation, VkMemoryAllocateFlags allocateFlags = 0);
+  void Free(VulkanAllocation &allocation);
+
+  // allocate and bind in one go, the resource must not be bound yet
+  VkResult AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, VulkanAllocation *allocation,
+                             VkMemoryAllocateFlags allocateFlags = 0);
+  VkResult AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, VulkanAllocation *allocation,
+                            VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
+
+  // range of a mapped allocation for flush/invalidate, widened to nonCoherentAtomSize
+  VkMappedMemoryRange MappedRange(const VulkanAllocation &allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+  VulkanMemoryStats GetStats() const;
+  // per memory type usage and per block fragmentation, one line each
+  std::string Report() const;
+
+  // smallest piece handed out, also the finest alignment
+  static constexpr VkDeviceSize kMinAllocationSize = 256;
+  static constexpr VkDeviceSize kMaxBlockSize = 64ull * 1024 * 1024;
+
+ private:
+  struct Block {
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+    uint8_t *mapped{nullptr};
+    // free offsets per order, order n covers kMinAllocationSize << n bytes
+    std::vector<std::set<VkDeviceSize>> freeLists;
+    VkDeviceSize freeBytes{0};
+    uint32_t allocationCount{0};
+  };
+  struct Pool {
+    // freed blocks leave an empty slot so block indices stay valid
+    std::vector<std::unique_ptr<Block>> blocks;
+  };
+  struct TypeStats {
+    VkDeviceSize requestedBytes{0};
+    VkDeviceSize allocatedBytes{0};
+    uint32_t allocationCount{0};
+    uint32_t dedicatedCount{0};
+    VkDeviceSize dedicatedBytes{0};
+  };
+
+  static constexpr uint32_t kPoolCount = 2;
+
+  VkResult AllocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, VkMemoryAllocateFlags allocateFlags,
+                                VkDeviceMemory *memory, uint8_t **mapped);
+  void FreeDeviceMemory(VkDeviceMemory memory, uint8_t *mapped);
+  bool AllocateFromBlock(Block &block, uint32_t order, VkDeviceSize *offset);
+  void FreeToBlock(Block &block, VkDeviceSize offset, uint32_t order);
+  static VkDeviceSize LargestFree(const Block &block);
+
+  VkDevice device_{VK_NULL_HANDLE};
+  VulkanDevice *vulkanDevice_{nullptr};
+  VkPhysicalDeviceMemoryProperties memoryProperties_{};
+  VkDeviceSize nonCoherentAtomSize_{1};
+  bool separateImagePools_{false};
+  // per memory type, smaller heaps (e.g. the 256MB BAR heap) get smaller blocks
+  std::vector<VkDeviceSize> blockSizes_;
+
+  // [memoryType * kPoolCount + pool]
+  std::vector<Pool> pools_;
+  std::vector<TypeStats> typeStats_;
+  uint32_t deviceMemoryCount_{0};
+  uint32_t maxDeviceMemoryCount_{0};
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lvk
@@ -0,0 +1,114 @@
+#include "vulkan_pipeline_cache_file.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "lvk_log.h"
+
+namespace lvk {
+
+std::vector<uint8_t> VulkanPipelineCacheFile::Load(const VkPhysicalDeviceProperties &properties) {
+  loadedBytes_ = 0;
+  std::vector<uint8_t> data;
+  if (path_.empty()) return data;
+
+  std::ifstream in(path_, std::ios::binary | std::ios::ate);
+  if (!in.is_open()) {
+    DEBUG_LOG("pipeline cache: no {}, cold start", path_);
+    return data;
+  }
+  data.resize(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+  if (!in) {
+    ERROR_LOG("pipeline cache: failed to read {}", path_);
+    return {};
+  }
+
+  // the driver is not required to reject data of another device, check the header ourselves
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) {
+    ERROR_LOG("pipeline cache: {} is truncated ({} bytes), discarded", path_, data.size());
+    return {};
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.headerSize < sizeof(header) || header.headerSize > data.size() ||
+      header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+    ERROR_LOG("pipeline cache: {} has an invalid header, discarded", path_);
+    return {};
+  }
+  if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+      memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    DEBUG_LOG("pipeline cache: {} was written by another device or driver, discarded", path_);
+    return {};
+  }
+
+  loadedBytes_ = savedBytes_ = data.size();
+  DEBUG_LOG("pipeline cache: loaded {} bytes from {}", data.size(), path_);
+  return data;
+}
+
+bool VulkanPipelineCacheFile::Save(VkDevice device, VkPipelineCache cache) {
+  // a background save may still be writing the same temp file
+  Wait();
+  if (path_.empty() || cache == VK_NULL_HANDLE) return false;
+  const size_t saved = Write(device, cache, path_, savedBytes_);
+  if (saved == 0) return false;
+  savedBytes_ = saved;
+  return true;
+}
+
+void VulkanPipelineCacheFile::SaveAsync(VkDevice device, VkPipelineCache cache) {
+  if (path_.empty() || cache == VK_NULL_HANDLE) return;
+  if (pending_.valid()) {
+    if (pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+    Wait();
+  }
+  // vkGetPipelineCacheData may run next to the compile threads, the cache is internally synchronized
+  pending_ = std::async(std::launch::async, &VulkanPipelineCacheFile::Write, device, cache, path_, savedBytes_);
+}
+
+void VulkanPipelineCacheFile::Wait() {
+  if (!pending_.valid()) return;
+  const size_t saved = pending_.get();
+  if (saved > 0) {
+    savedBytes_ = saved;
+  }
+}
+
+size_t VulkanPipelineCacheFile::Write(VkDevice device, VkPipelineCache cache, const std::string &path,
+                                      size_t savedBytes) {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) return 0;
+  // the cache only grows, an unchanged size means nothing new was compiled
+  if (size == savedBytes) return 0;
+  std::vector<uint8_t> data(size);
+  // VK_INCOMPLETE would leave a truncated blob behind
+  if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) return 0;
+  data.resize(size);
+
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!out) {
+      ERROR_LOG("pipeline cache: failed to write {}", temp_path);
+      return 0;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    ERROR_LOG("pipeline cache: failed to replace {}: {}", path, error.message());
+    std::filesystem::remove(temp_path, error);
+    return 0;
+  }
+  DEBUG_LOG("pipeline cache: saved {} bytes to {}", data.size(), path);
+  return data.size();
+}
+
+}  // namespace lvk
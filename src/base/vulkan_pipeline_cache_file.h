@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+// 把 VkPipelineCache 的数据存到磁盘, 下次启动时作为 pInitialData 交给驱动, 省掉大部分 pipeline 编译.
+// 读取时先检查 header 的 vendorID, deviceID 和 pipelineCacheUUID, 换了 GPU 或驱动的文件直接丢弃.
+// 写入时先写临时文件再改名, 进程中途退出也不会留下半个文件.
+// 运行中的定期保存用 SaveAsync() 放到后台线程, 不占用渲染线程.
+class VulkanPipelineCacheFile {
+ public:
+  explicit VulkanPipelineCacheFile(std::string path = {}) : path_(std::move(path)) {}
+
+  // the data to create the cache with, empty when the file is missing, truncated or from another device
+  std::vector<uint8_t> Load(const VkPhysicalDeviceProperties &properties);
+  // write the current contents of cache, skipped when its size has not changed since the last Load() or Save()
+  bool Save(VkDevice device, VkPipelineCache cache);
+  // Save() on a background thread, returns right away. skipped while the previous one is still writing
+  void SaveAsync(VkDevice device, VkPipelineCache cache);
+  // block until a background save has finished
+  void Wait();
+
+  const std::string &path() const { return path_; }
+  // bytes accepted by Load(), 0 on a cold start
+  size_t loadedBytes() const { return loadedBytes_; }
+  size_t savedBytes() const { return savedBytes_; }
+
+ private:
+  // bytes written, 0 when the file was not written. touches no member, background saves run it
+  static size_t Write(VkDevice device, VkPipelineCache cache, const std::string &path, size_t savedBytes);
+
+  std::string path_;
+  size_t loadedBytes_{0};
+  // updated on the calling thread once a background save has been collected
+  size_t savedBytes_{0};
+  std::future<size_t> pending_;
+};
+
+}  // namespace lvk
@@ -0,0 +1,122 @@
+#include "vulkan_pipeline_state_cache.h"
+
+#include <assert.h>
+
+#include <chrono>
+#include <utility>
+
+#include "lvk_log.h"
+#include "thread_pool.h"
+#include "vulkan_pipelinebuilder.h"
+
+namespace lvk {
+
+void PipelineStateCache::Init(VkDevice device, VkPipelineCache pipelineCache, ThreadPool *pool) {
+  device_ = device;
+  pipelineCache_ = pipelineCache;
+  pool_ = pool;
+}
+
+void PipelineStateCache::Destroy() {
+  WaitAll();
+  for (const auto &pipeline : pipelines_) {
+    vkDestroyPipeline(device_, pipeline.get(), nullptr);
+  }
+  pipelines_.clear();
+  lookup_.clear();
+  moduleKeys_.clear();
+  std::lock_guard<std::mutex> lock(statsMutex_);
+  stats_.pipelines = 0;
+}
+
+PipelineStateCache::Handle PipelineStateCache::Request(const VulkanPipelineBuilder &builder,
+                                                       VkPipelineLayout pipelineLayout, VkRenderPass renderPass,
+                                                       const char *debugName) {
+  std::string key = builder.stateKey(pipelineLayout, renderPass);
+  auto iter = lookup_.find(key);
+  if (iter != lookup_.end()) {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.hits++;
+    return iter->second;
+  }
+
+  // the builder and name are copied, the job may run after the caller returned
+  auto compile = [this, builder, pipelineLayout, renderPass,
+                  name = std::string(debugName ? debugName : "pipeline")]() mutable {
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    auto start = std::chrono::steady_clock::now();
+    builder.build(device_, pipelineCache_, pipelineLayout, renderPass, &pipeline, name.c_str());
+    const double create_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    DEBUG_LOG("pipeline state cache: created {} in {:.2f} ms", name, create_ms);
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.createMs += create_ms;
+    return pipeline;
+  };
+
+  std::shared_future<VkPipeline> pipeline;
+  if (pool_) {
+    pipeline = pool_->Async(std::move(compile)).share();
+  } else {
+    std::promise<VkPipeline> promise;
+    promise.set_value(compile());
+    pipeline = promise.get_future().share();
+  }
+
+  const Handle handle = static_cast<Handle>(pipelines_.size());
+  pipelines_.push_back(std::move(pipeline));
+  for (const auto &stage : builder.stages()) {
+    moduleKeys_[stage.module].push_back(key);
+  }
+  lookup_.emplace(std::move(key), handle);
+  std::lock_guard<std::mutex> lock(statsMutex_);
+  stats_.misses++;
+  stats_.pipelines++;
+  return handle;
+}
+
+VkPipeline PipelineStateCache::TryGet(Handle handle) const {
+  assert(handle < pipelines_.size());
+  const auto &pipeline = pipelines_[handle];
+  if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return VK_NULL_HANDLE;
+  return pipeline.get();
+}
+
+VkPipeline PipelineStateCache::Wait(Handle handle) {
+  assert(handle < pipelines_.size());
+  const auto &pipeline = pipelines_[handle];
+  if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    auto start = std::chrono::steady_clock::now();
+    pipeline.wait();
+    const double wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.waitMs += wait_ms;
+  }
+  return pipeline.get();
+}
+
+void PipelineStateCache::ForgetModule(VkShaderModule module) {
+  auto iter = moduleKeys_.find(module);
+  if (iter == moduleKeys_.end()) return;
+  for (const auto &key : iter->second) {
+    auto pipeline = lookup_.find(key);
+    if (pipeline == lookup_.end()) continue;
+    // the module has to stay alive until every compile reading it is done
+    Wait(pipeline->second);
+    lookup_.erase(pipeline);
+  }
+  moduleKeys_.erase(iter);
+}
+
+void PipelineStateCache::WaitAll() {
+  for (Handle handle = 0; handle < pipelines_.size(); handle++) {
+    Wait(handle);
+  }
+}
+
+PipelineStateCacheStats PipelineStateCache::stats() const {
+  std::lock_guard<std::mutex> lock(statsMutex_);
+  return stats_;
+}
+
+}  // namespace lvk
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class ThreadPool;
+class VulkanPipelineBuilder;
+
+struct PipelineStateCacheStats {
+  uint32_t hits{0};
+  uint32_t misses{0};
+  uint32_t pipelines{0};
+  // time spent in vkCreateGraphicsPipelines on misses, what a warm VkPipelineCache saves.
+  // summed over the compile threads
+  double createMs{0.0};
+  // time Wait() blocked on pipelines that were still compiling
+  double waitMs{0.0};
+};
+
+// 以 VulkanPipelineBuilder 的完整状态为键缓存 VkPipeline.
+// 状态相同的 material 和 pass 共用同一个 pipeline, 新的组合第一次用到时才创建.
+// 有线程池时 Request() 只把编译任务放到线程池上就返回, 加载场景时所有 pipeline 一起编译, 第一次录制用到时才等待.
+// pipeline 归缓存所有, 调用者不要销毁.
+class PipelineStateCache {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+  // created pipelines go through pipelineCache, which may still save the driver some work on a miss.
+  // without a pool every miss is compiled on the calling thread
+  void Init(VkDevice device, VkPipelineCache pipelineCache, ThreadPool *pool = nullptr);
+  // waits for the compiles still running
+  void Destroy();
+
+  // main thread only. the builder is copied, a miss starts compiling it
+  Handle Request(const VulkanPipelineBuilder &builder, VkPipelineLayout pipelineLayout, VkRenderPass renderPass,
+                 const char *debugName = nullptr);
+  // may be called while recording from several threads, VK_NULL_HANDLE while the pipeline is still compiling
+  VkPipeline TryGet(Handle handle) const;
+  VkPipeline Wait(Handle handle);
+  void WaitAll();
+  // the module is about to be destroyed, a new one may get the same handle value with other code.
+  // waits for the compiles using it, then forgets their requests. the pipelines themselves stay valid
+  void ForgetModule(VkShaderModule module);
+  VkPipeline FindOrCreate(const VulkanPipelineBuilder &builder, VkPipelineLayout pipelineLayout,
+                          VkRenderPass renderPass, const char *debugName = nullptr) {
+    return Wait(Request(builder, pipelineLayout, renderPass, debugName));
+  }
+
+  // compile threads update it, returns a snapshot
+  PipelineStateCacheStats stats() const;
+
+ private:
+  VkDevice device_{VK_NULL_HANDLE};
+  VkPipelineCache pipelineCache_{VK_NULL_HANDLE};
+  ThreadPool *pool_{nullptr};
+  // VulkanPipelineBuilder::stateKey() -> handle
+  std::unordered_map<std::string, Handle> lookup_;
+  // lookup_ keys of the requests that used a module
+  std::unordered_map<VkShaderModule, std::vector<std::string>> moduleKeys_;
+  // indexed by handle, ready once compiled
+  std::vector<std::shared_future<VkPipeline>> pipelines_;
+  mutable std::mutex statsMutex_;
+  PipelineStateCacheStats stats_;
+};
+
+}  // namespace lvk
@@ -1,12 +1,14 @@
 #include "vulkan_pipelinebuilder.h"
 
+#include <type_traits>
+
 #include "vulkan_debug.h"
 #include "vulkan_initializers.h"
 #include "vulkan_tools.h"
 
 namespace lvk {
 
-uint32_t VulkanPipelineBuilder::numPipelinesCreated_ = 0;
+std::atomic<uint32_t> VulkanPipelineBuilder::numPipelinesCreated_ = 0;
 uint32_t VulkanComputePipelineBuilder::numPipelinesCreated_ = 0;
 
 VulkanPipelineBuilder::VulkanPipelineBuilder()
@@ -110,6 +112,87 @@ VulkanPipelineBuilder& VulkanPipelineBuilder::stencilStateOps(VkStencilFaceFlags
   return *this;
 }
 
+// raw bytes of a value without pointers, the key only has to be equal for equal states
+template <typename T>
+static void AppendKey(std::string* key, const T& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  key->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::string VulkanPipelineBuilder::stateKey(VkPipelineLayout pipelineLayout, VkRenderPass renderPass) const {
+  std::string key;
+  AppendKey(&key, pipelineLayout);
+  AppendKey(&key, renderPass);
+
+  AppendKey(&key, dynamicStates_.size());
+  for (VkDynamicState state : dynamicStates_) {
+    AppendKey(&key, state);
+  }
+
+  AppendKey(&key, shaderStages_.size());
+  for (const auto& stage : shaderStages_) {
+    AppendKey(&key, stage.flags);
+    AppendKey(&key, stage.stage);
+    AppendKey(&key, stage.module);
+    key.append(stage.pName ? stage.pName : "");
+    key.push_back('\0');
+    const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+    AppendKey(&key, specialization ? specialization->mapEntryCount : 0u);
+    if (specialization) {
+      for (uint32_t i = 0; i < specialization->mapEntryCount; i++) {
+        AppendKey(&key, specialization->pMapEntries[i]);
+      }
+      AppendKey(&key, specialization->dataSize);
+      key.append(static_cast<const char*>(specialization->pData), specialization->dataSize);
+    }
+  }
+
+  AppendKey(&key, vertexInputState_.vertexBindingDescriptionCount);
+  for (uint32_t i = 0; i < vertexInputState_.vertexBindingDescriptionCount; i++) {
+    AppendKey(&key, vertexInputState_.pVertexBindingDescriptions[i]);
+  }
+  AppendKey(&key, vertexInputState_.vertexAttributeDescriptionCount);
+  for (uint32_t i = 0; i < vertexInputState_.vertexAttributeDescriptionCount; i++) {
+    AppendKey(&key, vertexInputState_.pVertexAttributeDescriptions[i]);
+  }
+
+  AppendKey(&key, inputAssembly_.topology);
+  AppendKey(&key, inputAssembly_.primitiveRestartEnable);
+
+  AppendKey(&key, rasterizationState_.depthClampEnable);
+  AppendKey(&key, rasterizationState_.rasterizerDiscardEnable);
+  AppendKey(&key, rasterizationState_.polygonMode);
+  AppendKey(&key, rasterizationState_.cullMode);
+  AppendKey(&key, rasterizationState_.frontFace);
+  AppendKey(&key, rasterizationState_.depthBiasEnable);
+  AppendKey(&key, rasterizationState_.depthBiasConstantFactor);
+  AppendKey(&key, rasterizationState_.depthBiasClamp);
+  AppendKey(&key, rasterizationState_.depthBiasSlopeFactor);
+  AppendKey(&key, rasterizationState_.lineWidth);
+
+  AppendKey(&key, multisampleState_.rasterizationSamples);
+  AppendKey(&key, multisampleState_.sampleShadingEnable);
+  AppendKey(&key, multisampleState_.minSampleShading);
+  AppendKey(&key, multisampleState_.alphaToCoverageEnable);
+  AppendKey(&key, multisampleState_.alphaToOneEnable);
+
+  AppendKey(&key, depthStencilState_.depthTestEnable);
+  AppendKey(&key, depthStencilState_.depthWriteEnable);
+  AppendKey(&key, depthStencilState_.depthCompareOp);
+  AppendKey(&key, depthStencilState_.depthBoundsTestEnable);
+  AppendKey(&key, depthStencilState_.stencilTestEnable);
+  AppendKey(&key, depthStencilState_.front);
+  AppendKey(&key, depthStencilState_.back);
+  AppendKey(&key, depthStencilState_.minDepthBounds);
+  AppendKey(&key, depthStencilState_.maxDepthBounds);
+
+  AppendKey(&key, colorBlendAttachmentStates_.size());
+  for (const auto& attachment : colorBlendAttachmentStates_) {
+    AppendKey(&key, attachment);
+  }
+  return key;
+}
+
 VkResult VulkanPipelineBuilder::build(VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout,
                                       VkRenderPass renderPass, VkPipeline* outPipeline,
                                       const char* debugName) noexcept {
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <string>
 #include <vector>
 
 #include "vulkan/vulkan.h"
@@ -46,6 +48,11 @@ class VulkanPipelineBuilder final {
                  VkPipeline* outPipeline,
                  const char* debugName = nullptr) noexcept;
 
+  // every state build() passes to vkCreateGraphicsPipelines, serialized. builders with equal keys create
+  // identical pipelines, shaders are compared by module handle, entry point and specialization data
+  std::string stateKey(VkPipelineLayout pipelineLayout, VkRenderPass renderPass) const;
+  const std::vector<VkPipelineShaderStageCreateInfo>& stages() const { return shaderStages_; }
+
   static uint32_t getNumPipelinesCreated() { return numPipelinesCreated_; }
 
  private:
@@ -57,7 +64,8 @@ class VulkanPipelineBuilder final {
   VkPipelineMultisampleStateCreateInfo multisampleState_;
   VkPipelineDepthStencilStateCreateInfo depthStencilState_;
   std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachmentStates_;
-  static uint32_t numPipelinesCreated_;
+  // pipelines may be built on several threads
+  static std::atomic<uint32_t> numPipelinesCreated_;
 };
 
 class VulkanComputePipelineBuilder final {
@@ -3,6 +3,8 @@
 #include <vector>
 
 #include "vulkan/vulkan_core.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_pipeline_state_cache.h"
 
 
 namespace lvk {
@@ -18,7 +20,7 @@ class VulkanNode;
 
 struct FrameBufferAttachment {
   VkImage image;
-  VkDeviceMemory mem;
+  VulkanAllocation allocation;
   VkImageView view;
 };
 
@@ -41,6 +43,17 @@ class VulkanRenderPass {
 
   virtual void BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cmdBuffer, const VkCommandBufferBeginInfo* BeginInfo) {};
 
+  // begin the pass on a primary command buffer, with SECONDARY_COMMAND_BUFFERS contents the draws
+  // are recorded by RecordDraws() into secondaries and executed from the primary
+  virtual void BeginRenderPass(int cmdBufferIndex, VkCommandBuffer cmdBuffer, VkSubpassContents contents) {};
+  // record the draw groups [first, first + count) of the context, called from worker threads in parallel
+  virtual void RecordDraws(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) {};
+  // pipeline of this pass for a material's shaders, requests with the same state share one pipeline.
+  // it may still be compiling when this returns
+  virtual PipelineStateCache::Handle RequestPipeline(const std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) {
+    return PipelineStateCache::kInvalidHandle;
+  };
+
   const RenderPassData& GetRenderPassData() { return renderPassData_; }
   RenderPassType type() { return type_; }
 
@@ -1,5 +1,6 @@
 #include "vulkan_renderpass_base.h"
 
+#include <algorithm>
 #include <array>
 
 // #include "directional_light.h"
@@ -28,7 +29,9 @@ void VulkanBasePass::SetupRenderPass() {
   attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // headless targets are read back instead of presented
+  attachments[0].finalLayout =
+      context_->IsHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
   // Depth attachment
   attachments[1].format = depth_format;  // depthFormat;
   attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -104,16 +107,8 @@ void VulkanBasePass::SetupDepthStencil() {
   imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 
   VK_CHECK_RESULT(vkCreateImage(context_->GetVkDevice(), &imageCI, nullptr, &depthStencil_.image));
-  VkMemoryRequirements memReqs{};
-  vkGetImageMemoryRequirements(context_->GetVkDevice(), depthStencil_.image, &memReqs);
-
-  VkMemoryAllocateInfo memAllloc{};
-  memAllloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memAllloc.allocationSize = memReqs.size;
-  memAllloc.memoryTypeIndex =
-      context_->GetVulkanDevice()->GetMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  VK_CHECK_RESULT(vkAllocateMemory(context_->GetVkDevice(), &memAllloc, nullptr, &depthStencil_.mem));
-  VK_CHECK_RESULT(vkBindImageMemory(context_->GetVkDevice(), depthStencil_.image, depthStencil_.mem, 0));
+  VK_CHECK_RESULT(context_->GetVulkanDevice()->allocator()->AllocateForImage(
+      depthStencil_.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthStencil_.allocation));
 
   VkImageViewCreateInfo imageViewCI{};
   imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -170,7 +165,12 @@ static VkClearColorValue defaultClearColor = {{0.025f, 0.025f, 0.025f, 1.0f}};
 
 void VulkanBasePass::BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cmdBuffer,
                                         const VkCommandBufferBeginInfo* BeginInfo) {
-#if 0
+  BeginRenderPass(cmdBufferIndex, cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  RecordDraws(cmdBuffer, 0, static_cast<uint32_t>(context_->GetDrawGroups().size()));
+  vkCmdEndRenderPass(cmdBuffer);
+}
+
+void VulkanBasePass::BeginRenderPass(int cmdBufferIndex, VkCommandBuffer cmdBuffer, VkSubpassContents contents) {
   VkClearValue clearValues[2];
   clearValues[0].color = defaultClearColor;
   clearValues[1].depthStencil = {1.0f, 0};
@@ -184,52 +184,91 @@ void VulkanBasePass::BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cmdB
   renderPassBeginInfo.clearValueCount = 2;
   renderPassBeginInfo.pClearValues = clearValues;
 
-  const auto& vkNode = context_->GetVkNode(0);
   // Set target frame buffer
   renderPassBeginInfo.framebuffer = renderPassData_.frameBuffers[cmdBufferIndex];
 
-  VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, BeginInfo));
-
-  vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, contents);
+}
 
+void VulkanBasePass::RecordDraws(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) {
   VkViewport viewport = initializers::Viewport((float)context_->width, (float)context_->height, 0.0f, 1.0f);
   vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
   VkRect2D scissor = initializers::Rect2D(context_->width, context_->height, 0, 0);
   vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-  // uint32_t dynamic_offset = 0;
-  // vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 0, 1,
-  //                        GetDescriptorSetP(vkNode->descriptorSetHandle), 1, &dynamic_offset);
-  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetPipeline(vkNode->pipelineHandle));
-
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 0, 1, &sharedDescriptorSet_, 0,
-                          nullptr);
-
-  VkDeviceSize offsets[1] = {0};
-  for (auto node_index = 0; node_index < vkNodeList.size(); node_index++) {
-    const auto& vkn = &vkNodeList[node_index];
-    auto vkvb = vkn->vkMesh->vertexBuffer->buffer();
-    auto vkib = vkn->vkMesh->indexBuffer->buffer();
-    vkCmdBindVertexBuffers(cmdBuffer, VERTEX_BUFFER_BIND_ID, 1, &vkvb, offsets);
-    vkCmdBindIndexBuffer(cmdBuffer, vkib, 0, VK_INDEX_TYPE_UINT32);
-
-    std::array<uint32_t, 2> offset_array;
-    offset_array[0] = node_index * uniformBuffers_.vertex_ub.alignment;
-    offset_array[1] = node_index * uniformBuffers_.fragment_ub.alignment;
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 1, 1, &vkn->descriptorSet, 2,
-                            &offset_array[0]);
-    vkCmdDrawIndexed(cmdBuffer, vkn->vkMesh->indexCount, 1, 0, 0, 0);
+  context_->BindSharedDescriptorSet(cmdBuffer);
+
+  // all sections live in the geometry arena, bound once for the whole chunk
+  context_->GetGeometryArena()->Bind(cmdBuffer);
+
+  // one instanced draw per group, the model matrices are read from the instance buffer with gl_InstanceIndex
+  const auto& vkNodeList = context_->GetVkNodeList();
+  const auto& groups = context_->GetDrawGroups();
+  // bindless textures were bound with set 0, the draws pick theirs by index
+  const bool bind_textures = !context_->IsBindlessTextures();
+  if (context_->IsIndirectDraws()) {
+    // set 1 only holds the texture, the groups of a run share pipeline and texture and one indirect call.
+    // bindless runs only split on the pipeline
+    int bound_pipeline = -1;
+    for (const auto& run : context_->GetDrawRuns()) {
+      const uint32_t run_first = std::max(run.firstGroup, first);
+      const uint32_t run_end = std::min(run.firstGroup + run.groupCount, first + count);
+      if (run_first >= run_end) continue;
+      if (bound_pipeline != groups[run_first].key.pipeline) {
+        bound_pipeline = groups[run_first].key.pipeline;
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context_->GetPipeline(bound_pipeline));
+      }
+      if (bind_textures) {
+        context_->BindObjectDescriptorSet(cmdBuffer, groups[run_first].nodes[0]);
+      }
+      context_->DrawIndirect(cmdBuffer, run_first, run_end - run_first);
+    }
+    return;
   }
-#endif
+
+  // draws come in state order, a pipeline or set 1 bind is only needed when it changes
+  const auto& sorted_draws = context_->GetSortedDraws();
+  int bound_pipeline = -1;
+  int bound_texture = 0;
+  bool texture_bound = false;
+  uint32_t skipped_binds = 0;
+  for (uint32_t i = first; i < first + count; i++) {
+    const uint32_t group_index = sorted_draws[i];
+    const auto& group = groups[group_index];
+    const PrimitiveMeshVK* vkmesh = vkNodeList[group.nodes[0]].vkMesh;
+    // with cpu culling only the visible instances were packed at firstInstance
+    const uint32_t instance_count = context_->GetVisibleInstanceCount(group_index);
+    if (vkmesh->indexCount == 0 || instance_count == 0) continue;
+
+    if (bound_pipeline == group.key.pipeline) {
+      skipped_binds++;
+    } else {
+      vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context_->GetPipeline(group.key.pipeline));
+      bound_pipeline = group.key.pipeline;
+    }
+    // nodes of a group share texture and material parameters, the first one's set stands for all of them
+    if (bind_textures && texture_bound && bound_texture == group.key.texture) {
+      skipped_binds++;
+    } else if (bind_textures) {
+      context_->BindObjectDescriptorSet(cmdBuffer, group.nodes[0]);
+      bound_texture = group.key.texture;
+      texture_bound = true;
+    }
+    vkCmdDrawIndexed(cmdBuffer, vkmesh->indexCount, instance_count,
+                     vkmesh->geometry.firstIndex, vkmesh->geometry.vertexOffset, group.firstInstance);
+  }
+  context_->CountAvoidedStateChanges(skipped_binds);
 }
 
-void VulkanBasePass::BuildPipeline() {
+PipelineStateCache::Handle VulkanBasePass::RequestPipeline(
+    const std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) {
   std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachmentStates;
   colorBlendAttachmentStates.push_back(initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE));
 
-  // for general object
-  VulkanPipelineBuilder()
+  // for general object, the shaders come from the node's material
+  VulkanPipelineBuilder builder;
+  builder
       .dynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR})
       .primitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
       .polygonMode(VK_POLYGON_MODE_FILL)
@@ -240,9 +279,9 @@ void VulkanBasePass::BuildPipeline() {
       .depthWriteEnable(true)
       .depthCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL)
       .rasterizationSamples(VK_SAMPLE_COUNT_1_BIT)
-      .shaderStages(context_->GetVkNode(0)->shaderStages)
-      .build(context_->GetVkDevice(), context_->GetPipelineCache(), context_->PipelineLayout(),
-             renderPassData_.renderPassHandle, &renderPassData_.pipelineHandle, "BasePass");
+      .shaderStages(shaderStages);
+  return context_->GetPipelineStateCache()->Request(builder, context_->PipelineLayout(),
+                                                     renderPassData_.renderPassHandle, "BasePass");
 }
 
 void VulkanBasePass::SetupDescriptorSet() {
@@ -307,6 +346,4 @@ void VulkanBasePass::SetupDescriptorSet() {
 #endif
 }
 
-void VulkanBasePass::OnSceneChanged() { BuildPipeline(); }
-
 }  // namespace lvk
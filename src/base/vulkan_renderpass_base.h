@@ -9,9 +9,12 @@ namespace lvk {
 class VulkanBasePass : public VulkanRenderPass {
  public:
   virtual void Prepare() override;
-  virtual void OnSceneChanged() override;
 
   virtual void BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cmdBuffer, const VkCommandBufferBeginInfo* BeginInfo) override;
+  virtual void BeginRenderPass(int cmdBufferIndex, VkCommandBuffer cmdBuffer, VkSubpassContents contents) override;
+  virtual void RecordDraws(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) override;
+  virtual PipelineStateCache::Handle RequestPipeline(
+      const std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) override;
 
   VulkanBasePass(VulkanContext* context, Scene* scene, RenderPassType type): VulkanRenderPass(context, scene, type) {}
 
@@ -23,7 +26,6 @@ class VulkanBasePass : public VulkanRenderPass {
   void SetupFrameBuffer();
   void SetupRenderPass();
   void SetupDescriptorSet();
-  void BuildPipeline();
 
 };
 
@@ -88,16 +88,8 @@ void VulkanShadowPass::SetupDepthStencil() {
   imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
   VK_CHECK_RESULT(vkCreateImage(context_->GetVkDevice(), &imageCI, nullptr, &depthStencil_.image));
-  VkMemoryRequirements memReqs{};
-  vkGetImageMemoryRequirements(context_->GetVkDevice(), depthStencil_.image, &memReqs);
-
-  VkMemoryAllocateInfo memAllloc{};
-  memAllloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memAllloc.allocationSize = memReqs.size;
-  memAllloc.memoryTypeIndex =
-      context_->GetVulkanDevice()->GetMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  VK_CHECK_RESULT(vkAllocateMemory(context_->GetVkDevice(), &memAllloc, nullptr, &depthStencil_.mem));
-  VK_CHECK_RESULT(vkBindImageMemory(context_->GetVkDevice(), depthStencil_.image, depthStencil_.mem, 0));
+  VK_CHECK_RESULT(context_->GetVulkanDevice()->allocator()->AllocateForImage(
+      depthStencil_.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthStencil_.allocation));
 
   VkImageViewCreateInfo imageViewCI{};
   imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -169,6 +161,12 @@ static VkClearColorValue defaultClearColor = {{0.025f, 0.025f, 0.025f, 1.0f}};
 
 void VulkanShadowPass::BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cmdBuffer,
                                         const VkCommandBufferBeginInfo* BeginInfo) {
+  BeginRenderPass(cmdBufferIndex, cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  RecordDraws(cmdBuffer, 0, static_cast<uint32_t>(context_->GetDrawGroups().size()));
+  vkCmdEndRenderPass(cmdBuffer);
+}
+
+void VulkanShadowPass::BeginRenderPass(int cmdBufferIndex, VkCommandBuffer cmdBuffer, VkSubpassContents contents) {
   VkClearValue clearValues[1];
   clearValues[0].depthStencil = {1.0f, 0};
 
@@ -184,10 +182,11 @@ void VulkanShadowPass::BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cm
   // Set target frame buffer
   renderPassBeginInfo.framebuffer = renderPassData_.frameBuffers[cmdBufferIndex];
 
-  // VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, BeginInfo));
-
-  vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, contents);
+}
 
+void VulkanShadowPass::RecordDraws(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) {
+  // dynamic state is not inherited by secondaries, every chunk sets it again
   VkViewport viewport = initializers::Viewport((float)context_->width, (float)context_->height, 0.0f, 1.0f);
   vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
@@ -197,31 +196,31 @@ void VulkanShadowPass::BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cm
   // Set depth bias (constant factor, clamp, slope factor)
   vkCmdSetDepthBias(cmdBuffer, 1.25f, 0.0f, 1.75f);
 
-  // uint32_t dynamic_offset = 0;
-  // vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout(), 0, 1,
-  //                        GetDescriptorSetP(vkNode->descriptorSetHandle), 1, &dynamic_offset);
-  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderPassData_.pipelineHandle);
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    context_->GetPipelineStateCache()->Wait(pipelineRequest_));
+
+  // instances outside the light frustum are skipped when culling on the gpu
+  context_->BindSharedDescriptorSet(cmdBuffer, CullView::Light);
 
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context_->PipelineLayout(), 0, 1, &context_->sharedDescriptorSet_, 0,
-                          nullptr);
+  // all sections live in the geometry arena, bound once for the whole chunk
+  context_->GetGeometryArena()->Bind(cmdBuffer);
+
+  // only positions and model matrices are read, set 1 is not needed
+  if (context_->IsIndirectDraws()) {
+    context_->DrawIndirect(cmdBuffer, first, count, CullView::Light);
+    return;
+  }
 
-  VkDeviceSize offsets[1] = {0};
   const auto& vkNodeList = context_->GetVkNodeList();
-  for (auto node_index = 0; node_index < vkNodeList.size(); node_index++) {
-    const auto& vkn = &vkNodeList[node_index];
-    auto vkvb = vkn->vkMesh->vertexBuffer->buffer();
-    auto vkib = vkn->vkMesh->indexBuffer->buffer();
-    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vkvb, offsets);
-    vkCmdBindIndexBuffer(cmdBuffer, vkib, 0, VK_INDEX_TYPE_UINT32);
-
-    std::array<uint32_t, 2> offset_array;
-    offset_array[0] = node_index * context_->uniformBuffers_.vertex_ub.alignment;
-    offset_array[1] = node_index * context_->uniformBuffers_.fragment_ub.alignment;
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context_->PipelineLayout(), 1, 1, &vkn->descriptorSet, 2,
-                            &offset_array[0]);
-    vkCmdDrawIndexed(cmdBuffer, vkn->vkMesh->indexCount, 1, 0, 0, 0);
+  const auto& groups = context_->GetDrawGroups();
+  for (uint32_t group_index = first; group_index < first + count; group_index++) {
+    const auto& group = groups[group_index];
+    const PrimitiveMeshVK* vkmesh = vkNodeList[group.nodes[0]].vkMesh;
+    if (vkmesh->indexCount == 0) continue;
+
+    vkCmdDrawIndexed(cmdBuffer, vkmesh->indexCount, static_cast<uint32_t>(group.nodes.size()),
+                     vkmesh->geometry.firstIndex, vkmesh->geometry.vertexOffset, group.firstInstance);
   }
-  vkCmdEndRenderPass(cmdBuffer);
 }
 
 void VulkanShadowPass::BuildPipeline() {
@@ -231,9 +230,9 @@ void VulkanShadowPass::BuildPipeline() {
   std::vector<VkPipelineShaderStageCreateInfo> stageCreateInfo;
   stageCreateInfo.emplace_back(context_->LoadVertexShader("shadow.vert.spv"));
 
-  // for general object
-  VulkanPipelineBuilder()
-      .dynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS})
+  // for general object, a scene reload gets the same pipeline back from the state cache
+  VulkanPipelineBuilder builder;
+  builder.dynamicStates({VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS})
       .primitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
       .polygonMode(VK_POLYGON_MODE_FILL)
       .vertexInputState(VertexLayout::GetPiplineVertexInputState())
@@ -244,9 +243,9 @@ void VulkanShadowPass::BuildPipeline() {
       .depthCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL)
       .depthBiasEnable(VK_TRUE)
       .rasterizationSamples(VK_SAMPLE_COUNT_1_BIT)
-      .shaderStages(stageCreateInfo)
-      .build(context_->GetVkDevice(), context_->GetPipelineCache(), context_->PipelineLayout(),
-             renderPassData_.renderPassHandle, &renderPassData_.pipelineHandle, "ShadowPass");
+      .shaderStages(stageCreateInfo);
+  pipelineRequest_ = context_->GetPipelineStateCache()->Request(builder, context_->PipelineLayout(),
+                                                                renderPassData_.renderPassHandle, "ShadowPass");
 }
 
 void VulkanShadowPass::OnSceneChanged() { BuildPipeline(); }
@@ -12,6 +12,8 @@ class VulkanShadowPass : public VulkanRenderPass {
   virtual void OnSceneChanged() override;
 
   virtual void BuildCommandBuffer(int cmdBufferIndex, VkCommandBuffer cmdBuffer, const VkCommandBufferBeginInfo* BeginInfo) override;
+  virtual void BeginRenderPass(int cmdBufferIndex, VkCommandBuffer cmdBuffer, VkSubpassContents contents) override;
+  virtual void RecordDraws(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) override;
 
   VulkanShadowPass(VulkanContext* context, Scene* scene, RenderPassType type): VulkanRenderPass(context, scene, type) {}
 
@@ -25,6 +27,8 @@ class VulkanShadowPass : public VulkanRenderPass {
   void SetupRenderPass();
   void SetupDescriptorSet();
   void BuildPipeline();
+  // compiled in the background, the first recording waits for it
+  PipelineStateCache::Handle pipelineRequest_{PipelineStateCache::kInvalidHandle};
 
  public:
    const FrameBufferAttachment& GetDepthStencil() { return depthStencil_; }
@@ -0,0 +1,145 @@
+#include "vulkan_shader_cache.h"
+
+#include <assert.h>
+
+#include <format>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#include "lvk_log.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+void ShaderModuleCache::Init(VkDevice device, const ShaderArchive *archive) {
+  device_ = device;
+  archive_ = archive;
+}
+
+void ShaderModuleCache::Destroy() {
+  for (const Entry &entry : entries_) {
+    if (entry.module == VK_NULL_HANDLE) continue;
+    vkDestroyShaderModule(device_, entry.module, nullptr);
+  }
+  entries_.clear();
+  freeSlots_.clear();
+  lookup_.clear();
+  files_.clear();
+  stats_.modules = stats_.references = 0;
+  stats_.codeBytes = 0;
+}
+
+bool ShaderModuleCache::ReadFile(const std::string &path, std::vector<uint32_t> *code, size_t *size) {
+  std::ifstream is(path, std::ios::binary | std::ios::in | std::ios::ate);
+  if (!is.is_open()) return false;
+  *size = static_cast<size_t>(is.tellg());
+  // spir-v is a stream of 32 bit words, pCode has to be aligned to them
+  code->assign((*size + 3) / 4, 0);
+  is.seekg(0, std::ios::beg);
+  is.read(reinterpret_cast<char *>(code->data()), static_cast<std::streamsize>(*size));
+  return static_cast<bool>(is) && *size > 0;
+}
+
+ShaderModuleCache::Handle ShaderModuleCache::AddReference(const std::string &key) {
+  auto iter = lookup_.find(key);
+  if (iter == lookup_.end()) return kInvalidHandle;
+  entries_[iter->second].references++;
+  stats_.references++;
+  stats_.hits++;
+  return iter->second;
+}
+
+ShaderModuleCache::Handle ShaderModuleCache::Acquire(const std::string &path, VkShaderStageFlagBits stage) {
+  // packed shaders carry their hash, neither the hash nor the module needs a copy of the code
+  if (const ShaderArchive::Blob *blob = archive_ ? archive_->Find(path) : nullptr) {
+    std::string key = std::format("{}#{:016x}", path, blob->hash);
+    Handle handle = AddReference(key);
+    if (handle != kInvalidHandle) return handle;
+    stats_.archived++;
+    return Create(std::move(key), blob->code, blob->size, stage);
+  }
+
+  std::error_code error;
+  const auto write_time = std::filesystem::last_write_time(path, error);
+  const uintmax_t file_size = error ? 0 : std::filesystem::file_size(path, error);
+
+  // the file is unchanged since it was hashed, a live module for it needs no read at all
+  auto file = files_.find(path);
+  if (!error && file != files_.end() && file->second.writeTime == write_time && file->second.size == file_size) {
+    Handle handle = AddReference(std::format("{}#{:016x}", path, file->second.hash));
+    if (handle != kInvalidHandle) return handle;
+  }
+
+  std::vector<uint32_t> code;
+  size_t size = 0;
+  if (!ReadFile(path, &code, &size)) {
+    ERROR_LOG("could not read shader {}", path);
+    return kInvalidHandle;
+  }
+  const uint64_t hash = ShaderCodeHash(code.data(), size);
+  if (!error) {
+    files_[path] = {write_time, file_size, hash};
+  }
+
+  std::string key = std::format("{}#{:016x}", path, hash);
+  Handle handle = AddReference(key);
+  if (handle != kInvalidHandle) return handle;
+  return Create(std::move(key), code.data(), size, stage);
+}
+
+ShaderModuleCache::Handle ShaderModuleCache::Create(std::string key, const uint32_t *code, size_t size,
+                                                    VkShaderStageFlagBits stage) {
+  VkShaderModuleCreateInfo module_create_info{};
+  module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  module_create_info.codeSize = size;
+  module_create_info.pCode = code;
+  VkShaderModule module{VK_NULL_HANDLE};
+  VK_CHECK_RESULT(vkCreateShaderModule(device_, &module_create_info, nullptr, &module));
+
+  Handle handle;
+  if (!freeSlots_.empty()) {
+    handle = freeSlots_.back();
+    freeSlots_.pop_back();
+  } else {
+    handle = static_cast<Handle>(entries_.size());
+    entries_.emplace_back();
+  }
+  entries_[handle] = {key, module, stage, 1, size};
+  lookup_.emplace(std::move(key), handle);
+  stats_.modules++;
+  stats_.references++;
+  stats_.misses++;
+  stats_.codeBytes += size;
+  return handle;
+}
+
+void ShaderModuleCache::Release(Handle handle) {
+  if (handle == kInvalidHandle) return;
+  assert(handle < entries_.size() && entries_[handle].references > 0);
+  Entry &entry = entries_[handle];
+  stats_.references--;
+  if (--entry.references > 0) return;
+
+  if (onDestroy_) {
+    onDestroy_(entry.module);
+  }
+  vkDestroyShaderModule(device_, entry.module, nullptr);
+  lookup_.erase(entry.key);
+  stats_.modules--;
+  stats_.destroyed++;
+  stats_.codeBytes -= entry.codeSize;
+  entry = {};
+  freeSlots_.push_back(handle);
+}
+
+VkPipelineShaderStageCreateInfo ShaderModuleCache::StageInfo(Handle handle) const {
+  VkPipelineShaderStageCreateInfo stage_info{};
+  stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stage_info.stage = entries_[handle].stage;
+  stage_info.module = entries_[handle].module;
+  stage_info.pName = "main";
+  return stage_info;
+}
+
+}  // namespace lvk
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "shader_archive.h"
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+struct ShaderModuleCacheStats {
+  // modules alive and the Acquire() calls not released yet
+  uint32_t modules{0};
+  uint32_t references{0};
+  uint32_t hits{0};
+  uint32_t misses{0};
+  // misses created straight from the mapped archive, the others read a loose .spv file
+  uint32_t archived{0};
+  // modules destroyed because their last reference was released
+  uint32_t destroyed{0};
+  // spir-v size of the live modules
+  uint64_t codeBytes{0};
+};
+
+// 按 路径 + spv 内容 hash 共享 VkShaderModule, 引用计数归零时销毁.
+// 文件的修改时间和大小没变时直接用上次的 hash, 不再读文件; 变了就重新读, 内容不同会得到新的 module.
+// 有 shader archive 时先在里面找, hash 是打包时算好的, pCode 直接指向映射的内存; 找不到再读散的 .spv 文件.
+class ShaderModuleCache {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+  // archive may be null, it has to stay open until Destroy()
+  void Init(VkDevice device, const ShaderArchive *archive = nullptr);
+  // destroys every module, referenced or not
+  void Destroy();
+
+  // one reference per call, pair it with Release(). kInvalidHandle when the file cannot be read.
+  // stage is recorded when the module is created
+  Handle Acquire(const std::string &path, VkShaderStageFlagBits stage);
+  void Release(Handle handle);
+
+  VkShaderModule module(Handle handle) const { return entries_[handle].module; }
+  VkPipelineShaderStageCreateInfo StageInfo(Handle handle) const;
+  const ShaderModuleCacheStats &stats() const { return stats_; }
+
+  // called right before a module is destroyed, e.g. to forget pipelines keyed on its handle,
+  // the driver may hand the same value out again for other code
+  void SetDestroyCallback(std::function<void(VkShaderModule)> callback) { onDestroy_ = std::move(callback); }
+
+ private:
+  struct Entry {
+    std::string key;
+    VkShaderModule module{VK_NULL_HANDLE};
+    VkShaderStageFlagBits stage{VK_SHADER_STAGE_VERTEX_BIT};
+    uint32_t references{0};
+    size_t codeSize{0};
+  };
+  // what the file looked like when it was last hashed
+  struct FileState {
+    std::filesystem::file_time_type writeTime;
+    uintmax_t size{0};
+    uint64_t hash{0};
+  };
+
+  static bool ReadFile(const std::string &path, std::vector<uint32_t> *code, size_t *size);
+  // a new reference to the live module of key, kInvalidHandle when there is none
+  Handle AddReference(const std::string &key);
+  Handle Create(std::string key, const uint32_t *code, size_t size, VkShaderStageFlagBits stage);
+
+  VkDevice device_{VK_NULL_HANDLE};
+  const ShaderArchive *archive_{nullptr};
+  std::vector<Entry> entries_;
+  // slots of destroyed modules, reused before entries_ grows
+  std::vector<Handle> freeSlots_;
+  // path + '#' + content hash -> handle
+  std::unordered_map<std::string, Handle> lookup_;
+  std::unordered_map<std::string, FileState> files_;
+  std::function<void(VkShaderModule)> onDestroy_;
+  ShaderModuleCacheStats stats_;
+};
+
+}  // namespace lvk
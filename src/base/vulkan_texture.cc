@@ -1,15 +1,19 @@
 #include "vulkan_texture.h"
 
+#include "lvk_log.h"
+#include "lvk_trace.h"
 #include "vulkan_device.h"
 #include "vulkan_initializers.h"
 #include "vulkan_tools.h"
+#include "vulkan_upload_batch.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 namespace lvk {
 
-void VulkanTexture::LoadTexture() {
+bool VulkanTexture::LoadTexture(VulkanUploadBatch *upload) {
+  LVK_TRACE_FUNCTION();
 #if 0
   // We use the Khronos texture format
   // (https://www.khronos.org/opengles/sdk/tools/KTX/file_format_spec/)
@@ -23,6 +27,18 @@ void VulkanTexture::LoadTexture() {
 #endif
   int texWidth, texHeight, texChannels;
   stbi_uc *pixels = stbi_load(path_.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+  if (!pixels) {
+    ERROR_LOG("could not decode texture {}: {}", path_, stbi_failure_reason());
+    return false;
+  }
+  LoadPixels(pixels, texWidth, texHeight, upload);
+  // staging holds its own copy of the pixels
+  stbi_image_free(pixels);
+  return true;
+}
+
+void VulkanTexture::LoadPixels(const uint8_t *pixels, uint32_t texWidth, uint32_t texHeight,
+                               VulkanUploadBatch *upload) {
   VkDeviceSize imageSize = texWidth * texHeight * 4;
 
 #if defined(__ANDROID__)
@@ -53,43 +69,11 @@ void VulkanTexture::LoadTexture() {
     useStaging = !(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
   }
 
-  VkMemoryAllocateInfo memAllocInfo = initializers::MemoryAllocateInfo();
-  VkMemoryRequirements memReqs = {};
-
   if (useStaging) {
     // Copy data to an optimal tiled image
     // This loads the texture data into a host local buffer that is copied to
     // the optimal tiled image on the device
 
-    // Create a host-visible staging buffer that contains the raw image data
-    // This buffer will be the data source for copying texture data to the
-    // optimal tiled image on the device
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-
-    VkBufferCreateInfo bufferCreateInfo = initializers::BufferCreateInfo();
-    bufferCreateInfo.size = imageSize;
-    // This buffer is used as a transfer source for the buffer copy
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    VK_CHECK_RESULT(vkCreateBuffer(device_->device(), &bufferCreateInfo, nullptr, &stagingBuffer));
-
-    // Get memory requirements for the staging buffer (alignment, memory type
-    // bits)
-    vkGetBufferMemoryRequirements(device_->device(), stagingBuffer, &memReqs);
-    memAllocInfo.allocationSize = memReqs.size;
-    // Get memory type index for a host visible buffer
-    memAllocInfo.memoryTypeIndex = device_->GetMemoryType(
-        memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(device_->device(), &memAllocInfo, nullptr, &stagingMemory));
-    VK_CHECK_RESULT(vkBindBufferMemory(device_->device(), stagingBuffer, stagingMemory, 0));
-
-    // Copy texture data into host local staging buffer
-    uint8_t *data;
-    VK_CHECK_RESULT(vkMapMemory(device_->device(), stagingMemory, 0, memReqs.size, 0, (void **)&data));
-    memcpy(data, pixels, imageSize);
-    vkUnmapMemory(device_->device(), stagingMemory);
-
     // Setup buffer copy regions for each mip level
     std::vector<VkBufferImageCopy> bufferCopyRegions;
     uint32_t offset = 0;
@@ -124,18 +108,10 @@ void VulkanTexture::LoadTexture() {
     imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     VK_CHECK_RESULT(vkCreateImage(device_->device(), &imageCreateInfo, nullptr, &image_));
 
-    vkGetImageMemoryRequirements(device_->device(), image_, &memReqs);
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = device_->GetMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(device_->device(), &memAllocInfo, nullptr, &deviceMemory_));
-    VK_CHECK_RESULT(vkBindImageMemory(device_->device(), image_, deviceMemory_, 0));
-
-    VkCommandBuffer copyCmd = device_->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-    // Image memory barriers for the texture image
+    VK_CHECK_RESULT(device_->allocator()->AllocateForImage(image_, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation_));
 
     // The sub resource range describes the regions of the image that will be
-    // transitioned using the memory barriers below
+    // transitioned using the memory barriers of the upload
     VkImageSubresourceRange subresourceRange = {};
     // Image only contains color data
     subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -146,50 +122,17 @@ void VulkanTexture::LoadTexture() {
     // The 2D texture only has one layer
     subresourceRange.layerCount = 1;
 
-    // Transition the texture image layout to transfer target, so we can safely
-    // copy our buffer data to it.
-    VkImageMemoryBarrier imageMemoryBarrier = initializers::ImageMemoryBarrier();
-    ;
-    imageMemoryBarrier.image = image_;
-    imageMemoryBarrier.subresourceRange = subresourceRange;
-    imageMemoryBarrier.srcAccessMask = 0;
-    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-    // Insert a memory dependency at the proper pipeline stages that will
-    // execute the image layout transition Source pipeline stage is host
-    // write/read execution (VK_PIPELINE_STAGE_HOST_BIT) Destination pipeline
-    // stage is copy command execution (VK_PIPELINE_STAGE_TRANSFER_BIT)
-    vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
-                         1, &imageMemoryBarrier);
-
-    // Copy mip levels from staging buffer
-    vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-
-    // Once the data has been uploaded we transfer to the texture image to the
-    // shader read layout, so it can be sampled from
-    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    // Insert a memory dependency at the proper pipeline stages that will
-    // execute the image layout transition Source pipeline stage is copy command
-    // execution (VK_PIPELINE_STAGE_TRANSFER_BIT) Destination pipeline stage
-    // fragment shader access (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
-    vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                         0, nullptr, 1, &imageMemoryBarrier);
+    // The pixels go through the batch's staging memory, the image ends up in
+    // the shader read layout once the batch is submitted
+    if (upload) {
+      upload->CopyToImage(image_, subresourceRange, pixels, imageSize, bufferCopyRegions);
+    } else {
+      VulkanUploadBatch batch(device_, queue_);
+      batch.CopyToImage(image_, subresourceRange, pixels, imageSize, bufferCopyRegions);
+    }
 
     // Store current layout for later reuse
     imageLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    device_->FlushCommandBuffer(copyCmd, queue_, true);
-
-    // Clean up staging resources
-    vkFreeMemory(device_->device(), stagingMemory, nullptr);
-    vkDestroyBuffer(device_->device(), stagingBuffer, nullptr);
   } else {
   }
 
@@ -199,12 +142,13 @@ void VulkanTexture::LoadTexture() {
   // means you could have multiple sampler objects for the same texture with
   // different settings Note: Similar to the samplers available with OpenGL 3.3
   VkSamplerCreateInfo sampler = initializers::SamplerCreateInfo();
-  sampler.magFilter = VK_FILTER_LINEAR;
-  sampler.minFilter = VK_FILTER_LINEAR;
-  sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-  sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sampler.magFilter = settings_.filter;
+  sampler.minFilter = settings_.filter;
+  sampler.mipmapMode =
+      settings_.filter == VK_FILTER_NEAREST ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  sampler.addressModeU = settings_.addressMode;
+  sampler.addressModeV = settings_.addressMode;
+  sampler.addressModeW = settings_.addressMode;
   sampler.mipLodBias = 0.0f;
   sampler.compareOp = VK_COMPARE_OP_NEVER;
   sampler.minLod = 0.0f;
@@ -260,10 +204,22 @@ VkDescriptorImageInfo VulkanTexture::GetDescriptorImageInfo() {
   return textureDescriptor;
 }
 
-void VulkanTexture::LoadTexture(VulkanDevice *device, const std::string &path, VkQueue queue) {
+void VulkanTexture::Destroy() {
+  if (sampler_ != VK_NULL_HANDLE) vkDestroySampler(device_->device(), sampler_, nullptr);
+  if (view_ != VK_NULL_HANDLE) vkDestroyImageView(device_->device(), view_, nullptr);
+  if (image_ != VK_NULL_HANDLE) {
+    vkDestroyImage(device_->device(), image_, nullptr);
+    device_->allocator()->Free(allocation_);
+  }
+  sampler_ = VK_NULL_HANDLE;
+  view_ = VK_NULL_HANDLE;
+  image_ = VK_NULL_HANDLE;
+}
+
+bool VulkanTexture::LoadTexture(VulkanDevice *device, const std::string &path, VkQueue queue) {
   device_ = device;
   path_ = path;
   queue_ = queue;
-  LoadTexture();
+  return LoadTexture();
 }
 }  // namespace lvk
\ No newline at end of file
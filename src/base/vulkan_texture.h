@@ -3,21 +3,41 @@
 #include <string>
 
 #include "vulkan/vulkan.h"
+#include "vulkan_memory_allocator.h"
 
 namespace lvk {
 
 class VulkanDevice;
+class VulkanUploadBatch;
+
+// how a file is turned into an image and sampler, part of the texture cache key
+struct TextureImportSettings {
+  VkFormat format{VK_FORMAT_R8G8B8A8_UNORM};
+  VkFilter filter{VK_FILTER_LINEAR};
+  VkSamplerAddressMode addressMode{VK_SAMPLER_ADDRESS_MODE_REPEAT};
+
+  bool operator==(const TextureImportSettings &) const = default;
+};
 
 class VulkanTexture {
  public:
-  VulkanTexture(VulkanDevice *device, const std::string &path, VkQueue queue)
-      : device_(device), path_(path), queue_(queue){};
+  VulkanTexture(VulkanDevice *device, const std::string &path, VkQueue queue,
+                const TextureImportSettings &settings = {})
+      : device_(device), path_(path), format_(settings.format), settings_(settings), queue_(queue){};
   VulkanTexture() {}
   ~VulkanTexture(){};
 
-  void LoadTexture();
-  void LoadTexture(VulkanDevice *device, const std::string &path, VkQueue queue);
+  // records the upload into the batch when one is given, otherwise submits it right away.
+  // false when the file cannot be decoded, nothing is created then
+  bool LoadTexture(VulkanUploadBatch *upload = nullptr);
+  bool LoadTexture(VulkanDevice *device, const std::string &path, VkQueue queue);
+  // same as LoadTexture() with rgba8 pixels from memory, path is only used as a name
+  void LoadPixels(const uint8_t *pixels, uint32_t width, uint32_t height, VulkanUploadBatch *upload = nullptr);
   VkDescriptorImageInfo GetDescriptorImageInfo();
+  // frees the image, view and sampler, the gpu must be done with them
+  void Destroy();
+  // memory reserved for the image, 0 before LoadTexture()
+  VkDeviceSize gpuBytes() const { return allocation_.size; }
 
  private:
   VulkanDevice *device_{nullptr};
@@ -25,11 +45,12 @@ class VulkanTexture {
   uint32_t width_, height_;
   uint32_t mipLevels_;
   VkFormat format_{VK_FORMAT_R8G8B8A8_UNORM};
-  VkImage image_;
-  VkDeviceMemory deviceMemory_;
-  VkImageView view_;
+  TextureImportSettings settings_;
+  VkImage image_{VK_NULL_HANDLE};
+  VulkanAllocation allocation_;
+  VkImageView view_{VK_NULL_HANDLE};
   VkImageLayout imageLayout_;
-  VkSampler sampler_;
+  VkSampler sampler_{VK_NULL_HANDLE};
   // todo: remove
   VkQueue queue_{VK_NULL_HANDLE};
 };
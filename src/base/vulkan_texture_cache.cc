@@ -0,0 +1,94 @@
+#include "vulkan_texture_cache.h"
+
+#include <assert.h>
+
+#include <filesystem>
+#include <format>
+#include <system_error>
+#include <utility>
+
+#include "lvk_log.h"
+
+namespace lvk {
+
+void VulkanTextureCache::Init(VulkanDevice *device, VkQueue queue) {
+  device_ = device;
+  queue_ = queue;
+}
+
+void VulkanTextureCache::Destroy() {
+  for (Entry &entry : entries_) {
+    if (!entry.texture) continue;
+    entry.texture->Destroy();
+  }
+  entries_.clear();
+  freeSlots_.clear();
+  lookup_.clear();
+  stats_.textures = stats_.references = 0;
+  stats_.gpuBytes = 0;
+}
+
+std::string VulkanTextureCache::MakeKey(const std::string &path, const TextureImportSettings &settings) {
+  // "a/../b.png", "./b.png" and "b.png" are the same file
+  std::error_code error;
+  std::filesystem::path resolved = std::filesystem::weakly_canonical(path, error);
+  if (error) {
+    resolved = std::filesystem::absolute(path, error).lexically_normal();
+  }
+  return std::format("{}#{}:{}:{}", resolved.generic_string(), static_cast<int>(settings.format),
+                     static_cast<int>(settings.filter), static_cast<int>(settings.addressMode));
+}
+
+VulkanTextureCache::Handle VulkanTextureCache::Acquire(const std::string &path, const TextureImportSettings &settings,
+                                                       VulkanUploadBatch *upload) {
+  std::string key = MakeKey(path, settings);
+  auto iter = lookup_.find(key);
+  if (iter != lookup_.end()) {
+    entries_[iter->second].references++;
+    stats_.references++;
+    stats_.hits++;
+    return iter->second;
+  }
+
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(path, error)) {
+    ERROR_LOG("could not read texture {}", path);
+    return kInvalidHandle;
+  }
+  auto texture = std::make_unique<VulkanTexture>(device_, path, queue_, settings);
+  if (!texture->LoadTexture(upload)) return kInvalidHandle;
+
+  Handle handle;
+  if (!freeSlots_.empty()) {
+    handle = freeSlots_.back();
+    freeSlots_.pop_back();
+  } else {
+    handle = static_cast<Handle>(entries_.size());
+    entries_.emplace_back();
+  }
+  stats_.textures++;
+  stats_.references++;
+  stats_.misses++;
+  stats_.gpuBytes += texture->gpuBytes();
+  entries_[handle] = {key, std::move(texture), 1};
+  lookup_.emplace(std::move(key), handle);
+  return handle;
+}
+
+void VulkanTextureCache::Release(Handle handle) {
+  if (handle == kInvalidHandle) return;
+  assert(handle < entries_.size() && entries_[handle].references > 0);
+  Entry &entry = entries_[handle];
+  stats_.references--;
+  if (--entry.references > 0) return;
+
+  stats_.gpuBytes -= entry.texture->gpuBytes();
+  entry.texture->Destroy();
+  lookup_.erase(entry.key);
+  stats_.textures--;
+  stats_.destroyed++;
+  entry = {};
+  freeSlots_.push_back(handle);
+}
+
+}  // namespace lvk
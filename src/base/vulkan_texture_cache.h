@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+#include "vulkan_texture.h"
+
+namespace lvk {
+
+class VulkanDevice;
+class VulkanUploadBatch;
+
+struct TextureCacheStats {
+  // textures alive and the Acquire() calls not released yet
+  uint32_t textures{0};
+  uint32_t references{0};
+  uint32_t hits{0};
+  uint32_t misses{0};
+  // textures destroyed because their last reference was released
+  uint32_t destroyed{0};
+  // image memory of the live textures
+  uint64_t gpuBytes{0};
+};
+
+// 按 规范化后的路径 + 导入设置 共享 VulkanTexture, 同一个文件只解码, 上传一次, 只建一个 sampler.
+// 引用计数归零时销毁 image/view/sampler. 返回的 VulkanTexture 指针在 Release() 前一直有效.
+class VulkanTextureCache {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+  void Init(VulkanDevice *device, VkQueue queue);
+  // destroys every texture, referenced or not
+  void Destroy();
+
+  // one reference per call, pair it with Release(). kInvalidHandle when the file is missing or cannot be decoded.
+  // a miss records its upload into the batch when one is given
+  Handle Acquire(const std::string &path, const TextureImportSettings &settings, VulkanUploadBatch *upload = nullptr);
+  // the gpu must be done with the texture in case this was the last reference
+  void Release(Handle handle);
+
+  VulkanTexture *texture(Handle handle) const { return entries_[handle].texture.get(); }
+  const TextureCacheStats &stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::unique_ptr<VulkanTexture> texture;
+    uint32_t references{0};
+  };
+
+  static std::string MakeKey(const std::string &path, const TextureImportSettings &settings);
+
+  VulkanDevice *device_{nullptr};
+  VkQueue queue_{VK_NULL_HANDLE};
+  std::vector<Entry> entries_;
+  // slots of destroyed textures, reused before entries_ grows
+  std::vector<Handle> freeSlots_;
+  // resolved path + '#' + settings -> handle
+  std::unordered_map<std::string, Handle> lookup_;
+  TextureCacheStats stats_;
+};
+
+}  // namespace lvk
@@ -1,6 +1,7 @@
 #include "vulkan_ui.h"
 
 #include "imgui.h"
+#include "thread_pool.h"
 #include "vulkan_buffer.h"
 #include "vulkan_device.h"
 #include "vulkan_initializers.h"
@@ -188,7 +189,7 @@ void VulkanUI::PrepareResources() {
 
 /** Prepare a separate pipeline for the UI overlay rendering decoupled from the main application */
 void VulkanUI::PreparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass,
-                               const VkFormat colorFormat, const VkFormat depthFormat) {
+                               const VkFormat colorFormat, const VkFormat depthFormat, ThreadPool* pool) {
   // Pipeline layout
   // Push constants for UI rendering parameters
   VkPushConstantRange pushConstantRange =
@@ -199,6 +200,17 @@ void VulkanUI::PreparePipeline(const VkPipelineCache pipelineCache, const VkRend
   pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
   VK_CHECK_RESULT(vkCreatePipelineLayout(device->device(), &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
+  if (pool) {
+    pipelineBuild = pool->Async([this, pipelineCache, renderPass, colorFormat, depthFormat] {
+      return CreatePipeline(pipelineCache, renderPass, colorFormat, depthFormat);
+    });
+  } else {
+    pipeline = CreatePipeline(pipelineCache, renderPass, colorFormat, depthFormat);
+  }
+}
+
+VkPipeline VulkanUI::CreatePipeline(VkPipelineCache pipelineCache, VkRenderPass renderPass, VkFormat colorFormat,
+                                    VkFormat depthFormat) {
   // Setup graphics pipeline for UI rendering
   VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
       lvk::initializers::PipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
@@ -280,12 +292,14 @@ void VulkanUI::PreparePipeline(const VkPipelineCache pipelineCache, const VkRend
 
   pipelineCreateInfo.pVertexInputState = &vertexInputState;
 
+  VkPipeline ui_pipeline{VK_NULL_HANDLE};
   VK_CHECK_RESULT(
-      vkCreateGraphicsPipelines(device->device(), pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+      vkCreateGraphicsPipelines(device->device(), pipelineCache, 1, &pipelineCreateInfo, nullptr, &ui_pipeline));
+  return ui_pipeline;
 }
 
 /** Update vertex and index buffer containing the imGui elements when required */
-bool VulkanUI::Update() {
+bool VulkanUI::Update(uint32_t frame) {
   ImDrawData* imDrawData = ImGui::GetDrawData();
   bool updateCmdBuffers = false;
 
@@ -302,9 +316,18 @@ bool VulkanUI::Update() {
     return false;
   }
 
+  // the fence of frame has been waited on, its buffers can be rewritten or replaced without a device wait
+  if (frame >= frameBuffers.size()) {
+    frameBuffers.resize(frame + 1);
+  }
+  VulkanBuffer*& vertexBuffer = frameBuffers[frame].vertexBuffer;
+  VulkanBuffer*& indexBuffer = frameBuffers[frame].indexBuffer;
+  int32_t& vertexCount = frameBuffers[frame].vertexCount;
+  int32_t& indexCount = frameBuffers[frame].indexCount;
+
   // Vertex buffer
   if (vertexBuffer == nullptr || (vertexBuffer->buffer() == VK_NULL_HANDLE) ||
-      (vertexCount != imDrawData->TotalVtxCount)) {
+      (vertexCount < imDrawData->TotalVtxCount)) {
     if (vertexBuffer != nullptr) {
       vertexBuffer->Unmap();
       vertexBuffer->Destroy();
@@ -348,17 +371,22 @@ bool VulkanUI::Update() {
   return updateCmdBuffers;
 }
 
-void VulkanUI::draw(const VkCommandBuffer commandBuffer) {
+void VulkanUI::draw(const VkCommandBuffer commandBuffer, uint32_t frame) {
   ImDrawData* imDrawData = ImGui::GetDrawData();
   int32_t vertexOffset = 0;
   int32_t indexOffset = 0;
 
-  if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+  if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || frame >= frameBuffers.size() ||
+      !frameBuffers[frame].vertexBuffer) {
     return;
   }
+  const FrameBuffers& buffers = frameBuffers[frame];
 
   ImGuiIO& io = ImGui::GetIO();
 
+  if (pipelineBuild.valid()) {
+    pipeline = pipelineBuild.get();
+  }
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
   vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0,
                           NULL);
@@ -369,8 +397,8 @@ void VulkanUI::draw(const VkCommandBuffer commandBuffer) {
                      &pushConstBlock);
 
   VkDeviceSize offsets[1] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer->bufferp(), offsets);
-  vkCmdBindIndexBuffer(commandBuffer, indexBuffer->buffer(), 0, VK_INDEX_TYPE_UINT16);
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers.vertexBuffer->bufferp(), offsets);
+  vkCmdBindIndexBuffer(commandBuffer, buffers.indexBuffer->buffer(), 0, VK_INDEX_TYPE_UINT16);
 
   for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
     const ImDrawList* cmd_list = imDrawData->CmdLists[i];
@@ -395,14 +423,20 @@ void VulkanUI::resize(uint32_t width, uint32_t height) {
 }
 
 void VulkanUI::freeResources() {
-  vertexBuffer->Destroy();
-  indexBuffer->Destroy();
+  for (auto& buffers : frameBuffers) {
+    if (buffers.vertexBuffer) buffers.vertexBuffer->Destroy();
+    if (buffers.indexBuffer) buffers.indexBuffer->Destroy();
+  }
+  frameBuffers.clear();
   vkDestroyImageView(device->device(), fontView, nullptr);
   vkDestroyImage(device->device(), fontImage, nullptr);
   vkFreeMemory(device->device(), fontMemory, nullptr);
   vkDestroySampler(device->device(), sampler, nullptr);
   vkDestroyDescriptorSetLayout(device->device(), descriptorSetLayout, nullptr);
   vkDestroyDescriptorPool(device->device(), descriptorPool, nullptr);
+  if (pipelineBuild.valid()) {
+    pipeline = pipelineBuild.get();
+  }
   vkDestroyPipelineLayout(device->device(), pipelineLayout, nullptr);
   vkDestroyPipeline(device->device(), pipeline, nullptr);
 }
@@ -500,6 +534,8 @@ void VulkanUI::text(const char* formatstr, ...) {
 }
 
 void VulkanUIRenderWrapper::Prepare(VulkanDevice* device, VulkanContext* context) {
+  context_ = context;
+  profiler_ = context->GetGpuProfiler();
   // ui
   if (1) {
     ui_->device = device;
@@ -510,17 +546,21 @@ void VulkanUIRenderWrapper::Prepare(VulkanDevice* device, VulkanContext* context
     };
     ui_->PrepareResources();
     ui_->PreparePipeline(context->GetPipelineCache(), context->GetBasePassVkHandle(), context->GetColorFormat(),
-                         context->GetDepthFormat());
+                         context->GetDepthFormat(), context->GetPipelinePool());
   }
   // ui end
 }
 
 void VulkanUIRenderWrapper::BuildCommandBuffers(Scene* scene, VkCommandBuffer command_buffer) {
+  GpuProfileScope scope(profiler_, command_buffer, "ImGui");
   const VkViewport viewport = lvk::initializers::Viewport(width_, height_, 0.0f, 1.0f);
   const VkRect2D scissor = lvk::initializers::Rect2D(width_, height_, 0, 0);
   vkCmdSetViewport(command_buffer, 0, 1, &viewport);
   vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-  ui_->draw(command_buffer);
+  // recorded after the fence wait of the frame, its buffers are free to take the draw data of the last overlay update
+  const uint32_t frame = context_->GetCurrentFrame();
+  ui_->Update(frame);
+  ui_->draw(command_buffer, frame);
 }
 
 }  // namespace lvk
\ No newline at end of file
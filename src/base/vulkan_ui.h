@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vulkan/vulkan.h"
+#include <future>
 #include <vector>
 #include "lvk_math.h"
 #include "vulkan_context.h"
@@ -9,6 +10,7 @@ namespace lvk {
 
 class VulkanDevice;
 class VulkanBuffer;
+class ThreadPool;
 
 class VulkanUI {
  public:
@@ -18,10 +20,14 @@ class VulkanUI {
   VkSampleCountFlagBits rasterizationSamples{VK_SAMPLE_COUNT_1_BIT};
   uint32_t subpass{0};
 
-  VulkanBuffer* vertexBuffer{nullptr};
-  VulkanBuffer* indexBuffer{nullptr};
-  int32_t vertexCount{0};
-  int32_t indexCount{0};
+  // one vertex and index buffer per frame in flight, a frame only writes its own after its fence wait
+  struct FrameBuffers {
+    VulkanBuffer* vertexBuffer{nullptr};
+    VulkanBuffer* indexBuffer{nullptr};
+    int32_t vertexCount{0};
+    int32_t indexCount{0};
+  };
+  std::vector<FrameBuffers> frameBuffers;
 
   std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -30,6 +36,8 @@ class VulkanUI {
   VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
   VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
   VkPipeline pipeline{VK_NULL_HANDLE};
+  // set when the pipeline is compiled on a thread pool, draw() waits for it the first time
+  std::future<VkPipeline> pipelineBuild;
 
   VkDeviceMemory fontMemory{VK_NULL_HANDLE};
   VkImage fontImage{VK_NULL_HANDLE};
@@ -49,16 +57,24 @@ class VulkanUI {
   VulkanUI();
   ~VulkanUI();
 
+  // with a pool the pipeline is compiled there and the call returns right away
   void PreparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat,
-                       const VkFormat depthFormat);
+                       const VkFormat depthFormat, ThreadPool* pool = nullptr);
   void PrepareResources();
 
-  bool Update();
-  void draw(const VkCommandBuffer commandBuffer);
+  // copies the current draw data into the buffers of frame, the gpu must be done with that frame
+  bool Update(uint32_t frame);
+  void draw(const VkCommandBuffer commandBuffer, uint32_t frame);
   void resize(uint32_t width, uint32_t height);
 
   void freeResources();
 
+ private:
+  VkPipeline CreatePipeline(VkPipelineCache pipelineCache, VkRenderPass renderPass, VkFormat colorFormat,
+                            VkFormat depthFormat);
+
+ public:
+
   bool header(const char* caption);
   bool checkBox(const char* caption, bool* value);
   bool checkBox(const char* caption, int32_t* value);
@@ -81,6 +97,8 @@ class VulkanUIRenderWrapper : public RenderComponent {
 
   protected:
     VulkanUI *ui_{nullptr};
+    VulkanContext *context_{nullptr};
+    VulkanGpuProfiler *profiler_{nullptr};
     float width_{0.0};
     float height_{0.0};
 };
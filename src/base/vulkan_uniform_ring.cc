@@ -0,0 +1,68 @@
+#include "vulkan_uniform_ring.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include "lvk_log.h"
+#include "vulkan_buffer.h"
+#include "vulkan_device.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+void VulkanUniformRing::Init(VulkanDevice *device) {
+  device_ = device;
+  // the ring also backs storage buffers, offsets have to satisfy both limits
+  const auto &limits = device->properties().limits;
+  alignment_ = std::max<VkDeviceSize>(
+      {limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, 16});
+}
+
+void VulkanUniformRing::Create(VkDeviceSize frameSize, uint32_t frameCount) {
+  assert(device_);
+  // called again for a rebuilt scene, the gpu is idle by then
+  Destroy();
+  frameSize_ = Align(frameSize);
+  frameCount_ = frameCount;
+  frameIndex_ = 0;
+  cursor_ = 0;
+
+  // host coherent, so writes need no flush and the buffer stays mapped for its whole life
+  const VkBufferUsageFlags usage =
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  buffer_ = VulkanBuffer::Create(device_, usage,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 frameSize_ * frameCount_);
+  VK_CHECK_RESULT(buffer_->Map());
+  mapped_ = reinterpret_cast<uint8_t *>(buffer_->mapped());
+
+  DEBUG_LOG("uniform ring: {} frames x {} bytes, alignment {}", frameCount_, frameSize_, alignment_);
+}
+
+void VulkanUniformRing::Destroy() {
+  if (buffer_) {
+    buffer_->Unmap();
+    // VulkanBuffer::Destroy deletes the object
+    buffer_->Destroy();
+    buffer_ = nullptr;
+    mapped_ = nullptr;
+  }
+}
+
+void VulkanUniformRing::BeginFrame(uint32_t frameIndex) {
+  frameIndex_ = frameIndex % frameCount_;
+  cursor_ = 0;
+}
+
+VkDeviceSize VulkanUniformRing::Allocate(VkDeviceSize size) {
+  VkDeviceSize offset = cursor_;
+  cursor_ += Align(size);
+  if (cursor_ > frameSize_) {
+    ERROR_LOG("uniform ring overflow: {} > {}", cursor_, frameSize_);
+    assert(false);
+  }
+  return frameIndex_ * frameSize_ + offset;
+}
+
+}  // namespace lvk
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class VulkanDevice;
+class VulkanBuffer;
+
+// 常驻 map 的 uniform buffer, 按 frames in flight 切成若干段.
+// 每帧只写自己的那一段, 着色器通过 dynamic offset 读到当前帧的数据,
+// 所以 CPU 写入时不会和 GPU 还在读的帧冲突.
+// 除了 uniform 之外, 每帧的 instance / draw 数据 (storage buffer) 和 indirect 命令也放在这里.
+class VulkanUniformRing {
+ public:
+  // query the offset alignment of the device, Align() is valid after this
+  void Init(VulkanDevice *device);
+  void Create(VkDeviceSize frameSize, uint32_t frameCount);
+  void Destroy();
+
+  // start writing the slice of frameIndex, resets the allocation cursor
+  void BeginFrame(uint32_t frameIndex);
+  // sub-allocate from the current frame slice, returns the offset from the start of the buffer
+  VkDeviceSize Allocate(VkDeviceSize size);
+  // cpu address of an offset returned by Allocate()
+  uint8_t *Data(VkDeviceSize offset) { return mapped_ + offset; }
+
+  // round up to the uniform / storage buffer offset alignment
+  VkDeviceSize Align(VkDeviceSize size) const { return (size + alignment_ - 1) & ~(alignment_ - 1); }
+
+  VulkanBuffer *buffer() { return buffer_; }
+  VkDeviceSize alignment() const { return alignment_; }
+  VkDeviceSize frameSize() const { return frameSize_; }
+  uint32_t frameCount() const { return frameCount_; }
+
+ private:
+  VulkanDevice *device_{nullptr};
+  VulkanBuffer *buffer_{nullptr};
+  uint8_t *mapped_{nullptr};
+  VkDeviceSize alignment_{256};
+  VkDeviceSize frameSize_{0};
+  uint32_t frameCount_{0};
+  uint32_t frameIndex_{0};
+  // relative to the start of the current frame slice
+  VkDeviceSize cursor_{0};
+};
+
+}  // namespace lvk
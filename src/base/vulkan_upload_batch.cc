@@ -0,0 +1,145 @@
+#include "vulkan_upload_batch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "lvk_log.h"
+#include "lvk_trace.h"
+#include "vulkan_buffer.h"
+#include "vulkan_device.h"
+#include "vulkan_initializers.h"
+#include "vulkan_tools.h"
+
+namespace lvk {
+
+namespace {
+
+// covers optimalBufferCopyOffsetAlignment and the texel size of every format we upload
+constexpr VkDeviceSize kStagingAlignment = 16;
+
+}  // namespace
+
+VulkanUploadBatch::VulkanUploadBatch(VulkanDevice *device, VkQueue queue) : device_(device), queue_(queue) {}
+
+VulkanUploadBatch::~VulkanUploadBatch() {
+  Submit();
+  for (auto &chunk : staging_) {
+    chunk.buffer->Unmap();
+    // VulkanBuffer::Destroy deletes the object
+    chunk.buffer->Destroy();
+  }
+}
+
+VkCommandBuffer VulkanUploadBatch::commandBuffer() {
+  if (cmdBuffer_ == VK_NULL_HANDLE) {
+    cmdBuffer_ = device_->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+  }
+  return cmdBuffer_;
+}
+
+VkBuffer VulkanUploadBatch::Stage(const void *data, VkDeviceSize size, VkDeviceSize *offset) {
+  if (pendingBytes_ + size > kMaxPendingBytes && pendingBytes_ > 0) {
+    Submit();
+  }
+
+  StagingChunk *chunk = nullptr;
+  for (auto &c : staging_) {
+    VkDeviceSize aligned = (c.used + kStagingAlignment - 1) & ~(kStagingAlignment - 1);
+    if (aligned + size <= c.size) {
+      c.used = aligned;
+      chunk = &c;
+      break;
+    }
+  }
+  if (!chunk) {
+    StagingChunk c;
+    c.size = std::max(kStagingChunkSize, size);
+    c.buffer = VulkanBuffer::Create(device_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, c.size);
+    VK_CHECK_RESULT(c.buffer->Map());
+    staging_.push_back(c);
+    chunk = &staging_.back();
+  }
+
+  *offset = chunk->used;
+  memcpy(reinterpret_cast<uint8_t *>(chunk->buffer->mapped()) + chunk->used, data, size);
+  chunk->used += size;
+  pendingBytes_ += size;
+  uploadedBytes_ += size;
+  return chunk->buffer->buffer();
+}
+
+void VulkanUploadBatch::CopyToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+  if (size == 0) return;
+
+  VkBufferCopy region{};
+  VkBuffer src = Stage(data, size, &region.srcOffset);
+  region.dstOffset = dstOffset;
+  region.size = size;
+  vkCmdCopyBuffer(commandBuffer(), src, dst, 1, &region);
+}
+
+void VulkanUploadBatch::CopyToImage(VkImage image, const VkImageSubresourceRange &range, const void *data,
+                                    VkDeviceSize size, const std::vector<VkBufferImageCopy> &regions,
+                                    VkImageLayout finalLayout) {
+  VkDeviceSize staging_offset = 0;
+  VkBuffer src = Stage(data, size, &staging_offset);
+  VkCommandBuffer cmd = commandBuffer();
+
+  VkImageMemoryBarrier barrier = initializers::ImageMemoryBarrier();
+  barrier.image = image;
+  barrier.subresourceRange = range;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  std::vector<VkBufferImageCopy> staged_regions(regions);
+  for (auto &region : staged_regions) {
+    region.bufferOffset += staging_offset;
+  }
+  vkCmdCopyBufferToImage(cmd, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(staged_regions.size()), staged_regions.data());
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = finalLayout;
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+void VulkanUploadBatch::DeferDestroy(VulkanBuffer *buffer) { deferred_.push_back(buffer); }
+
+void VulkanUploadBatch::Submit() {
+  if (cmdBuffer_ == VK_NULL_HANDLE) return;
+  LVK_TRACE_FUNCTION();
+
+  // the copies feed vertex fetch, index fetch and shader reads of the frames that follow
+  VkMemoryBarrier barrier = initializers::MemoryBarrierInfo();
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  // waits on a fence, the staging memory is free to reuse afterwards
+  device_->FlushCommandBuffer(cmdBuffer_, queue_, true);
+  cmdBuffer_ = VK_NULL_HANDLE;
+  submitCount_++;
+  DEBUG_LOG("upload batch: submitted {:.2f} MB", pendingBytes_ / (1024.0 * 1024.0));
+
+  for (auto *buffer : deferred_) {
+    buffer->Destroy();
+  }
+  deferred_.clear();
+  for (auto &chunk : staging_) {
+    chunk.used = 0;
+  }
+  pendingBytes_ = 0;
+}
+
+}  // namespace lvk
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace lvk {
+
+class VulkanDevice;
+class VulkanBuffer;
+
+// 把多次上传合并到一个 command buffer 里提交.
+// 数据先拷到常驻 map 的 staging buffer, copy 命令记录到同一个 command buffer,
+// Submit() 时一次提交并等待完成, 然后释放 staging.
+// staging 超过 kMaxPendingBytes 时提前提交一次, 避免加载大场景时 staging 和场景一样大.
+class VulkanUploadBatch {
+ public:
+  VulkanUploadBatch(VulkanDevice *device, VkQueue queue);
+  // submits whatever is still pending
+  ~VulkanUploadBatch();
+
+  VulkanUploadBatch(const VulkanUploadBatch &) = delete;
+  VulkanUploadBatch &operator=(const VulkanUploadBatch &) = delete;
+
+  void CopyToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+  // bufferOffset of the regions is relative to data. the image is moved from UNDEFINED to
+  // TRANSFER_DST for the copy and left in finalLayout
+  void CopyToImage(VkImage image, const VkImageSubresourceRange &range, const void *data, VkDeviceSize size,
+                   const std::vector<VkBufferImageCopy> &regions,
+                   VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  // for commands recorded in order with the copies, e.g. moving a buffer that is being grown
+  VkCommandBuffer commandBuffer();
+  // destroyed once the pending commands have completed
+  void DeferDestroy(VulkanBuffer *buffer);
+
+  void Submit();
+
+  uint32_t submitCount() const { return submitCount_; }
+  VkDeviceSize uploadedBytes() const { return uploadedBytes_; }
+
+  static constexpr VkDeviceSize kStagingChunkSize = 16ull * 1024 * 1024;
+  static constexpr VkDeviceSize kMaxPendingBytes = 256ull * 1024 * 1024;
+
+ private:
+  struct StagingChunk {
+    VulkanBuffer *buffer{nullptr};
+    VkDeviceSize used{0};
+    VkDeviceSize size{0};
+  };
+
+  // copies data into staging, returns the staging buffer and the offset of the copy
+  VkBuffer Stage(const void *data, VkDeviceSize size, VkDeviceSize *offset);
+
+  VulkanDevice *device_{nullptr};
+  VkQueue queue_{VK_NULL_HANDLE};
+  VkCommandBuffer cmdBuffer_{VK_NULL_HANDLE};
+  std::vector<StagingChunk> staging_;
+  std::vector<VulkanBuffer *> deferred_;
+  VkDeviceSize pendingBytes_{0};
+  VkDeviceSize uploadedBytes_{0};
+  uint32_t submitCount_{0};
+};
+
+}  // namespace lvk
@@ -0,0 +1,24 @@
+#version 450
+
+layout (location = 0) flat in uint inDrawIndex;
+
+layout (location = 0) out vec4 outFragColor;
+
+struct DrawData {
+	vec4 color;
+	float roughness;
+	float metallic;
+	uint textureIndex;
+	float padding;
+};
+
+// material parameters of every draw, selected by the draw index of the instance
+layout (set = 0, binding = 3) readonly buffer DrawBuffer {
+	DrawData draws[];
+} draw_data;
+
+void main()
+{
+	// flat base color, the real material takes over once its pipeline is ready
+	outFragColor = vec4(draw_data.draws[inDrawIndex].color.rgb, 1.0);
+}
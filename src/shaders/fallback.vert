@@ -0,0 +1,38 @@
+#version 450
+
+// stands in for a material whose pipeline is still compiling, only positions are read
+
+layout (location = 0) in vec3 inPos;
+
+layout (set = 0, binding = 0) uniform UBOShared {
+    vec4 camera_position;
+    vec4 light_direction;
+    vec4 light_color;
+    mat4 light_mvp;
+    mat4 projection;
+    mat4 view;
+} uboShared;
+
+struct InstanceData {
+	mat4 model;
+	uint draw;
+};
+
+// per instance data of the frame, indexed by instance slot
+layout (set = 0, binding = 2) readonly buffer InstanceBuffer {
+	InstanceData instances[];
+} instance_data;
+
+// instance index of each drawn instance, identity unless the draws were culled on the gpu
+layout (set = 0, binding = 4) readonly buffer VisibleBuffer {
+	uint indices[];
+} visible;
+
+layout (location = 0) flat out uint outDrawIndex;
+
+void main()
+{
+	InstanceData instance = instance_data.instances[visible.indices[gl_InstanceIndex]];
+	outDrawIndex = instance.draw;
+	gl_Position = uboShared.projection * uboShared.view * instance.model * vec4(inPos, 1.0);
+}
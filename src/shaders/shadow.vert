@@ -11,11 +11,23 @@ layout (set = 0, binding = 0) uniform UBOShared {
     mat4 view;
 } uboShared;
 
-layout (set = 1, binding = 0) uniform UBOModel {
+struct InstanceData {
 	mat4 model;
-} uboModel;
+	uint draw;
+};
+
+// per instance data of the frame, indexed by instance slot
+layout (set = 0, binding = 2) readonly buffer InstanceBuffer {
+	InstanceData instances[];
+} instance_data;
+
+// instance index of each drawn instance, identity unless the draws were culled on the gpu
+layout (set = 0, binding = 4) readonly buffer VisibleBuffer {
+	uint indices[];
+} visible;
 
 void main()
 {
-	gl_Position = uboShared.light_mvp * uboModel.model * vec4(inPos, 1.0);
+	mat4 model = instance_data.instances[visible.indices[gl_InstanceIndex]].model;
+	gl_Position = uboShared.light_mvp * model * vec4(inPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+// packs the .spv files given on the command line into one shader archive, see base/shader_archive.h.
+// usage: pack_shaders <output> <shader.spv>...
+// the files are stored under their file name, which is what the samples pass to LoadShader()
+#include <stdint.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/shader_archive.h"
+
+namespace {
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: pack_shaders <output> <shader.spv>...\n";
+    return 1;
+  }
+
+  std::vector<std::string> names;
+  std::vector<std::vector<char>> codes;
+  for (int i = 2; i < argc; i++) {
+    std::ifstream in(argv[i], std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+      std::cerr << "pack_shaders: could not open " << argv[i] << "\n";
+      return 1;
+    }
+    std::vector<char> code(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(code.data(), static_cast<std::streamsize>(code.size()));
+    if (!in || code.empty() || code.size() % 4 != 0) {
+      std::cerr << "pack_shaders: " << argv[i] << " is not a spir-v file\n";
+      return 1;
+    }
+    names.push_back(std::filesystem::path(argv[i]).filename().string());
+    codes.push_back(std::move(code));
+  }
+
+  lvk::ShaderArchiveHeader header{};
+  header.magic = lvk::kShaderArchiveMagic;
+  header.version = lvk::kShaderArchiveVersion;
+  header.count = static_cast<uint32_t>(names.size());
+
+  std::vector<lvk::ShaderArchiveEntry> entries(names.size());
+  uint32_t offset = static_cast<uint32_t>(sizeof(header) + entries.size() * sizeof(lvk::ShaderArchiveEntry));
+  for (size_t i = 0; i < names.size(); i++) {
+    entries[i].nameOffset = offset;
+    entries[i].nameSize = static_cast<uint32_t>(names[i].size());
+    offset += entries[i].nameSize;
+  }
+  for (size_t i = 0; i < codes.size(); i++) {
+    offset = AlignUp(offset, lvk::kShaderArchiveAlignment);
+    entries[i].codeOffset = offset;
+    entries[i].codeSize = static_cast<uint32_t>(codes[i].size());
+    entries[i].hash = lvk::ShaderCodeHash(codes[i].data(), codes[i].size());
+    offset += entries[i].codeSize;
+  }
+
+  std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "pack_shaders: could not write " << argv[1] << "\n";
+    return 1;
+  }
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            static_cast<std::streamsize>(entries.size() * sizeof(lvk::ShaderArchiveEntry)));
+  for (const auto &name : names) {
+    out.write(name.data(), static_cast<std::streamsize>(name.size()));
+  }
+  for (size_t i = 0; i < codes.size(); i++) {
+    // zero padding up to the aligned blob start
+    const std::streamoff padding = entries[i].codeOffset - static_cast<std::streamoff>(out.tellp());
+    out.write(std::string(static_cast<size_t>(padding), '\0').data(), padding);
+    out.write(codes[i].data(), static_cast<std::streamsize>(codes[i].size()));
+  }
+  if (!out) {
+    std::cerr << "pack_shaders: failed writing " << argv[1] << "\n";
+    return 1;
+  }
+  std::cout << "pack_shaders: " << names.size() << " shaders, " << offset << " bytes -> " << argv[1] << "\n";
+  return 0;
+}